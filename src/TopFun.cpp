@@ -1,12 +1,14 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <string>
 
 #include "utils/GLEnvironment.h"
 #include "input/CallBackWorld.h"
 #include "render/Camera.h"
 #include "render/DebugOverlay.h"
 #include "terrain/Terrain.h"
+#include "terrain/DEMHeightSource.h"
 #include "sky/Sky.h"
 #include "sky/CloudRenderer.h"
 #include "aircraft/Aircraft.h"
@@ -35,7 +37,73 @@ GLfloat last_draw_time = 0.0f;
 GLfloat dt_loop = 0.0f;
 // Force loop to sleep until this amount of time has passed
 GLfloat loop_lock_time = 1.0/120.0;
-int main(int /* argc */, char** /* argv */) {
+int main(int argc, char** argv) {
+  // Optional directory to cache generated terrain tiles in, and DEM files
+  // to take the terrain heights from: --dem <tile.hgt> places SRTM tiles by
+  // their names relative to the latitude/longitude given by --dem-origin 
+  // (default the center of the first tile), --dem-raw <file> <width> 
+  // <spacing> <height scale> centers a raw 16-bit heightmap on the origin.
+  // --integrator <euler|rk4|lie> and --physics-rate <Hz> select how the
+  // aircraft dynamics are stepped
+  std::string tile_cache_directory;
+  PhysicsIntegrator integrator = PhysicsIntegrator::semi_implicit_euler;
+  float physics_rate = 200.0f;
+  std::vector<std::string> srtm_paths;
+  std::vector<DEMHeightSource::File> dem_files;
+  bool has_dem_origin = false;
+  float dem_origin[2] = {0.0f, 0.0f};
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "--tile-cache" && i + 1 < argc) {
+      tile_cache_directory = argv[++i];
+    }
+    else if (arg == "--dem" && i + 1 < argc) {
+      srtm_paths.push_back(argv[++i]);
+    }
+    else if (arg == "--dem-origin" && i + 2 < argc) {
+      has_dem_origin = true;
+      dem_origin[0] = std::stof(argv[++i]);
+      dem_origin[1] = std::stof(argv[++i]);
+    }
+    else if (arg == "--dem-raw" && i + 4 < argc) {
+      DEMHeightSource::File file;
+      file.path = argv[++i];
+      file.format = DEMHeightSource::Format::raw16;
+      file.width = std::stoi(argv[++i]);
+      float spacing = std::stof(argv[++i]);
+      file.spacing = {{spacing, spacing}};
+      file.height_scale = std::stof(argv[++i]);
+      file.height_offset = 0.0f;
+      file.xz0 = {{-0.5f * spacing * (file.width - 1), 
+        -0.5f * spacing * (file.width - 1)}};
+      dem_files.push_back(file);
+    }
+    else if (arg == "--integrator" && i + 1 < argc) {
+      integrator = ParsePhysicsIntegrator(argv[++i]);
+    }
+    else if (arg == "--physics-rate" && i + 1 < argc) {
+      physics_rate = std::stof(argv[++i]);
+    }
+  }
+  if (!srtm_paths.empty() && !has_dem_origin) {
+    DEMHeightSource::File first = DEMHeightSource::GetSRTMFile(
+        srtm_paths[0], 0.0f, 0.0f);
+    // Placed about (0,0), the first (north-west) sample is at 
+    // (lon, -lat - 1) degree lengths
+    dem_origin[0] = -first.xz0[1] / first.spacing[1] / (first.width - 1) - 
+      0.5f;
+    dem_origin[1] = 0.5f + first.xz0[0] / first.spacing[0] / 
+      (first.width - 1);
+  }
+  for (const std::string& path : srtm_paths) {
+    dem_files.push_back(DEMHeightSource::GetSRTMFile(path, dem_origin[0], 
+          dem_origin[1]));
+  }
+  std::unique_ptr<HeightSource> height_source;
+  if (!dem_files.empty()) {
+    height_source.reset(new DEMHeightSource(dem_files));
+  }
+
   // Setup the audio manager and load audio files
   AudioManager::SetUp();
   AudioManager::Instance().AddBuffer("../../../assets/audio/engine_idle.wav", 
@@ -44,10 +112,12 @@ int main(int /* argc */, char** /* argv */) {
       "afterburner");
   
   // Set up remaining game objects (in main due to static members)
-  Terrain terrain(terrain_size, 19, {{start_pos[0], start_pos[2]}});
+  Terrain terrain(terrain_size, 19, {{start_pos[0], start_pos[2]}}, 
+      tile_cache_directory, std::move(height_source));
   Aircraft aircraft(start_pos,
       glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
       camera, terrain);
+  aircraft.SetIntegrator(integrator);
   Sky sky;
   CloudRenderer cloud_renderer(screen_size[0], screen_size[1]);
 
@@ -58,10 +128,12 @@ int main(int /* argc */, char** /* argv */) {
   GLfloat last_loop_time = glfwGetTime();
   GLfloat draw_wait_time = 0.0f;
   float t_physics = 0.0f;
-  const float dt_physics = 0.005f; // don't make this too big or small
+  // Semi-implicit Euler needs about 200 Hz (don't make this too big or
+  // small), RK4 is meant for 50-100 Hz
+  const float dt_physics = 1.0f / physics_rate;
   float t_accumulator = 0.0f;
-  std::vector<double> current_state = aircraft.GetState();
-  std::vector<double> previous_state = current_state;
+  RigidBodyState current_state = aircraft.GetState();
+  RigidBodyState previous_state = current_state;
   while(!glfwWindowShouldClose(window)) {
     // Compute loop time
     const GLfloat current_loop_time = glfwGetTime();
@@ -84,7 +156,7 @@ int main(int /* argc */, char** /* argv */) {
     }
     // Interpolate the state vector for rendering
     const float alpha = t_accumulator / dt_physics;
-    std::vector<double> render_state = aircraft.InterpolateState(previous_state,
+    RigidBodyState render_state = aircraft.InterpolateState(previous_state,
         current_state, alpha);
     aircraft.SetState(render_state);
     
@@ -120,7 +192,7 @@ int main(int /* argc */, char** /* argv */) {
     AudioManager::Instance().SetListenerOrientation(camera.GetOrientation());
 
     // Update terrain tiles
-    glm::vec3 camera_pos = camera.GetPosition();
+    glm::dvec3 camera_pos = camera.GetPosition();
     terrain.SetXZCenter({{camera_pos[0], camera_pos[2]}});
 
     // Draw the scene
@@ -0,0 +1,310 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include "terrain/TerrainCore.h"
+#include "aircraft/AircraftDynamics.h"
+#include "aircraft/ControlScript.h"
+#include "utils/ThreadPool.h"
+
+using namespace TopFun;
+
+namespace {
+// Random change applied to every run, drawn from a normal distribution
+struct Dispersion {
+  std::string name; // x/y/z (m), speed (m/s), roll/pitch/yaw (degrees), a
+                    // control (added to the script) or an aero coefficient
+                    // (relative to the nominal value)
+  double sigma; // standard deviation
+};
+
+// Settings shared by all runs
+struct EnsembleSettings {
+  glm::dvec3 start_pos;
+  double duration;
+  float physics_rate;
+  std::uint64_t seed;
+  std::vector<Dispersion> dispersions;
+};
+
+// Result of one run, also the record of the binary output (56 bytes, native
+// byte order)
+struct RunResult {
+  std::uint64_t run;
+  std::uint64_t seed; // seed of the run's random number generator
+  double x, y, z; // final position
+  float t_contact; // time of first terrain contact, -1 if none
+  float speed; // final speed
+  float max_alpha; // maximum |angle of attack| (radians)
+  float min_height; // minimum height of the model origin above the terrain
+};
+static_assert(sizeof(RunResult) == 56, "RunResult must not be padded");
+
+//****************************************************************************80
+//! \brief SplitMix64 - splitmix64 hash, decorrelates the seeds of
+//! consecutive runs
+//****************************************************************************80
+inline std::uint64_t SplitMix64(std::uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+//****************************************************************************80
+//! \brief Run - fly one run of the ensemble
+//! \param[in] prototype - aircraft copied for the run
+//! \param[in] terrain - terrain, only queried
+//! \param[in] script - control script
+//! \param[in] settings - settings shared by all runs
+//! \param[in] run - index of the run
+//! \returns result of the run
+//****************************************************************************80
+RunResult Run(const AircraftDynamics& prototype, const TerrainCore& terrain,
+    const ControlScript& script, const EnsembleSettings& settings,
+    std::uint64_t run) {
+  RunResult result;
+  result.run = run;
+  result.seed = SplitMix64(settings.seed + run);
+  std::mt19937_64 rng(result.seed);
+  std::normal_distribution<double> normal;
+
+  // Apply the dispersions, in the order given
+  AircraftDynamics aircraft(prototype);
+  RigidBodyState state = aircraft.GetState();
+  ControlScript::Controls bias = {{0.0f, 0.0f, 0.0f, 0.0f}};
+  for (const Dispersion& d : settings.dispersions) {
+    double r = d.sigma * normal(rng);
+    int c = ControlScript::GetControlIndex(d.name);
+    if (d.name == "x") state.position.x += r;
+    else if (d.name == "y") state.position.y += r;
+    else if (d.name == "z") state.position.z += r;
+    else if (d.name == "speed") {
+      // Of the state being built, so repeated speed dispersions compound
+      double speed = glm::length(state.lin_momentum) / aircraft.GetMass();
+      if (speed > 0.0) {
+        state.lin_momentum *= std::max(0.0, speed + r) / speed;
+      }
+    }
+    else if (d.name == "roll" || d.name == "pitch" || d.name == "yaw") {
+      // About the aircraft x (front), y (right) or z (down) axis
+      glm::dvec3 axis(d.name == "roll", d.name == "pitch", d.name == "yaw");
+      state.orientation = state.orientation * glm::angleAxis(
+          glm::radians(r), axis);
+    }
+    else if (c >= 0) bias[c] += (float)r;
+    else {
+      aircraft.SetAeroCoefficient(d.name, (float)(
+            aircraft.GetAeroCoefficient(d.name) * (1.0 + r)));
+    }
+  }
+  aircraft.SetState(state);
+
+  // Fly the script, as topfun_headless does
+  ControlScript::Controls controls = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  std::size_t next_event = script.Apply(0.0, 0, controls);
+  const float dt_physics = 1.0f / settings.physics_rate;
+  const long num_steps = std::lround(settings.duration *
+      settings.physics_rate);
+  result.t_contact = -1.0f;
+  result.max_alpha = 0.0f;
+  result.min_height = std::numeric_limits<float>::max();
+  for (long step = 0; step <= num_steps; ++step) {
+    double t = step * (double)dt_physics;
+    next_event = script.Apply(t, next_event, controls);
+    aircraft.SetControls(controls[0] + bias[0], controls[1] + bias[1],
+        controls[2] + bias[2], controls[3] + bias[3]);
+    glm::dvec3 position = aircraft.GetPosition();
+    result.max_alpha = std::max(result.max_alpha,
+        std::abs(aircraft.GetAlpha()));
+    result.min_height = std::min(result.min_height, (float)(position.y -
+          terrain.GetHeight(position.x, position.z)));
+    if (result.t_contact < 0.0f && aircraft.GetNumContacts() > 0) {
+      result.t_contact = (float)t;
+    }
+    if (step == num_steps) break;
+    aircraft.DoPhysicsStep((float)t, dt_physics);
+    aircraft.SetState(aircraft.GetState());
+  }
+  glm::dvec3 position = aircraft.GetPosition();
+  result.x = position.x;
+  result.y = position.y;
+  result.z = position.z;
+  result.speed = glm::length(aircraft.GetVelocity());
+  return result;
+}
+} // End anonymous namespace
+
+// Flies many independent runs of the headless simulation with randomly
+// dispersed initial states, control inputs and aerodynamic coefficients,
+// and writes one result per run. Each run draws from its own generator,
+// seeded from the base seed and the run index, so results do not depend on
+// the number of threads. Only results go to stdout, so it can be piped as
+// CSV or as RunResult records, diagnostics go to stderr. Run from the same
+// directory as TopFun
+int main(int argc, char** argv) {
+  // --runs <n> number of runs, --seed <n> base seed, --threads <n> worker
+  // threads (default all hardware threads), --disperse <name> <sigma> adds
+  // a dispersion (repeatable), --binary writes RunResult records instead of
+  // CSV, and --script, --output, --duration, --start, --integrator,
+  // --physics-rate and --tile-cache as for topfun_headless
+  std::string script_path;
+  std::string output_path;
+  std::string tile_cache_directory;
+  std::uint64_t num_runs = 1000;
+  unsigned num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  bool binary = false;
+  PhysicsIntegrator integrator = PhysicsIntegrator::semi_implicit_euler;
+  EnsembleSettings settings;
+  settings.start_pos = glm::dvec3(0.0, 3000.0, 0.0);
+  settings.duration = 60.0;
+  settings.physics_rate = 200.0f;
+  settings.seed = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "--runs" && i + 1 < argc) {
+      num_runs = std::stoull(argv[++i]);
+    }
+    else if (arg == "--seed" && i + 1 < argc) {
+      settings.seed = std::stoull(argv[++i]);
+    }
+    else if (arg == "--threads" && i + 1 < argc) {
+      num_threads = std::max(std::stoi(argv[++i]), 1);
+    }
+    else if (arg == "--disperse" && i + 2 < argc) {
+      Dispersion d;
+      d.name = argv[++i];
+      d.sigma = std::stod(argv[++i]);
+      settings.dispersions.push_back(d);
+    }
+    else if (arg == "--binary") {
+      binary = true;
+    }
+    else if (arg == "--script" && i + 1 < argc) {
+      script_path = argv[++i];
+    }
+    else if (arg == "--output" && i + 1 < argc) {
+      output_path = argv[++i];
+    }
+    else if (arg == "--duration" && i + 1 < argc) {
+      settings.duration = std::stod(argv[++i]);
+    }
+    else if (arg == "--start" && i + 3 < argc) {
+      settings.start_pos.x = std::stod(argv[++i]);
+      settings.start_pos.y = std::stod(argv[++i]);
+      settings.start_pos.z = std::stod(argv[++i]);
+    }
+    else if (arg == "--integrator" && i + 1 < argc) {
+      integrator = ParsePhysicsIntegrator(argv[++i]);
+    }
+    else if (arg == "--physics-rate" && i + 1 < argc) {
+      settings.physics_rate = std::stof(argv[++i]);
+    }
+    else if (arg == "--tile-cache" && i + 1 < argc) {
+      tile_cache_directory = argv[++i];
+    }
+    else {
+      throw std::invalid_argument("Unknown or incomplete argument " + arg +
+          "\n");
+    }
+  }
+  // Negated, so NaN is rejected too
+  if (!(settings.duration >= 0.0)) {
+    throw std::invalid_argument("Duration must not be negative\n");
+  }
+  if (!(settings.physics_rate > 0.0f)) {
+    throw std::invalid_argument("Physics rate must be positive\n");
+  }
+  ControlScript script;
+  if (!script_path.empty()) {
+    script = ControlScript(script_path);
+  }
+
+  // All runs share the terrain ring around the start, loaded up front and
+  // only queried afterwards, so it can be read from every thread. Runs
+  // that leave it are answered by the height source
+  float terrain_size = 150000.0f;
+  TerrainCore terrain(terrain_size, 19, {{settings.start_pos.x,
+      settings.start_pos.z}}, tile_cache_directory);
+  terrain.SetXZCenter({{settings.start_pos.x, settings.start_pos.z}}, true);
+  AircraftDynamics prototype(settings.start_pos,
+      glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+      terrain);
+  prototype.SetIntegrator(integrator);
+  for (const Dispersion& d : settings.dispersions) {
+    // Check the names before starting, throws for unknown coefficients
+    if (d.name != "x" && d.name != "y" && d.name != "z" &&
+        d.name != "speed" && d.name != "roll" && d.name != "pitch" &&
+        d.name != "yaw" && ControlScript::GetControlIndex(d.name) < 0) {
+      prototype.GetAeroCoefficient(d.name);
+    }
+  }
+
+  // Each worker claims the next unclaimed run until none are left and
+  // writes its result to the run's own slot
+  std::vector<RunResult> results(num_runs);
+  std::atomic<std::uint64_t> next_run(0);
+  auto start = std::chrono::steady_clock::now();
+  {
+    ThreadPool thread_pool(num_threads);
+    std::vector<std::future<void>> workers;
+    for (unsigned i = 0; i < num_threads; ++i) {
+      workers.push_back(thread_pool.Submit([&]() {
+            for (std::uint64_t run = next_run++; run < num_runs;
+                run = next_run++) {
+              results[run] = Run(prototype, terrain, script, settings, run);
+            }
+          }));
+    }
+    for (auto& w : workers) {
+      w.get();
+    }
+  }
+  double wall_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  // Write the results in run order
+  std::ofstream output_file;
+  if (!output_path.empty()) {
+    output_file.open(output_path, binary ? std::ios::binary : std::ios::out);
+    if (!output_file) {
+      throw std::invalid_argument("Failed to open output " + output_path +
+          "\n");
+    }
+  }
+  std::ostream& out = output_path.empty() ? std::cout : output_file;
+  if (binary) {
+    out.write(reinterpret_cast<const char*>(results.data()),
+        results.size() * sizeof(RunResult));
+  }
+  else {
+    out.precision(9);
+    out << "run,seed,x,y,z,t_contact,speed,max_alpha,min_height\n";
+    for (const RunResult& r : results) {
+      out << r.run << "," << r.seed << "," << r.x << "," << r.y << ","
+        << r.z << "," << r.t_contact << "," << r.speed << ","
+        << r.max_alpha << "," << r.min_height << "\n";
+    }
+  }
+
+  std::size_t num_contact = std::count_if(results.begin(), results.end(),
+      [](const RunResult& r) { return r.t_contact >= 0.0f; });
+  std::cerr << "Flew " << num_runs << " runs of " << settings.duration
+    << " s in " << wall_seconds << " s on " << num_threads << " threads ("
+    << num_runs * settings.duration / wall_seconds << "x real time), "
+    << num_contact << " touched the terrain" << std::endl;
+
+  return 0;
+}
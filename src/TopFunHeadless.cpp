@@ -0,0 +1,162 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+
+#include "terrain/TerrainCore.h"
+#include "aircraft/AircraftDynamics.h"
+#include "aircraft/ControlScript.h"
+
+using namespace TopFun;
+
+namespace {
+//****************************************************************************80
+//! \brief WriteState - write one CSV row of the aircraft state
+//****************************************************************************80
+void WriteState(std::ostream& out, double t, const AircraftDynamics& aircraft,
+    const RigidBodyState& state, const ControlScript::Controls& controls) {
+  glm::vec3 v = aircraft.GetVelocity();
+  out << t << "," << state.position.x << "," << state.position.y << ","
+    << state.position.z << "," << state.orientation.w << ","
+    << state.orientation.x << "," << state.orientation.y << ","
+    << state.orientation.z << "," << v.x << "," << v.y << "," << v.z << ","
+    << aircraft.GetAlpha() << "," << controls[0] << "," << controls[1] << ","
+    << controls[2] << "," << controls[3] << "," << aircraft.GetNumContacts()
+    << "\n";
+}
+} // End anonymous namespace
+
+// Steps the flight dynamics and terrain collisions as fast as the CPU
+// allows, with no window, GL context or audio. Controls come from a flight
+// test script and the aircraft state is written as CSV. Only the CSV goes
+// to stdout, diagnostics go to stderr. Run from the same directory as
+// TopFun, the aircraft collision mesh is loaded relative to it
+int main(int argc, char** argv) {
+  // --script <file> control script, --output <file> CSV (default stdout),
+  // --duration <s> simulated time, --output-rate <Hz> rows per simulated
+  // second, --start <x> <y> <z> initial position, --integrator
+  // <euler|rk4|lie> and --physics-rate <Hz> as for TopFun, --tile-cache
+  // <dir> directory to cache generated terrain tiles in
+  std::string script_path;
+  std::string output_path;
+  std::string tile_cache_directory;
+  double duration = 60.0;
+  double output_rate = 10.0;
+  glm::dvec3 start_pos(0.0, 10.0, 0.0);
+  PhysicsIntegrator integrator = PhysicsIntegrator::semi_implicit_euler;
+  float physics_rate = 200.0f;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "--script" && i + 1 < argc) {
+      script_path = argv[++i];
+    }
+    else if (arg == "--output" && i + 1 < argc) {
+      output_path = argv[++i];
+    }
+    else if (arg == "--duration" && i + 1 < argc) {
+      duration = std::stod(argv[++i]);
+    }
+    else if (arg == "--output-rate" && i + 1 < argc) {
+      output_rate = std::stod(argv[++i]);
+    }
+    else if (arg == "--start" && i + 3 < argc) {
+      start_pos.x = std::stod(argv[++i]);
+      start_pos.y = std::stod(argv[++i]);
+      start_pos.z = std::stod(argv[++i]);
+    }
+    else if (arg == "--integrator" && i + 1 < argc) {
+      integrator = ParsePhysicsIntegrator(argv[++i]);
+    }
+    else if (arg == "--physics-rate" && i + 1 < argc) {
+      physics_rate = std::stof(argv[++i]);
+    }
+    else if (arg == "--tile-cache" && i + 1 < argc) {
+      tile_cache_directory = argv[++i];
+    }
+    else {
+      throw std::invalid_argument("Unknown or incomplete argument " + arg +
+          "\n");
+    }
+  }
+  // Negated, so NaN is rejected too
+  if (!(duration >= 0.0)) {
+    throw std::invalid_argument("Duration must not be negative\n");
+  }
+  if (!(output_rate > 0.0)) {
+    throw std::invalid_argument("Output rate must be positive\n");
+  }
+  if (!(physics_rate > 0.0f)) {
+    throw std::invalid_argument("Physics rate must be positive\n");
+  }
+  ControlScript script;
+  if (!script_path.empty()) {
+    script = ControlScript(script_path);
+  }
+  std::ofstream output_file;
+  if (!output_path.empty()) {
+    output_file.open(output_path);
+    if (!output_file) {
+      throw std::invalid_argument("Failed to open output " + output_path +
+          "\n");
+    }
+  }
+  std::ostream& out = output_path.empty() ? std::cout : output_file;
+  out.precision(9);
+
+  // Same terrain and aircraft as the game, without any GL resources
+  float terrain_size = 150000.0f;
+  TerrainCore terrain(terrain_size, 19, {{start_pos.x, start_pos.z}},
+      tile_cache_directory);
+  AircraftDynamics aircraft(start_pos,
+      glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+      terrain);
+  aircraft.SetIntegrator(integrator);
+  ControlScript::Controls controls = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  aircraft.SetControls(controls[0], controls[1], controls[2], controls[3]);
+
+  const float dt_physics = 1.0f / physics_rate;
+  const long num_steps = std::lround(duration * physics_rate);
+  const long output_every = std::max(1L, std::lround(physics_rate /
+        output_rate));
+  // Follow the aircraft with the terrain ring about once per simulated
+  // second, waiting for the tiles so runs are repeatable
+  const long recenter_every = std::max(1L, std::lround(physics_rate));
+  out << "t,x,y,z,qw,qx,qy,qz,vx,vy,vz,alpha,elevator,aileron,rudder,"
+    "throttle,contacts\n";
+  auto start = std::chrono::steady_clock::now();
+  std::size_t next_event = 0;
+  for (long step = 0; step <= num_steps; ++step) {
+    double t = step * (double)dt_physics;
+    RigidBodyState state = aircraft.GetState();
+    if (step % recenter_every == 0) {
+      terrain.SetXZCenter({{state.position.x, state.position.z}}, true);
+    }
+
+    // Apply the script up to the current time
+    std::size_t applied = script.Apply(t, next_event, controls);
+    if (applied != next_event) {
+      next_event = applied;
+      aircraft.SetControls(controls[0], controls[1], controls[2],
+          controls[3]);
+    }
+
+    if (step % output_every == 0) {
+      WriteState(out, t, aircraft, state, controls);
+    }
+    if (step == num_steps) break;
+    aircraft.DoPhysicsStep((float)t, dt_physics);
+    // Renormalize the orientation, as the game does every frame
+    aircraft.SetState(aircraft.GetState());
+  }
+  double wall_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Simulated " << duration << " s in " << wall_seconds
+    << " s (" << duration / wall_seconds << "x real time)" << std::endl;
+
+  return 0;
+}
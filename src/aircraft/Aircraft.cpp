@@ -15,20 +15,12 @@ namespace TopFun {
 //****************************************************************************80
 Aircraft::Aircraft(const glm::dvec3& position, const glm::quat& orientation,
     const Camera& camera, const Terrain& terrain) :
-    camera_(camera), terrain_(terrain),
+    AircraftDynamics(position, orientation, terrain),
+    camera_(camera),
     fuselage_shader_("shaders/aircraft.vs", "shaders/aircraft.fs"),
     canopy_shader_("shaders/aircraft.vs", "shaders/canopy.fs"),
     exhaust_shader_("shaders/exhaust.vs", "shaders/exhaust.fs"),
-     model_("../../../assets/models/FA-22_Raptor/FA-22_Raptor.obj"),
-    collision_model_(
-         "../../../assets/models/FA-22_Raptor/FA-22_Raptor_Convex_Hull.obj",
-         true),
-    position_(position), orientation_(orientation), 
-    lin_momentum_(AircraftToWorld(glm::vec3(27000.0f * 150.0f, 0.0f, 0.0f), 
-          orientation)), 
-    ang_momentum_(0.0f, 0.0f, 0.0f),
-    acceleration_(0.0f, 0.0f, 0.0f), 
-    crashed_(false) {
+     model_("../../../assets/models/FA-22_Raptor/FA-22_Raptor.obj") {
   // Draw the canopy last since it's transparent
   std::vector<unsigned int> draw_order(model_.GetNumMeshes());
   std::iota(draw_order.begin(), draw_order.end(), 0);
@@ -48,25 +40,7 @@ Aircraft::Aircraft(const glm::dvec3& position, const glm::quat& orientation,
   airframe_mesh_indices_ = {0, 1, 2, 3, 4, 5, 6, 7, 10, 11, 
     14, 15, 18, 19, 20, 21};
   
-  // Set the physical dimensions of the aircraft
-  mass_ = 27000.0f;
-  inv_mass_ = 1.0f / mass_;
-  // y+/-: for/aft, z+/-: up-down
-  delta_center_of_mass_ = glm::dvec3(0.0f, 0.0f, -1.0f);
-  inertia_[0][0] = 22000.0f;       // I_xx
-  inertia_[1][1] = 162000.0f;      // I_yy
-  inertia_[2][2] = 178000.0f;      // I_zz
-  inertia_[0][2] = -2874.0f;       // I_xz
-  inertia_[2][0] = inertia_[0][2]; // I_zx
-  e_collision_ = 0.1f;
-  mu_static_ = 1.0f;
-  mu_dynamic_ = 0.5f;
-  wetted_area_ = 316.0f;
-  chord_ = 5.75f;
-  span_ = 13.56f;
-  dx_cg_x_ax_ = 0.05f;
-  r_tail_ = glm::vec3(-4.8f, 0.0f, 0.0f);
-  max_thrust_ = 311000.0f;
+  // Set the control surface rotation axes
   rudder_axis_ = {{glm::vec3(-1.57663f, -6.48513f, -0.12633f),
     glm::vec3(-0.410372f, 0.414351f, 0.812345f)}};
   aileron_axis_ = {{glm::vec3(-4.53069f, -4.33568f, -0.668355f),
@@ -74,68 +48,6 @@ Aircraft::Aircraft(const glm::dvec3& position, const glm::quat& orientation,
   elevator_axis_ = {{glm::vec3(-2.00298f, -6.8562f, -0.625643f),
     glm::vec3(-0.994531f, -0.104437f, 0.0f)}};
 
-  // Define the aerodynamic performance coefficients
-  CL_ = {0.26, 0.1, 0.2, 0.24, 0.07, 0.0, // (-pi/2, 0] 
-    -0.03, -0.14, -0.2, -0.1, -0.2, -0.3, // (0, pi/2]
-    0.0, 0.55, 0.45, 0.3, 0.14, 0.07, 0.0, // (pi/2, pi]
-    -0.07, -0.14, -0.2, -0.1, -0.2, 0.0};
-  CD_ = {0.03, 0.11, 0.2, 0.4, 0.6, 0.8, 
-    1.0, 0.8, 0.6, 0.4, 0.25, 0.11, // (-pi/2, 0]
-    0.03, 0.11, 0.25, 0.4, 0.6, 0.8, // (0, pi/2]
-    1.0, 0.8, 0.6, 0.4, 0.25, 0.11, 0.03}; // (pi/2, pi]
-  CL_Q_ = 0.0f;
-  Cm_Q_ = -3.6f;
-  CL_alpha_dot_ = 0.72f;
-  Cm_alpha_dot_ = -1.1f;
-  float e = 1.0f / (1.05f + 0.007f * M_PI * span_ / chord_);
-  CDi_CL2_ = 1.0f / (M_PI * e * span_ / chord_);
-  CY_beta_ = -0.98f;
-  Cl_beta_ = -0.12f;
-  Cl_P_ = -0.26f; 
-  Cl_R_ = 0.14f; 
-  Cn_beta_ = 0.25f; 
-  Cn_P_ = 0.022f; 
-  Cn_R_ = -0.35f; 
-  CL_de_ = 0.12f; 
-  CD_de_ = 0.08f; 
-  CY_dr_ = 0.12f; 
-  Cm_de_ = -0.4f; 
-  Cl_da_ = 0.02f; 
-  Cn_da_ = 0.06f; 
-  Cl_dr_ = -0.001f; 
-  Cn_dr_ = 0.04f; 
-  
-  // Set the initial values for control inputs
-  rudder_position_   = 0.0f;
-  elevator_position_ = 0.0f;
-  aileron_position_  = 0.0f;
-  throttle_position_ = 1.0f;
-
-  // Design Cm_ so the aircraft is stable
-  float dCL_dalpha0 = (CL_[1] - CL_[0]) / (2 * M_PI / (CL_.size() - 1));
-  float vt = glm::l2Norm(lin_momentum_) * inv_mass_;
-  float q = 0.5f * 1.225f * vt * vt;
-  float alpha0 = (mass_ * 9.81f / q / wetted_area_ - CL_[0]) / dCL_dalpha0;
-  glm::vec3 omega(0.0f, 0.0f, 0.0f);
-  float lift0 = CalcLift(alpha0, 0.0f, omega, vt, 0.0f, q, 0.0f);
-  float drag0 = CalcDrag(lift0, alpha0, vt, 0.0f, q, 0.0f);
-  float M_LD0 = dx_cg_x_ax_ * chord_ * (lift0*cos(alpha0) + drag0*sin(alpha0));
-  float alpha1 = alpha0 + glm::radians(0.01f);
-  float lift1 = CalcLift(alpha1, 0.0f, omega, vt, 0.0f, q, 0.0f);
-  float drag1 = CalcDrag(lift1, alpha1, vt, 0.0f, q, 0.0f);
-  float M_LD1 = dx_cg_x_ax_ * chord_ * (lift1*cos(alpha1) + drag1*sin(alpha1));
-  float dCm_LD_dalpha = (M_LD1-M_LD0)/(alpha1-alpha0)/q/wetted_area_/ chord_;
-  float dCm_dalpha = 8.0f * dCm_LD_dalpha; // increasing this causes nose up
-  float Cm0 = -M_LD0 / q / wetted_area_ / chord_ - dCm_dalpha * alpha0;
-  int npts = 180/15;
-  Cm_.resize(2*npts + 1);
-  Cm_[npts] = Cm0;
-  for (int i = 0; i < npts; ++i) {
-    float slope_factor = std::pow(1.0f - 0.9 * i / npts, 3.0);
-    Cm_[npts-i-1] = Cm_[npts-i] - slope_factor * dCm_dalpha * (float)M_PI / npts;
-    Cm_[npts+i+1] = Cm_[npts+i] + slope_factor * dCm_dalpha * (float)M_PI / npts;
-  }
-
   // Set up the data for drawing the exhaust
   delta_exhaust_ = {0.637885f, -6.717596f, -0.562625f};
   delta_flame_ = {0.637885f, -6.217596f, -0.593625f};
@@ -291,137 +203,8 @@ void Aircraft::UpdateControls(std::vector<bool> const& keys) {
   UpdateEngineSounds();
 }
 
-//****************************************************************************80
-std::vector<double> Aircraft::GetStateDerivative(
-    const std::vector<double>& state, float /* t */) {
-  // Unpack the state vector
-  glm::vec3 position(state[0], state[1], state[2]);
-  glm::quat orientation = glm::quat(state[3], state[4], state[5], state[6]);
-  glm::vec3 lin_momentum(state[7], state[8], state[9]);
-  glm::vec3 ang_momentum(state[10], state[11], state[12]);
-  glm::vec3 omega = GetAngularVelocity(orientation, ang_momentum); 
-
-  // Update the forces and torques in the aircraft frame
-  CalcAeroForcesAndTorques(position, orientation, lin_momentum, 
-      WorldToAircraft(omega, orientation), forces_, torques_);
-  forces_ += CalcEngineForce();
-
-  // Rotate forces and torques to world frame and add gravity
-  forces_ = AircraftToWorld(forces_, orientation);
-  torques_ = AircraftToWorld(torques_, orientation);
-  forces_ += CalcGravityForce();
-
-  // Update acceleration (for computing angle rates)
-  acceleration_ = WorldToAircraft(forces_ * inv_mass_, orientation);
-
-  // Compute the derivative of the state vector
-  std::vector<double> deriv(13);
-  for (int i = 0; i < 3; ++i) 
-    deriv[i] = lin_momentum[i] * inv_mass_;
-  glm::quat omega_quat(0.0f, omega);
-  glm::quat spin = 0.5f * omega_quat * orientation;
-  deriv[3] = spin.w;
-  deriv[4] = spin.x;
-  deriv[5] = spin.y;
-  deriv[6] = spin.z;
-  for (int i = 0; i < 3; ++i) 
-    deriv[i+7] = forces_[i];
-  for (int i = 0; i < 3; ++i) 
-    deriv[i+10] = torques_[i];
-  return deriv;
-}
-  
-//****************************************************************************80
-void Aircraft::DoPhysicsStep(float t, float dt) {
-  // Compute the initial state derivative
-  auto state = GetState();
-  auto const deriv = GetStateDerivative(state, t);
-  
-  // Update momentum due to forces/torques
-  lin_momentum_ += forces_ * dt;
-  ang_momentum_ += torques_ * dt;
-
-  // Get the current set of contacts
-  auto contacts = GetContacts(state, dt);
-
-  // Iterate to solve for the new velocities
-  const int max_iter = 20;
-  for (int i = 0; i < max_iter; ++i) {
-    for (std::size_t c = 0; c < contacts.size(); ++c) {
-      // Apply normal impulse
-      auto v = GetVelocity() + glm::cross(GetAngularVelocity(orientation_,
-            ang_momentum_), contacts[c].r);
-      auto vn = glm::dot(v, contacts[c].n);
-      float dj_n = contacts[c].mass_n * (-vn + contacts[c].bias);
-      float j_n0 = contacts[c].j_n;
-      contacts[c].j_n = std::max(j_n0 + dj_n, 0.0f);
-      dj_n = contacts[c].j_n - j_n0;
-      lin_momentum_ += dj_n * contacts[c].n;
-      ang_momentum_ += dj_n * glm::cross(contacts[c].r, contacts[c].n);
-
-      // Apply tangent impulse
-      v = GetVelocity() + glm::cross(GetAngularVelocity(orientation_,
-            ang_momentum_), contacts[c].r);
-      auto vt = glm::dot(v, contacts[c].t);
-      float dj_t = contacts[c].mass_t * -vt;
-      float j_t_max = mu_dynamic_ * contacts[c].j_n;
-      float j_t0 = contacts[c].j_t;
-      contacts[c].j_t = std::min(std::max(j_t0 + dj_t, -j_t_max), j_t_max);
-      dj_t = contacts[c].j_t - j_t0;
-      lin_momentum_ += dj_t * contacts[c].t;
-      ang_momentum_ += dj_t * glm::cross(contacts[c].r, contacts[c].t);
-    }
-  }
-
-  // std::cout << j_n/dt << " " << mass_ * 9.81 << std::endl;
-  
-  // Update positions
-  position_ += lin_momentum_ * inv_mass_ * dt;
-  glm::vec3 omega = GetAngularVelocity(orientation_, ang_momentum_);
-  glm::quat omega_quat(0.0f, omega);
-  glm::quat spin = 0.5f * omega_quat * orientation_;
-  orientation_ += spin * dt;
-}
-
 //****************************************************************************80
 // PRIVATE FUNCTIONS
-//****************************************************************************80
-void Aircraft::CalcAeroForcesAndTorques(const glm::vec3& position,
-    const glm::quat& orientation, const glm::vec3& lin_momentum, 
-    const glm::vec3& omega, glm::vec3& forces, 
-    glm::vec3& torques) const {
-  glm::vec3 va = WorldToAircraft(lin_momentum * inv_mass_, orientation);
-  float vt = glm::l2Norm(va);
-  if (vt > std::numeric_limits<float>::epsilon()) {
-    glm::vec3 aa = WorldToAircraft(acceleration_, orientation);
-    float alpha = CalcAlpha(va);
-    float beta = CalcBeta(va);
-    float alpha_dot = CalcAlphaDot(va, aa); 
-    float dve = CalcTailVelocity(omega); 
-    float rho = 1.225f * exp(-position.y / 7300.0f);
-    float q = 0.5f * rho * vt * vt;
-
-    float lift = CalcLift(alpha, alpha_dot, omega, vt, dve, q, 
-        elevator_position_);
-    float drag = CalcDrag(lift, alpha, vt, dve, q, elevator_position_);
-    float side = CalcSideForce(beta, q, elevator_position_);
-    forces.x = lift * sin(alpha) - drag * cos(alpha) - side * sin(beta);
-    forces.y = side * cos(beta);
-    forces.z = -lift * cos(alpha) - drag * sin(alpha);
-
-    torques.x = CalcRollMoment(beta, omega, vt, q, aileron_position_, 
-        rudder_position_);
-    torques.y = CalcPitchMoment(alpha, alpha_dot, omega, vt, dve, q, 
-        elevator_position_, lift, drag);
-    torques.z = CalcYawMoment(beta, omega, vt, q, aileron_position_, 
-        rudder_position_);
-  }
-  else {
-    forces = glm::vec3(0.0f, 0.0f, 0.0f);
-    torques = glm::vec3(0.0f, 0.0f, 0.0f);
-  }
-}
-
 //****************************************************************************80
 void Aircraft::SetShaderData(const Sky& sky,
     const ShadowCascadeRenderer& shadow_renderer) const {
@@ -695,78 +478,5 @@ void Aircraft::UpdateEngineSounds() {
   engine_idle_.SetPitch(std::min(1.2, 0.75 + 0.5*throttle_position_));
   afterburner_.SetGain(std::max(0.0, -0.5 + 2.0*throttle_position_));
 }
-  
-//****************************************************************************80
-std::vector<Aircraft::Contact> Aircraft::GetContacts(
-    const std::vector<double>& state, float dt) const {
-  glm::vec3 position = glm::vec3(state[0], state[1], state[2]);
-  glm::quat orientation = glm::quat(state[3], state[4], state[5], state[6]);
-  glm::vec3 velocity = glm::vec3(state[7], state[8], state[9]) * inv_mass_;
-  glm::vec3 ang_momentum = glm::vec3(state[10], state[11], state[12]);
-  
-  glm::mat4 cm_model = glm::translate(glm::mat4(), position);
-  cm_model = glm::translate(cm_model, delta_center_of_mass_);
-  cm_model *= glm::toMat4(orientation);
-  cm_model *= glm::toMat4(glm::angleAxis(glm::radians(90.0f), 
-        glm::vec3(0.0f, 0.0f, 1.0f)));
-  cm_model *= glm::toMat4(glm::angleAxis(glm::radians(180.0f), 
-        glm::vec3(1.0f, 0.0f, 0.0f)));
-  cm_model = glm::translate(cm_model, -delta_center_of_mass_);
-  glm::mat3 inv_inertia_w = glm::inverse(AircraftToWorld(inertia_, 
-        orientation));
-  
-  std::vector<Contact> contacts;
-  // Broad phase: determine if terrain AABB and aircraft AABB intersect
-  bool broad_collide = false; // true if broad phase detects collision
-  auto const& aabb_aircraft = model_.GetAABB();
-  auto y_min_aircraft = position[1] + aabb_aircraft[1][0];
-  for (int i = 0; i < 2 && !broad_collide; ++i) {
-    for (int j = 0; j < 2 && !broad_collide; ++j) {
-      auto xbb = position[0] + aabb_aircraft[0][i];
-      auto zbb = position[2] + aabb_aircraft[2][j];
-      auto y_max_terrain = terrain_.GetBoundingHeight(xbb, zbb);
-      if (y_min_aircraft < y_max_terrain) {
-        broad_collide = true;
-      }
-    }
-  }
-  if (!broad_collide)
-    return contacts;
-
-  // Narrow phase: check if any vertices of collision model are below terrain
-  const float d_slop = 0.01; // penetration slop
-  const float beta = 0.2; // error reduction parameter
-  auto const& cm_verts = collision_model_.GetVertices(0);
-  for (std::size_t i = 0; i < cm_verts.size(); ++i) {
-    // Bring collision mesh vertex to world position
-    auto cm_vert_w = glm::vec3(cm_model*glm::vec4(cm_verts[i].Position, 1.0));
-    // Get the terrain height at this location
-    auto y_terrain = terrain_.GetHeight(cm_vert_w[0], cm_vert_w[2]);
-    auto n = terrain_.GetNormal(cm_vert_w[0], cm_vert_w[2]);
-    float d = (y_terrain - cm_vert_w[1]) * n[1];
-    if (d > 0.0f) {
-      auto r = glm::vec3(cm_vert_w - position);
-      auto v = velocity + glm::cross(inv_inertia_w * ang_momentum, r);
-      auto v_dot_n = glm::dot(v,n); 
-      auto t = glm::normalize(v - v_dot_n * n);
-      auto mass_n = 1.0f / (inv_mass_ + 
-          glm::dot(n, glm::cross(inv_inertia_w * glm::cross(r,n), r)));
-      auto mass_t = 1.0f / (inv_mass_ + 
-          glm::dot(t, glm::cross(inv_inertia_w * glm::cross(r,t), r)));
-      // Add bias for position correction
-      float bias = -beta / dt * std::min(0.0f, d_slop - d);
-      // Add bias for bounce
-      auto e = e_collision_;
-      if (v_dot_n < 0.0f) {
-        // Damp bounciness when object is "resting"
-        if (-v_dot_n < 2.0 * 9.81 * dt * (1.0 + e * e))
-          e = 0.0f;
-        bias -= e * v_dot_n;
-      }
-      contacts.push_back({d, n, t, v, r, mass_n, mass_t, bias, 0.0, 0.0});
-    }
-  }
-  return contacts;
-}
 
 } // End namespace TopFun
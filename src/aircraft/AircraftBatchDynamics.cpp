@@ -0,0 +1,686 @@
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+#include "aircraft/AircraftBatchDynamics.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AIRCRAFTBATCH_X86
+#include <immintrin.h>
+#endif
+
+namespace TopFun {
+
+namespace {
+const float pi = 3.14159265358979f;
+const float half_pi = 1.57079632679490f;
+// Inverse density scale height of the atmosphere (1/m)
+const float neg_inv_scale_height = -1.0f / 7300.0f;
+const float rho_sea_level = 1.225f;
+// Polynomial of atan on [0,1] (Abramowitz and Stegun 4.4.49)
+const float atan_c1 = 0.9998660f;
+const float atan_c3 = -0.3302995f;
+const float atan_c5 = 0.1801410f;
+const float atan_c7 = -0.0851330f;
+const float atan_c9 = 0.0208351f;
+// Split ln(2) and Taylor polynomial of exp on [-ln(2)/2, ln(2)/2]
+const float log2e = 1.44269504088896f;
+const float ln2_hi = 0.693359375f;
+const float ln2_lo = -2.12194440e-4f;
+const float exp_c2 = 1.0f / 2.0f;
+const float exp_c3 = 1.0f / 6.0f;
+const float exp_c4 = 1.0f / 24.0f;
+const float exp_c5 = 1.0f / 120.0f;
+const float exp_c6 = 1.0f / 720.0f;
+
+//****************************************************************************80
+//! \brief Atan - polynomial atan, accurate to about 1e-5
+//****************************************************************************80
+inline float Atan(float x) {
+  float ax = std::abs(x);
+  float t = ax > 1.0f ? 1.0f / ax : ax;
+  float t2 = t * t;
+  float p = t * (atan_c1 + t2 * (atan_c3 + t2 * (atan_c5 + t2 * (atan_c7 +
+            t2 * atan_c9))));
+  return std::copysign(ax > 1.0f ? half_pi - p : p, x);
+}
+
+//****************************************************************************80
+//! \brief Exp - polynomial exp, accurate to about 1e-7 (relative)
+//****************************************************************************80
+inline float Exp(float x) {
+  x = std::min(std::max(x, -87.0f), 88.0f);
+  float n = std::floor(x * log2e + 0.5f);
+  float f = (x - n * ln2_hi) - n * ln2_lo;
+  float p = ((((((exp_c6 * f + exp_c5) * f + exp_c4) * f + exp_c3) * f +
+          exp_c2) * f + 1.0f) * f) + 1.0f;
+  std::int32_t bits = ((std::int32_t)n + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+//****************************************************************************80
+//! \brief Interp - linear interpolation of a coefficient table in alpha
+//! \param[in] alpha - angle of attack (-pi < alpha < pi)
+//! \param[in] C - coefficient at each sample
+//! \param[in] dC - slope to the next sample
+//! \param[in] dalpha - sample spacing
+//! \param[in] inv_dalpha - 1 / sample spacing
+//! \param[in] ix_max - last interval
+//****************************************************************************80
+inline float Interp(float alpha, const float* C, const float* dC,
+    float dalpha, float inv_dalpha, int ix_max) {
+  float a = alpha + pi;
+  int ix = std::min(std::max((int)std::floor(a * inv_dalpha), 0), ix_max);
+  return C[ix] + dC[ix] * (a - dalpha * (float)ix);
+}
+
+//****************************************************************************80
+//! \brief RotationMatrix - rotation matrix (aircraft to world) of a unit
+//! quaternion, row major
+//****************************************************************************80
+inline void RotationMatrix(float qw, float qx, float qy, float qz,
+    float r[9]) {
+  float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+  float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+  float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+  r[0] = 1.0f - 2.0f * (yy + zz);
+  r[1] = 2.0f * (xy - wz);
+  r[2] = 2.0f * (xz + wy);
+  r[3] = 2.0f * (xy + wz);
+  r[4] = 1.0f - 2.0f * (xx + zz);
+  r[5] = 2.0f * (yz - wx);
+  r[6] = 2.0f * (xz - wy);
+  r[7] = 2.0f * (yz + wx);
+  r[8] = 1.0f - 2.0f * (xx + yy);
+}
+
+#ifdef AIRCRAFTBATCH_X86
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 AtanAVX2(__m256 x) {
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256 ax = _mm256_andnot_ps(sign_mask, x);
+  __m256 big = _mm256_cmp_ps(ax, one, _CMP_GT_OQ);
+  __m256 t = _mm256_blendv_ps(ax, _mm256_div_ps(one, ax), big);
+  __m256 t2 = _mm256_mul_ps(t, t);
+  __m256 p = _mm256_add_ps(_mm256_set1_ps(atan_c7),
+      _mm256_mul_ps(t2, _mm256_set1_ps(atan_c9)));
+  p = _mm256_add_ps(_mm256_set1_ps(atan_c5), _mm256_mul_ps(t2, p));
+  p = _mm256_add_ps(_mm256_set1_ps(atan_c3), _mm256_mul_ps(t2, p));
+  p = _mm256_add_ps(_mm256_set1_ps(atan_c1), _mm256_mul_ps(t2, p));
+  p = _mm256_mul_ps(t, p);
+  p = _mm256_blendv_ps(p, _mm256_sub_ps(_mm256_set1_ps(half_pi), p), big);
+  return _mm256_or_ps(p, _mm256_and_ps(sign_mask, x));
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 ExpAVX2(__m256 x) {
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)),
+      _mm256_set1_ps(88.0f));
+  __m256 n = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x,
+          _mm256_set1_ps(log2e)), _mm256_set1_ps(0.5f)));
+  __m256 f = _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(n,
+          _mm256_set1_ps(ln2_hi))), _mm256_mul_ps(n, _mm256_set1_ps(ln2_lo)));
+  __m256 p = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(exp_c6), f),
+      _mm256_set1_ps(exp_c5));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp_c4));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp_c3));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(exp_c2));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+  __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n),
+        _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 InterpAVX2(__m256 alpha, const float* C, const float* dC,
+    float dalpha, float inv_dalpha, int ix_max) {
+  __m256 a = _mm256_add_ps(alpha, _mm256_set1_ps(pi));
+  __m256i ix = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(a,
+          _mm256_set1_ps(inv_dalpha))));
+  ix = _mm256_min_epi32(_mm256_max_epi32(ix, _mm256_setzero_si256()),
+      _mm256_set1_epi32(ix_max));
+  __m256 c = _mm256_i32gather_ps(C, ix, 4);
+  __m256 dc = _mm256_i32gather_ps(dC, ix, 4);
+  return _mm256_add_ps(c, _mm256_mul_ps(dc, _mm256_sub_ps(a,
+          _mm256_mul_ps(_mm256_set1_ps(dalpha), _mm256_cvtepi32_ps(ix)))));
+}
+
+//****************************************************************************80
+//! \brief DotAVX2 - (a0*b0 + a1*b1) + a2*b2
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 DotAVX2(__m256 a0, __m256 a1, __m256 a2, __m256 b0,
+    __m256 b1, __m256 b2) {
+  return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, b0),
+        _mm256_mul_ps(a1, b1)), _mm256_mul_ps(a2, b2));
+}
+
+//****************************************************************************80
+//! \brief LoadDoubleAVX2 - load 8 doubles rounded to float
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 LoadDoubleAVX2(const double* p) {
+  __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(p));
+  __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(p + 4));
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+#endif
+
+//****************************************************************************80
+//! \brief HasAVX2 - true if the CPU supports the AVX2 path
+//****************************************************************************80
+bool HasAVX2() {
+#ifdef AIRCRAFTBATCH_X86
+  static const bool has_avx2 = []() {
+    __builtin_cpu_init();
+    return (bool)__builtin_cpu_supports("avx2");
+  }();
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+} // End anonymous namespace
+
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+AircraftBatchDynamics::AircraftBatchDynamics(
+    const AircraftDynamics& prototype) :
+  mass_(prototype.mass_),
+  inv_mass_(prototype.inv_mass_),
+  wetted_area_(prototype.wetted_area_),
+  chord_(prototype.chord_),
+  span_(prototype.span_),
+  dx_cg_x_ax_(prototype.dx_cg_x_ax_),
+  r_tail_(prototype.r_tail_),
+  max_thrust_(prototype.max_thrust_),
+  rudder_position_max_(prototype.rudder_position_max_),
+  elevator_position_max_(prototype.elevator_position_max_),
+  aileron_position_max_(prototype.aileron_position_max_),
+  CL_Q_(prototype.CL_Q_), Cm_Q_(prototype.Cm_Q_),
+  CL_alpha_dot_(prototype.CL_alpha_dot_),
+  Cm_alpha_dot_(prototype.Cm_alpha_dot_), CDi_CL2_(prototype.CDi_CL2_),
+  CY_beta_(prototype.CY_beta_), Cl_beta_(prototype.Cl_beta_),
+  Cl_P_(prototype.Cl_P_), Cl_R_(prototype.Cl_R_),
+  Cn_beta_(prototype.Cn_beta_), Cn_P_(prototype.Cn_P_),
+  Cn_R_(prototype.Cn_R_),
+  CL_de_(prototype.CL_de_), CD_de_(prototype.CD_de_),
+  CY_dr_(prototype.CY_dr_), Cm_de_(prototype.Cm_de_),
+  Cl_da_(prototype.Cl_da_), Cn_da_(prototype.Cn_da_),
+  Cl_dr_(prototype.Cl_dr_), Cn_dr_(prototype.Cn_dr_),
+  CL_(MakeAeroTable(prototype.CL_)),
+  CD_(MakeAeroTable(prototype.CD_)),
+  Cm_(MakeAeroTable(prototype.Cm_)) {
+  glm::mat3 inv_inertia = glm::inverse(prototype.inertia_);
+  inv_inertia_ = {{inv_inertia[0][0], inv_inertia[1][0], inv_inertia[2][0],
+    inv_inertia[1][1], inv_inertia[2][1], inv_inertia[2][2]}};
+}
+
+//****************************************************************************80
+std::size_t AircraftBatchDynamics::Add(const RigidBodyState& state) {
+  std::size_t i = Size();
+  for (std::vector<double>* v : {&x_, &y_, &z_}) {
+    v->push_back(0.0);
+  }
+  for (std::vector<float>* v : {&qw_, &qx_, &qy_, &qz_, &px_, &py_, &pz_,
+      &Lx_, &Ly_, &Lz_, &ax_, &ay_, &az_, &elevator_, &aileron_, &rudder_,
+      &throttle_, &fx_, &fy_, &fz_, &tx_, &ty_, &tz_}) {
+    v->push_back(0.0f);
+  }
+  SetState(i, state);
+  return i;
+}
+
+//****************************************************************************80
+void AircraftBatchDynamics::Remove(std::size_t i) {
+  std::size_t last = Size() - 1;
+  for (std::vector<double>* v : {&x_, &y_, &z_}) {
+    (*v)[i] = (*v)[last];
+    v->pop_back();
+  }
+  for (std::vector<float>* v : {&qw_, &qx_, &qy_, &qz_, &px_, &py_, &pz_,
+      &Lx_, &Ly_, &Lz_, &ax_, &ay_, &az_, &elevator_, &aileron_, &rudder_,
+      &throttle_, &fx_, &fy_, &fz_, &tx_, &ty_, &tz_}) {
+    (*v)[i] = (*v)[last];
+    v->pop_back();
+  }
+}
+
+//****************************************************************************80
+RigidBodyState AircraftBatchDynamics::GetState(std::size_t i) const {
+  RigidBodyState state;
+  state.position = glm::dvec3(x_[i], y_[i], z_[i]);
+  state.orientation = glm::dquat(qw_[i], qx_[i], qy_[i], qz_[i]);
+  state.lin_momentum = glm::dvec3(px_[i], py_[i], pz_[i]);
+  state.ang_momentum = glm::dvec3(Lx_[i], Ly_[i], Lz_[i]);
+  return state;
+}
+
+//****************************************************************************80
+void AircraftBatchDynamics::SetState(std::size_t i,
+    const RigidBodyState& state) {
+  x_[i] = state.position.x;
+  y_[i] = state.position.y;
+  z_[i] = state.position.z;
+  glm::dquat q = glm::normalize(state.orientation);
+  qw_[i] = (float)q.w;
+  qx_[i] = (float)q.x;
+  qy_[i] = (float)q.y;
+  qz_[i] = (float)q.z;
+  px_[i] = (float)state.lin_momentum.x;
+  py_[i] = (float)state.lin_momentum.y;
+  pz_[i] = (float)state.lin_momentum.z;
+  Lx_[i] = (float)state.ang_momentum.x;
+  Ly_[i] = (float)state.ang_momentum.y;
+  Lz_[i] = (float)state.ang_momentum.z;
+  ax_[i] = 0.0f;
+  ay_[i] = 0.0f;
+  az_[i] = 0.0f;
+}
+
+//****************************************************************************80
+void AircraftBatchDynamics::SetControls(std::size_t i, float elevator,
+    float aileron, float rudder, float throttle) {
+  elevator_[i] = std::min(std::max(elevator, -elevator_position_max_),
+      elevator_position_max_);
+  aileron_[i] = std::min(std::max(aileron, -aileron_position_max_),
+      aileron_position_max_);
+  rudder_[i] = std::min(std::max(rudder, -rudder_position_max_),
+      rudder_position_max_);
+  throttle_[i] = std::min(std::max(throttle, 0.0f), 1.0f);
+}
+
+//****************************************************************************80
+void AircraftBatchDynamics::DoPhysicsStep(float dt) {
+  CalcForcesAndTorques(0, Size());
+  Integrate(dt);
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+AircraftBatchDynamics::AeroTable AircraftBatchDynamics::MakeAeroTable(
+    const std::vector<float>& C) {
+  AeroTable table;
+  table.C = C;
+  table.dalpha = 2 * M_PI / (C.size() - 1);
+  table.inv_dalpha = 1.0f / table.dalpha;
+  table.ix_max = (int)C.size() - 2;
+  table.dC.resize(C.size(), 0.0f);
+  for (std::size_t i = 0; i + 1 < C.size(); ++i) {
+    table.dC[i] = (C[i+1] - C[i]) / table.dalpha;
+  }
+  return table;
+}
+
+//****************************************************************************80
+void AircraftBatchDynamics::CalcForcesAndTorques(std::size_t begin,
+    std::size_t end) {
+#ifdef AIRCRAFTBATCH_X86
+  if (HasAVX2()) {
+    CalcForcesAndTorquesAVX2(begin, end);
+    return;
+  }
+#endif
+  CalcForcesAndTorquesScalar(begin, end);
+}
+
+//****************************************************************************80
+void AircraftBatchDynamics::CalcForcesAndTorquesScalar(std::size_t begin,
+    std::size_t end) {
+  const float eps = std::numeric_limits<float>::epsilon();
+  const float half_chord = chord_ / 2.0f;
+  const float half_span = span_ / 2.0f;
+  const float weight = mass_ * 9.81f;
+  const std::array<float,6>& ii = inv_inertia_;
+  for (std::size_t i = begin; i < end; ++i) {
+    float r[9];
+    RotationMatrix(qw_[i], qx_[i], qy_[i], qz_[i], r);
+
+    // Velocity, angular velocity and last acceleration in aircraft frame
+    float vwx = px_[i] * inv_mass_;
+    float vwy = py_[i] * inv_mass_;
+    float vwz = pz_[i] * inv_mass_;
+    float u = (r[0] * vwx + r[3] * vwy) + r[6] * vwz;
+    float v = (r[1] * vwx + r[4] * vwy) + r[7] * vwz;
+    float w = (r[2] * vwx + r[5] * vwy) + r[8] * vwz;
+    float lbx = (r[0] * Lx_[i] + r[3] * Ly_[i]) + r[6] * Lz_[i];
+    float lby = (r[1] * Lx_[i] + r[4] * Ly_[i]) + r[7] * Lz_[i];
+    float lbz = (r[2] * Lx_[i] + r[5] * Ly_[i]) + r[8] * Lz_[i];
+    float ox = (ii[0] * lbx + ii[1] * lby) + ii[2] * lbz;
+    float oy = (ii[1] * lbx + ii[3] * lby) + ii[4] * lbz;
+    float oz = (ii[2] * lbx + ii[4] * lby) + ii[5] * lbz;
+    // The stored acceleration is rotated once more, as AircraftDynamics does
+    float aax = (r[0] * ax_[i] + r[3] * ay_[i]) + r[6] * az_[i];
+    float aaz = (r[2] * ax_[i] + r[5] * ay_[i]) + r[8] * az_[i];
+
+    // Angle of attack, sideslip and their rates
+    float h2 = u * u + w * w;
+    float vt = std::sqrt(h2 + v * v);
+    float h = std::sqrt(h2);
+    bool small_u = std::abs(u) < eps;
+    bool small_h = h2 < eps;
+    float alpha = small_u ? 0.0f : Atan(w / u);
+    float cos_alpha = small_u ? 1.0f : std::abs(u) / h;
+    float sin_alpha = small_u ? 0.0f : (std::signbit(u) ? -w : w) / h;
+    float beta = small_h ? 0.0f : Atan(v / h);
+    float cos_beta = small_h ? 1.0f : h / vt;
+    float sin_beta = small_h ? 0.0f : v / vt;
+    float alpha_dot = small_h ? 0.0f : (u * aaz - w * aax) / h2;
+    float cx = oy * r_tail_.z - oz * r_tail_.y;
+    float cy = oz * r_tail_.x - ox * r_tail_.z;
+    float cz = ox * r_tail_.y - oy * r_tail_.x;
+    float dve = std::sqrt((cx * cx + cy * cy) + cz * cz);
+    float rho = rho_sea_level * Exp((float)y_[i] * neg_inv_scale_height);
+    float qS = (((0.5f * rho) * vt) * vt) * wetted_area_;
+    float vtd = vt + dve;
+    float k = (vtd * vtd) / (vt * vt);
+    float hc = half_chord / vt;
+    float hs = half_span / vt;
+
+    // Aerodynamic forces and torques
+    float de = elevator_[i];
+    float da = aileron_[i];
+    float dr = rudder_[i];
+    float CLa = Interp(alpha, CL_.C.data(), CL_.dC.data(), CL_.dalpha,
+        CL_.inv_dalpha, CL_.ix_max);
+    float CDa = Interp(alpha, CD_.C.data(), CD_.dC.data(), CD_.dalpha,
+        CD_.inv_dalpha, CD_.ix_max);
+    float Cma = Interp(alpha, Cm_.C.data(), Cm_.dC.data(), Cm_.dalpha,
+        Cm_.inv_dalpha, Cm_.ix_max);
+    float lift = qS * ((CLa + (CL_Q_ * oy + CL_alpha_dot_ * alpha_dot) *
+          hc) + (CL_de_ * de) * k);
+    float CLt = lift / qS;
+    float drag = qS * ((CDa + (CLt * CLt) * CDi_CL2_) +
+        (CD_de_ * std::abs(de)) * k);
+    // Same control input as AircraftDynamics::CalcSideForce
+    float side = qS * (CY_beta_ * beta + CY_dr_ * de);
+    float fbx = (lift * sin_alpha - drag * cos_alpha) - side * sin_beta;
+    float fby = side * cos_beta;
+    float fbz = -(lift * cos_alpha) - drag * sin_alpha;
+    float tbx = (qS * span_) * ((Cl_beta_ * beta + (Cl_P_ * ox + Cl_R_ * oz) *
+          hs) + (Cl_da_ * da + Cl_dr_ * dr));
+    float tby = (qS * chord_) * ((Cma + (Cm_Q_ * oy + Cm_alpha_dot_ *
+            alpha_dot) * hc) + (Cm_de_ * de) * k) + (dx_cg_x_ax_ * chord_) *
+      (lift * cos_alpha + drag * sin_alpha);
+    float tbz = (qS * span_) * ((Cn_beta_ * beta + (Cn_P_ * ox + Cn_R_ * oz) *
+          hs) + (Cn_da_ * da + Cn_dr_ * dr));
+    bool moving = vt > eps;
+    fbx = (moving ? fbx : 0.0f) + max_thrust_ * throttle_[i];
+    fby = moving ? fby : 0.0f;
+    fbz = moving ? fbz : 0.0f;
+    tbx = moving ? tbx : 0.0f;
+    tby = moving ? tby : 0.0f;
+    tbz = moving ? tbz : 0.0f;
+
+    // Rotate to world frame and add gravity
+    float fwx = (r[0] * fbx + r[1] * fby) + r[2] * fbz;
+    float fwy = ((r[3] * fbx + r[4] * fby) + r[5] * fbz) - weight;
+    float fwz = (r[6] * fbx + r[7] * fby) + r[8] * fbz;
+    fx_[i] = fwx;
+    fy_[i] = fwy;
+    fz_[i] = fwz;
+    tx_[i] = (r[0] * tbx + r[1] * tby) + r[2] * tbz;
+    ty_[i] = (r[3] * tbx + r[4] * tby) + r[5] * tbz;
+    tz_[i] = (r[6] * tbx + r[7] * tby) + r[8] * tbz;
+
+    // Acceleration in aircraft frame
+    float awx = fwx * inv_mass_;
+    float awy = fwy * inv_mass_;
+    float awz = fwz * inv_mass_;
+    ax_[i] = (r[0] * awx + r[3] * awy) + r[6] * awz;
+    ay_[i] = (r[1] * awx + r[4] * awy) + r[7] * awz;
+    az_[i] = (r[2] * awx + r[5] * awy) + r[8] * awz;
+  }
+}
+
+//****************************************************************************80
+#ifdef AIRCRAFTBATCH_X86
+__attribute__((target("avx2")))
+void AircraftBatchDynamics::CalcForcesAndTorquesAVX2(std::size_t begin,
+    std::size_t end) {
+  const __m256 eps = _mm256_set1_ps(std::numeric_limits<float>::epsilon());
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 inv_mass = _mm256_set1_ps(inv_mass_);
+  const __m256 half_chord = _mm256_set1_ps(chord_ / 2.0f);
+  const __m256 half_span = _mm256_set1_ps(span_ / 2.0f);
+  const __m256 weight = _mm256_set1_ps(mass_ * 9.81f);
+  const __m256 i0 = _mm256_set1_ps(inv_inertia_[0]);
+  const __m256 i1 = _mm256_set1_ps(inv_inertia_[1]);
+  const __m256 i2 = _mm256_set1_ps(inv_inertia_[2]);
+  const __m256 i3 = _mm256_set1_ps(inv_inertia_[3]);
+  const __m256 i4 = _mm256_set1_ps(inv_inertia_[4]);
+  const __m256 i5 = _mm256_set1_ps(inv_inertia_[5]);
+  const __m256 rtx = _mm256_set1_ps(r_tail_.x);
+  const __m256 rty = _mm256_set1_ps(r_tail_.y);
+  const __m256 rtz = _mm256_set1_ps(r_tail_.z);
+  std::size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    // Rotation matrix (aircraft to world)
+    __m256 qw = _mm256_loadu_ps(&qw_[i]);
+    __m256 qx = _mm256_loadu_ps(&qx_[i]);
+    __m256 qy = _mm256_loadu_ps(&qy_[i]);
+    __m256 qz = _mm256_loadu_ps(&qz_[i]);
+    __m256 xx = _mm256_mul_ps(qx, qx);
+    __m256 yy = _mm256_mul_ps(qy, qy);
+    __m256 zz = _mm256_mul_ps(qz, qz);
+    __m256 xy = _mm256_mul_ps(qx, qy);
+    __m256 xz = _mm256_mul_ps(qx, qz);
+    __m256 yz = _mm256_mul_ps(qy, qz);
+    __m256 wx = _mm256_mul_ps(qw, qx);
+    __m256 wy = _mm256_mul_ps(qw, qy);
+    __m256 wz = _mm256_mul_ps(qw, qz);
+    __m256 r0 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+    __m256 r1 = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+    __m256 r2 = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+    __m256 r3 = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+    __m256 r4 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+    __m256 r5 = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+    __m256 r6 = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+    __m256 r7 = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+    __m256 r8 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+
+    // Velocity, angular velocity and last acceleration in aircraft frame
+    __m256 vwx = _mm256_mul_ps(_mm256_loadu_ps(&px_[i]), inv_mass);
+    __m256 vwy = _mm256_mul_ps(_mm256_loadu_ps(&py_[i]), inv_mass);
+    __m256 vwz = _mm256_mul_ps(_mm256_loadu_ps(&pz_[i]), inv_mass);
+    __m256 u = DotAVX2(r0, r3, r6, vwx, vwy, vwz);
+    __m256 v = DotAVX2(r1, r4, r7, vwx, vwy, vwz);
+    __m256 w = DotAVX2(r2, r5, r8, vwx, vwy, vwz);
+    __m256 Lx = _mm256_loadu_ps(&Lx_[i]);
+    __m256 Ly = _mm256_loadu_ps(&Ly_[i]);
+    __m256 Lz = _mm256_loadu_ps(&Lz_[i]);
+    __m256 lbx = DotAVX2(r0, r3, r6, Lx, Ly, Lz);
+    __m256 lby = DotAVX2(r1, r4, r7, Lx, Ly, Lz);
+    __m256 lbz = DotAVX2(r2, r5, r8, Lx, Ly, Lz);
+    __m256 ox = DotAVX2(i0, i1, i2, lbx, lby, lbz);
+    __m256 oy = DotAVX2(i1, i3, i4, lbx, lby, lbz);
+    __m256 oz = DotAVX2(i2, i4, i5, lbx, lby, lbz);
+    __m256 ax = _mm256_loadu_ps(&ax_[i]);
+    __m256 ay = _mm256_loadu_ps(&ay_[i]);
+    __m256 az = _mm256_loadu_ps(&az_[i]);
+    __m256 aax = DotAVX2(r0, r3, r6, ax, ay, az);
+    __m256 aaz = DotAVX2(r2, r5, r8, ax, ay, az);
+
+    // Angle of attack, sideslip and their rates
+    __m256 h2 = _mm256_add_ps(_mm256_mul_ps(u, u), _mm256_mul_ps(w, w));
+    __m256 vt = _mm256_sqrt_ps(_mm256_add_ps(h2, _mm256_mul_ps(v, v)));
+    __m256 h = _mm256_sqrt_ps(h2);
+    __m256 abs_u = _mm256_andnot_ps(sign_mask, u);
+    __m256 small_u = _mm256_cmp_ps(abs_u, eps, _CMP_LT_OQ);
+    __m256 small_h = _mm256_cmp_ps(h2, eps, _CMP_LT_OQ);
+    __m256 alpha = _mm256_blendv_ps(AtanAVX2(_mm256_div_ps(w, u)), zero,
+        small_u);
+    __m256 cos_alpha = _mm256_blendv_ps(_mm256_div_ps(abs_u, h), one,
+        small_u);
+    __m256 sin_alpha = _mm256_blendv_ps(_mm256_div_ps(_mm256_xor_ps(w,
+            _mm256_and_ps(sign_mask, u)), h), zero, small_u);
+    __m256 beta = _mm256_blendv_ps(AtanAVX2(_mm256_div_ps(v, h)), zero,
+        small_h);
+    __m256 cos_beta = _mm256_blendv_ps(_mm256_div_ps(h, vt), one, small_h);
+    __m256 sin_beta = _mm256_blendv_ps(_mm256_div_ps(v, vt), zero, small_h);
+    __m256 alpha_dot = _mm256_blendv_ps(_mm256_div_ps(_mm256_sub_ps(
+            _mm256_mul_ps(u, aaz), _mm256_mul_ps(w, aax)), h2), zero,
+        small_h);
+    __m256 cx = _mm256_sub_ps(_mm256_mul_ps(oy, rtz), _mm256_mul_ps(oz, rty));
+    __m256 cy = _mm256_sub_ps(_mm256_mul_ps(oz, rtx), _mm256_mul_ps(ox, rtz));
+    __m256 cz = _mm256_sub_ps(_mm256_mul_ps(ox, rty), _mm256_mul_ps(oy, rtx));
+    __m256 dve = _mm256_sqrt_ps(DotAVX2(cx, cy, cz, cx, cy, cz));
+    __m256 rho = _mm256_mul_ps(_mm256_set1_ps(rho_sea_level),
+        ExpAVX2(_mm256_mul_ps(LoadDoubleAVX2(&y_[i]),
+            _mm256_set1_ps(neg_inv_scale_height))));
+    __m256 qS = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(
+              _mm256_set1_ps(0.5f), rho), vt), vt),
+        _mm256_set1_ps(wetted_area_));
+    __m256 vtd = _mm256_add_ps(vt, dve);
+    __m256 k = _mm256_div_ps(_mm256_mul_ps(vtd, vtd), _mm256_mul_ps(vt, vt));
+    __m256 hc = _mm256_div_ps(half_chord, vt);
+    __m256 hs = _mm256_div_ps(half_span, vt);
+
+    // Aerodynamic forces and torques
+    __m256 de = _mm256_loadu_ps(&elevator_[i]);
+    __m256 da = _mm256_loadu_ps(&aileron_[i]);
+    __m256 dr = _mm256_loadu_ps(&rudder_[i]);
+    __m256 CLa = InterpAVX2(alpha, CL_.C.data(), CL_.dC.data(), CL_.dalpha,
+        CL_.inv_dalpha, CL_.ix_max);
+    __m256 CDa = InterpAVX2(alpha, CD_.C.data(), CD_.dC.data(), CD_.dalpha,
+        CD_.inv_dalpha, CD_.ix_max);
+    __m256 Cma = InterpAVX2(alpha, Cm_.C.data(), Cm_.dC.data(), Cm_.dalpha,
+        Cm_.inv_dalpha, Cm_.ix_max);
+    __m256 lift = _mm256_mul_ps(qS, _mm256_add_ps(_mm256_add_ps(CLa,
+            _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(
+                  _mm256_set1_ps(CL_Q_), oy), _mm256_mul_ps(
+                  _mm256_set1_ps(CL_alpha_dot_), alpha_dot)), hc)),
+          _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(CL_de_), de), k)));
+    __m256 CLt = _mm256_div_ps(lift, qS);
+    __m256 drag = _mm256_mul_ps(qS, _mm256_add_ps(_mm256_add_ps(CDa,
+            _mm256_mul_ps(_mm256_mul_ps(CLt, CLt),
+              _mm256_set1_ps(CDi_CL2_))), _mm256_mul_ps(_mm256_mul_ps(
+              _mm256_set1_ps(CD_de_), _mm256_andnot_ps(sign_mask, de)), k)));
+    __m256 side = _mm256_mul_ps(qS, _mm256_add_ps(_mm256_mul_ps(
+            _mm256_set1_ps(CY_beta_), beta), _mm256_mul_ps(
+            _mm256_set1_ps(CY_dr_), de)));
+    __m256 fbx = _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(lift, sin_alpha),
+          _mm256_mul_ps(drag, cos_alpha)), _mm256_mul_ps(side, sin_beta));
+    __m256 fby = _mm256_mul_ps(side, cos_beta);
+    __m256 fbz = _mm256_sub_ps(_mm256_xor_ps(sign_mask, _mm256_mul_ps(lift,
+            cos_alpha)), _mm256_mul_ps(drag, sin_alpha));
+    __m256 qSb = _mm256_mul_ps(qS, _mm256_set1_ps(span_));
+    __m256 qSc = _mm256_mul_ps(qS, _mm256_set1_ps(chord_));
+    __m256 tbx = _mm256_mul_ps(qSb, _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(_mm256_set1_ps(Cl_beta_), beta), _mm256_mul_ps(
+              _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Cl_P_), ox),
+                _mm256_mul_ps(_mm256_set1_ps(Cl_R_), oz)), hs)),
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Cl_da_), da),
+            _mm256_mul_ps(_mm256_set1_ps(Cl_dr_), dr))));
+    __m256 tby = _mm256_add_ps(_mm256_mul_ps(qSc, _mm256_add_ps(
+            _mm256_add_ps(Cma, _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(
+                    _mm256_set1_ps(Cm_Q_), oy), _mm256_mul_ps(
+                    _mm256_set1_ps(Cm_alpha_dot_), alpha_dot)), hc)),
+            _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(Cm_de_), de), k))),
+        _mm256_mul_ps(_mm256_set1_ps(dx_cg_x_ax_ * chord_), _mm256_add_ps(
+            _mm256_mul_ps(lift, cos_alpha), _mm256_mul_ps(drag,
+              sin_alpha))));
+    __m256 tbz = _mm256_mul_ps(qSb, _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(_mm256_set1_ps(Cn_beta_), beta), _mm256_mul_ps(
+              _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Cn_P_), ox),
+                _mm256_mul_ps(_mm256_set1_ps(Cn_R_), oz)), hs)),
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Cn_da_), da),
+            _mm256_mul_ps(_mm256_set1_ps(Cn_dr_), dr))));
+    __m256 moving = _mm256_cmp_ps(vt, eps, _CMP_GT_OQ);
+    fbx = _mm256_add_ps(_mm256_and_ps(moving, fbx), _mm256_mul_ps(
+          _mm256_set1_ps(max_thrust_), _mm256_loadu_ps(&throttle_[i])));
+    fby = _mm256_and_ps(moving, fby);
+    fbz = _mm256_and_ps(moving, fbz);
+    tbx = _mm256_and_ps(moving, tbx);
+    tby = _mm256_and_ps(moving, tby);
+    tbz = _mm256_and_ps(moving, tbz);
+
+    // Rotate to world frame and add gravity
+    __m256 fwx = DotAVX2(r0, r1, r2, fbx, fby, fbz);
+    __m256 fwy = _mm256_sub_ps(DotAVX2(r3, r4, r5, fbx, fby, fbz), weight);
+    __m256 fwz = DotAVX2(r6, r7, r8, fbx, fby, fbz);
+    _mm256_storeu_ps(&fx_[i], fwx);
+    _mm256_storeu_ps(&fy_[i], fwy);
+    _mm256_storeu_ps(&fz_[i], fwz);
+    _mm256_storeu_ps(&tx_[i], DotAVX2(r0, r1, r2, tbx, tby, tbz));
+    _mm256_storeu_ps(&ty_[i], DotAVX2(r3, r4, r5, tbx, tby, tbz));
+    _mm256_storeu_ps(&tz_[i], DotAVX2(r6, r7, r8, tbx, tby, tbz));
+
+    // Acceleration in aircraft frame
+    __m256 awx = _mm256_mul_ps(fwx, inv_mass);
+    __m256 awy = _mm256_mul_ps(fwy, inv_mass);
+    __m256 awz = _mm256_mul_ps(fwz, inv_mass);
+    _mm256_storeu_ps(&ax_[i], DotAVX2(r0, r3, r6, awx, awy, awz));
+    _mm256_storeu_ps(&ay_[i], DotAVX2(r1, r4, r7, awx, awy, awz));
+    _mm256_storeu_ps(&az_[i], DotAVX2(r2, r5, r8, awx, awy, awz));
+  }
+  CalcForcesAndTorquesScalar(i, end);
+}
+#else
+void AircraftBatchDynamics::CalcForcesAndTorquesAVX2(std::size_t begin,
+    std::size_t end) {
+  CalcForcesAndTorquesScalar(begin, end);
+}
+#endif
+
+//****************************************************************************80
+void AircraftBatchDynamics::Integrate(float dt) {
+  const std::array<float,6>& ii = inv_inertia_;
+  for (std::size_t i = 0; i < Size(); ++i) {
+    // Update momentum due to forces/torques
+    px_[i] += fx_[i] * dt;
+    py_[i] += fy_[i] * dt;
+    pz_[i] += fz_[i] * dt;
+    Lx_[i] += tx_[i] * dt;
+    Ly_[i] += ty_[i] * dt;
+    Lz_[i] += tz_[i] * dt;
+
+    // Update positions
+    x_[i] += px_[i] * inv_mass_ * dt;
+    y_[i] += py_[i] * inv_mass_ * dt;
+    z_[i] += pz_[i] * inv_mass_ * dt;
+
+    // Angular velocity in world frame, R I^-1 R^T L
+    float r[9];
+    RotationMatrix(qw_[i], qx_[i], qy_[i], qz_[i], r);
+    float lbx = (r[0] * Lx_[i] + r[3] * Ly_[i]) + r[6] * Lz_[i];
+    float lby = (r[1] * Lx_[i] + r[4] * Ly_[i]) + r[7] * Lz_[i];
+    float lbz = (r[2] * Lx_[i] + r[5] * Ly_[i]) + r[8] * Lz_[i];
+    float obx = (ii[0] * lbx + ii[1] * lby) + ii[2] * lbz;
+    float oby = (ii[1] * lbx + ii[3] * lby) + ii[4] * lbz;
+    float obz = (ii[2] * lbx + ii[4] * lby) + ii[5] * lbz;
+    float ox = (r[0] * obx + r[1] * oby) + r[2] * obz;
+    float oy = (r[3] * obx + r[4] * oby) + r[5] * obz;
+    float oz = (r[6] * obx + r[7] * oby) + r[8] * obz;
+
+    // Update the orientation with the spin 0.5 * (0, omega) * q, and keep it
+    // unit length
+    float hdt = 0.5f * dt;
+    float qw = qw_[i], qx = qx_[i], qy = qy_[i], qz = qz_[i];
+    qw += hdt * (-(ox * qx) - oy * qy - oz * qz);
+    qx += hdt * (ox * qw_[i] + oy * qz_[i] - oz * qy_[i]);
+    qy += hdt * (oy * qw_[i] + oz * qx_[i] - ox * qz_[i]);
+    qz += hdt * (oz * qw_[i] + ox * qy_[i] - oy * qx_[i]);
+    float inv_norm = 1.0f / std::sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+    qw_[i] = qw * inv_norm;
+    qx_[i] = qx * inv_norm;
+    qy_[i] = qy * inv_norm;
+    qz_[i] = qz * inv_norm;
+  }
+}
+
+} // End namespace TopFun
@@ -0,0 +1,171 @@
+#ifndef AIRCRAFTBATCHDYNAMICS_H
+#define AIRCRAFTBATCHDYNAMICS_H
+
+#include <vector>
+#include <array>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "aircraft/AircraftDynamics.h"
+#include "aircraft/RigidBodyState.h"
+
+// Flight model of many aircraft of one type, stepped together. The states
+// and control inputs are stored as structure of arrays, and the aero model
+// of AircraftDynamics is evaluated across aircraft, 8 at a time with AVX2
+// when the CPU supports it. The scalar and AVX2 paths perform the same
+// float operations in the same order, so they give bit-identical results.
+// The model matches AircraftDynamics stepped with semi-implicit Euler,
+// except that atan/exp are evaluated by polynomials (to about 1e-5) and
+// terrain contacts are not resolved
+
+namespace TopFun {
+
+class AircraftBatchDynamics {
+
+ public:
+  //**************************************************************************80
+  //! \brief AircraftBatchDynamics - Constructor for an empty batch
+  //! \param[in] prototype - aircraft whose flight model parameters are used
+  //**************************************************************************80
+  explicit AircraftBatchDynamics(const AircraftDynamics& prototype);
+
+  //**************************************************************************80
+  //! \brief ~AircraftBatchDynamics - Destructor
+  //**************************************************************************80
+  ~AircraftBatchDynamics() = default;
+
+  //**************************************************************************80
+  //! \brief Add - add an aircraft with zero control inputs
+  //! \param[in] state - initial state of the aircraft
+  //! \returns index of the aircraft
+  //**************************************************************************80
+  std::size_t Add(const RigidBodyState& state);
+
+  //**************************************************************************80
+  //! \brief Remove - remove an aircraft, the last aircraft takes its index
+  //! \param[in] i - index of the aircraft
+  //**************************************************************************80
+  void Remove(std::size_t i);
+
+  //**************************************************************************80
+  //! \brief Size - number of aircraft in the batch
+  //**************************************************************************80
+  inline std::size_t Size() const { return x_.size(); }
+
+  //**************************************************************************80
+  //! \brief GetState - get the position/orientation/momentum state of an
+  //! aircraft
+  //! \param[in] i - index of the aircraft
+  //**************************************************************************80
+  RigidBodyState GetState(std::size_t i) const;
+
+  //**************************************************************************80
+  //! \brief SetState - set the position/orientation/momentum state of an
+  //! aircraft
+  //! \param[in] i - index of the aircraft
+  //! \param[in] state - aircraft state
+  //**************************************************************************80
+  void SetState(std::size_t i, const RigidBodyState& state);
+
+  //**************************************************************************80
+  //! \brief SetControls - set the control inputs of an aircraft, clamped to
+  //! the ranges of the prototype
+  //! \param[in] i - index of the aircraft
+  //! \param[in] elevator - elevator position
+  //! \param[in] aileron - aileron position
+  //! \param[in] rudder - rudder position
+  //! \param[in] throttle - throttle position (between 0.0 and 1.0)
+  //**************************************************************************80
+  void SetControls(std::size_t i, float elevator, float aileron,
+      float rudder, float throttle);
+
+  //**************************************************************************80
+  //! \brief DoPhysicsStep - integrate all aircraft over one step
+  //! \param[in] dt - physics timestep
+  //**************************************************************************80
+  void DoPhysicsStep(float dt);
+
+ private:
+  // Flight model, copied from the prototype
+  float mass_;
+  float inv_mass_;
+  std::array<float,6> inv_inertia_; // xx, xy, xz, yy, yz, zz (aircraft frame)
+  float wetted_area_;
+  float chord_;
+  float span_;
+  float dx_cg_x_ax_;
+  glm::vec3 r_tail_;
+  float max_thrust_;
+  float rudder_position_max_;
+  float elevator_position_max_;
+  float aileron_position_max_;
+  float CL_Q_, Cm_Q_, CL_alpha_dot_, Cm_alpha_dot_, CDi_CL2_;
+  float CY_beta_, Cl_beta_, Cl_P_, Cl_R_, Cn_beta_, Cn_P_, Cn_R_;
+  float CL_de_, CD_de_, CY_dr_, Cm_de_, Cl_da_, Cn_da_, Cl_dr_, Cn_dr_;
+
+  // Coefficient vs alpha table, sampled uniformly on [-pi, pi]
+  struct AeroTable {
+    std::vector<float> C; // coefficient at each sample
+    std::vector<float> dC; // slope to the next sample
+    float inv_dalpha; // 1 / sample spacing
+    float dalpha; // sample spacing
+    int ix_max; // last interval
+  };
+  AeroTable CL_; // lift coefficient vs alpha
+  AeroTable CD_; // drag coefficient vs alpha
+  AeroTable Cm_; // moment coefficient vs alpha
+
+  // State (all in world frame), one entry per aircraft
+  std::vector<double> x_, y_, z_; // position
+  std::vector<float> qw_, qx_, qy_, qz_; // orientation
+  std::vector<float> px_, py_, pz_; // linear momentum
+  std::vector<float> Lx_, Ly_, Lz_; // angular momentum
+  // Acceleration of the last step in aircraft frame, for the alpha rate
+  std::vector<float> ax_, ay_, az_;
+
+  // Control inputs
+  std::vector<float> elevator_;
+  std::vector<float> aileron_;
+  std::vector<float> rudder_;
+  std::vector<float> throttle_;
+
+  // Forces and torques of the current step (world frame)
+  std::vector<float> fx_, fy_, fz_;
+  std::vector<float> tx_, ty_, tz_;
+
+  //**************************************************************************80
+  //! \brief MakeAeroTable - sample spacing and slopes of a coefficient table
+  //! \param[in] C - coefficient at each sample
+  //**************************************************************************80
+  static AeroTable MakeAeroTable(const std::vector<float>& C);
+
+  //**************************************************************************80
+  //! \brief CalcForcesAndTorques - evaluate the aero, engine and gravity
+  //! forces/torques of aircraft [begin, end) into the force/torque arrays
+  //! and update their accelerations
+  //**************************************************************************80
+  void CalcForcesAndTorques(std::size_t begin, std::size_t end);
+
+  //**************************************************************************80
+  //! \brief CalcForcesAndTorquesScalar - portable path of
+  //! CalcForcesAndTorques
+  //**************************************************************************80
+  void CalcForcesAndTorquesScalar(std::size_t begin, std::size_t end);
+
+  //**************************************************************************80
+  //! \brief CalcForcesAndTorquesAVX2 - 8-wide AVX2 path of
+  //! CalcForcesAndTorques
+  //**************************************************************************80
+  void CalcForcesAndTorquesAVX2(std::size_t begin, std::size_t end);
+
+  //**************************************************************************80
+  //! \brief Integrate - update momenta from the forces/torques, then
+  //! positions/orientations from the momenta (semi-implicit Euler)
+  //**************************************************************************80
+  void Integrate(float dt);
+
+};
+} // End namespace TopFun
+
+#endif
@@ -0,0 +1,435 @@
+#include <limits>
+#include <stdexcept>
+
+#include "aircraft/AircraftDynamics.h"
+#include "terrain/TerrainCore.h"
+
+namespace TopFun {
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+PhysicsIntegrator ParsePhysicsIntegrator(const std::string& name) {
+  if (name == "euler") return PhysicsIntegrator::semi_implicit_euler;
+  if (name == "rk4") return PhysicsIntegrator::rk4;
+  if (name == "lie") return PhysicsIntegrator::lie_group;
+  throw std::invalid_argument("Unknown physics integrator " + name + 
+      " (expected euler, rk4 or lie)\n");
+}
+
+//****************************************************************************80
+AircraftDynamics::AircraftDynamics(const glm::dvec3& position, 
+    const glm::quat& orientation, const TerrainCore& terrain) :
+    position_(position), orientation_(orientation), 
+    lin_momentum_(AircraftToWorld(glm::vec3(27000.0f * 150.0f, 0.0f, 0.0f), 
+          orientation)), 
+    ang_momentum_(0.0f, 0.0f, 0.0f),
+    terrain_(terrain),
+    collision_mesh_(
+        "../../../assets/models/FA-22_Raptor/FA-22_Raptor_Convex_Hull.obj"),
+    acceleration_(0.0f, 0.0f, 0.0f), 
+    crashed_(false),
+    integrator_(PhysicsIntegrator::semi_implicit_euler) {
+  // Set the physical dimensions of the aircraft
+  mass_ = 27000.0f;
+  inv_mass_ = 1.0f / mass_;
+  // y+/-: for/aft, z+/-: up-down
+  delta_center_of_mass_ = glm::dvec3(0.0f, 0.0f, -1.0f);
+  inertia_[0][0] = 22000.0f;       // I_xx
+  inertia_[1][1] = 162000.0f;      // I_yy
+  inertia_[2][2] = 178000.0f;      // I_zz
+  inertia_[0][2] = -2874.0f;       // I_xz
+  inertia_[2][0] = inertia_[0][2]; // I_zx
+  e_collision_ = 0.1f;
+  mu_static_ = 1.0f;
+  mu_dynamic_ = 0.5f;
+  wetted_area_ = 316.0f;
+  chord_ = 5.75f;
+  span_ = 13.56f;
+  dx_cg_x_ax_ = 0.05f;
+  r_tail_ = glm::vec3(-4.8f, 0.0f, 0.0f);
+  max_thrust_ = 311000.0f;
+  collision_radius_ = 0.0f;
+  for (const glm::vec3& v : collision_mesh_.GetVertices()) {
+    collision_radius_ = std::max(collision_radius_, 
+        glm::length(v - delta_center_of_mass_));
+  }
+  std::size_t num_cm_verts = collision_mesh_.GetVertices().size();
+  contacts_.reserve(num_cm_verts);
+  contact_verts_r_.reserve(num_cm_verts);
+  contact_x_w_.reserve(num_cm_verts);
+  contact_z_w_.reserve(num_cm_verts);
+  contact_y_terrain_.reserve(num_cm_verts);
+
+  // Define the aerodynamic performance coefficients
+  CL_ = {0.26, 0.1, 0.2, 0.24, 0.07, 0.0, // (-pi/2, 0] 
+    -0.03, -0.14, -0.2, -0.1, -0.2, -0.3, // (0, pi/2]
+    0.0, 0.55, 0.45, 0.3, 0.14, 0.07, 0.0, // (pi/2, pi]
+    -0.07, -0.14, -0.2, -0.1, -0.2, 0.0};
+  CD_ = {0.03, 0.11, 0.2, 0.4, 0.6, 0.8, 
+    1.0, 0.8, 0.6, 0.4, 0.25, 0.11, // (-pi/2, 0]
+    0.03, 0.11, 0.25, 0.4, 0.6, 0.8, // (0, pi/2]
+    1.0, 0.8, 0.6, 0.4, 0.25, 0.11, 0.03}; // (pi/2, pi]
+  CL_Q_ = 0.0f;
+  Cm_Q_ = -3.6f;
+  CL_alpha_dot_ = 0.72f;
+  Cm_alpha_dot_ = -1.1f;
+  float e = 1.0f / (1.05f + 0.007f * M_PI * span_ / chord_);
+  CDi_CL2_ = 1.0f / (M_PI * e * span_ / chord_);
+  CY_beta_ = -0.98f;
+  Cl_beta_ = -0.12f;
+  Cl_P_ = -0.26f; 
+  Cl_R_ = 0.14f; 
+  Cn_beta_ = 0.25f; 
+  Cn_P_ = 0.022f; 
+  Cn_R_ = -0.35f; 
+  CL_de_ = 0.12f; 
+  CD_de_ = 0.08f; 
+  CY_dr_ = 0.12f; 
+  Cm_de_ = -0.4f; 
+  Cl_da_ = 0.02f; 
+  Cn_da_ = 0.06f; 
+  Cl_dr_ = -0.001f; 
+  Cn_dr_ = 0.04f; 
+  
+  // Set the initial values for control inputs
+  rudder_position_   = 0.0f;
+  elevator_position_ = 0.0f;
+  aileron_position_  = 0.0f;
+  throttle_position_ = 1.0f;
+
+  // Design Cm_ so the aircraft is stable
+  float dCL_dalpha0 = (CL_[1] - CL_[0]) / (2 * M_PI / (CL_.size() - 1));
+  float vt = glm::l2Norm(lin_momentum_) * inv_mass_;
+  float q = 0.5f * 1.225f * vt * vt;
+  float alpha0 = (mass_ * 9.81f / q / wetted_area_ - CL_[0]) / dCL_dalpha0;
+  glm::vec3 omega(0.0f, 0.0f, 0.0f);
+  float lift0 = CalcLift(alpha0, 0.0f, omega, vt, 0.0f, q, 0.0f);
+  float drag0 = CalcDrag(lift0, alpha0, vt, 0.0f, q, 0.0f);
+  float M_LD0 = dx_cg_x_ax_ * chord_ * (lift0*cos(alpha0) + drag0*sin(alpha0));
+  float alpha1 = alpha0 + glm::radians(0.01f);
+  float lift1 = CalcLift(alpha1, 0.0f, omega, vt, 0.0f, q, 0.0f);
+  float drag1 = CalcDrag(lift1, alpha1, vt, 0.0f, q, 0.0f);
+  float M_LD1 = dx_cg_x_ax_ * chord_ * (lift1*cos(alpha1) + drag1*sin(alpha1));
+  float dCm_LD_dalpha = (M_LD1-M_LD0)/(alpha1-alpha0)/q/wetted_area_/ chord_;
+  float dCm_dalpha = 8.0f * dCm_LD_dalpha; // increasing this causes nose up
+  float Cm0 = -M_LD0 / q / wetted_area_ / chord_ - dCm_dalpha * alpha0;
+  int npts = 180/15;
+  Cm_.resize(2*npts + 1);
+  Cm_[npts] = Cm0;
+  for (int i = 0; i < npts; ++i) {
+    float slope_factor = std::pow(1.0f - 0.9 * i / npts, 3.0);
+    float dCm = slope_factor * dCm_dalpha * (float)M_PI / npts;
+    Cm_[npts-i-1] = Cm_[npts-i] - dCm;
+    Cm_[npts+i+1] = Cm_[npts+i] + dCm;
+  }
+}
+
+//****************************************************************************80
+RigidBodyDerivative AircraftDynamics::GetStateDerivative(
+    const RigidBodyState& state, float /* t */, 
+    const glm::vec3& acceleration) {
+  // Unpack the state
+  glm::vec3 position(state.position);
+  glm::quat orientation((float)state.orientation.w, 
+      (float)state.orientation.x, (float)state.orientation.y, 
+      (float)state.orientation.z);
+  glm::vec3 lin_momentum(state.lin_momentum);
+  glm::vec3 ang_momentum(state.ang_momentum);
+  glm::vec3 omega = GetAngularVelocity(orientation, ang_momentum); 
+
+  // Update the forces and torques in the aircraft frame
+  CalcAeroForcesAndTorques(position, orientation, lin_momentum, 
+      WorldToAircraft(omega, orientation), acceleration, forces_, torques_);
+  forces_ += CalcEngineForce();
+
+  // Rotate forces and torques to world frame and add gravity
+  forces_ = AircraftToWorld(forces_, orientation);
+  torques_ = AircraftToWorld(torques_, orientation);
+  forces_ += CalcGravityForce();
+
+  // Update acceleration (for computing angle rates)
+  acceleration_ = WorldToAircraft(forces_ * inv_mass_, orientation);
+
+  // Compute the derivative of the state
+  RigidBodyDerivative deriv;
+  deriv.velocity = glm::dvec3(lin_momentum * inv_mass_);
+  glm::quat omega_quat(0.0f, omega);
+  glm::quat spin = 0.5f * omega_quat * orientation;
+  deriv.spin = glm::dquat(spin.w, spin.x, spin.y, spin.z);
+  deriv.force = glm::dvec3(forces_);
+  deriv.torque = glm::dvec3(torques_);
+  return deriv;
+}
+  
+//****************************************************************************80
+void AircraftDynamics::SetAeroCoefficient(const std::string& name, 
+    float value) {
+  FindAeroCoefficient(name) = value;
+}
+
+//****************************************************************************80
+float AircraftDynamics::GetAeroCoefficient(const std::string& name) const {
+  return const_cast<AircraftDynamics*>(this)->FindAeroCoefficient(name);
+}
+
+//****************************************************************************80
+void AircraftDynamics::DoPhysicsStep(float t, float dt) {
+  // Compute the state derivative, averaged over the step for RK4
+  const RigidBodyState state = GetState();
+  RigidBodyDerivative deriv;
+  if (integrator_ == PhysicsIntegrator::rk4)
+    deriv = GetRK4Derivative(state, t, dt);
+  else
+    deriv = GetStateDerivative(state, t, acceleration_);
+  
+  // Update momentum due to forces/torques
+  lin_momentum_ += forces_ * dt;
+  ang_momentum_ += torques_ * dt;
+  const glm::vec3 lin_momentum_free = lin_momentum_;
+  const glm::vec3 ang_momentum_free = ang_momentum_;
+
+  // Get the current set of contacts
+  std::vector<Contact>& contacts = contacts_;
+  GetContacts(state, dt, contacts);
+
+  // Iterate to solve for the new velocities
+  const int max_iter = 20;
+  for (int i = 0; i < max_iter; ++i) {
+    for (std::size_t c = 0; c < contacts.size(); ++c) {
+      // Apply normal impulse
+      auto v = GetVelocity() + glm::cross(GetAngularVelocity(orientation_,
+            ang_momentum_), contacts[c].r);
+      auto vn = glm::dot(v, contacts[c].n);
+      float dj_n = contacts[c].mass_n * (-vn + contacts[c].bias);
+      float j_n0 = contacts[c].j_n;
+      contacts[c].j_n = std::max(j_n0 + dj_n, 0.0f);
+      dj_n = contacts[c].j_n - j_n0;
+      lin_momentum_ += dj_n * contacts[c].n;
+      ang_momentum_ += dj_n * glm::cross(contacts[c].r, contacts[c].n);
+
+      // Apply tangent impulse
+      v = GetVelocity() + glm::cross(GetAngularVelocity(orientation_,
+            ang_momentum_), contacts[c].r);
+      auto vt = glm::dot(v, contacts[c].t);
+      float dj_t = contacts[c].mass_t * -vt;
+      float j_t_max = mu_dynamic_ * contacts[c].j_n;
+      float j_t0 = contacts[c].j_t;
+      contacts[c].j_t = std::min(std::max(j_t0 + dj_t, -j_t_max), j_t_max);
+      dj_t = contacts[c].j_t - j_t0;
+      lin_momentum_ += dj_t * contacts[c].t;
+      ang_momentum_ += dj_t * glm::cross(contacts[c].r, contacts[c].t);
+    }
+  }
+
+  // std::cout << j_n/dt << " " << mass_ * 9.81 << std::endl;
+  
+  // Update positions
+  if (integrator_ == PhysicsIntegrator::rk4) {
+    // Advance with the RK4 rates, plus the velocity change of the contacts
+    glm::vec3 dv = (lin_momentum_ - lin_momentum_free) * inv_mass_;
+    glm::vec3 domega = GetAngularVelocity(orientation_, 
+        ang_momentum_ - ang_momentum_free);
+    glm::quat dspin = 0.5f * glm::quat(0.0f, domega) * orientation_;
+    position_ += (deriv.velocity + glm::dvec3(dv)) * (double)dt;
+    glm::dquat spin = deriv.spin + glm::dquat(dspin.w, dspin.x, dspin.y, 
+        dspin.z);
+    orientation_ = glm::normalize(orientation_ + glm::quat((float)spin.w, 
+          (float)spin.x, (float)spin.y, (float)spin.z) * dt);
+    return;
+  }
+  position_ += lin_momentum_ * inv_mass_ * dt;
+  glm::vec3 omega = GetAngularVelocity(orientation_, ang_momentum_);
+  if (integrator_ == PhysicsIntegrator::lie_group) {
+    // Rotate by the exponential of the angular velocity, which is exact for
+    // a constant angular velocity and keeps the quaternion unit length
+    float angle = glm::length(omega) * dt;
+    if (angle > std::numeric_limits<float>::epsilon()) {
+      orientation_ = glm::normalize(glm::angleAxis(angle, 
+            glm::normalize(omega)) * orientation_);
+    }
+    return;
+  }
+  glm::quat omega_quat(0.0f, omega);
+  glm::quat spin = 0.5f * omega_quat * orientation_;
+  orientation_ += spin * dt;
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+float& AircraftDynamics::FindAeroCoefficient(const std::string& name) {
+  if (name == "CL_Q") return CL_Q_;
+  if (name == "Cm_Q") return Cm_Q_;
+  if (name == "CL_alpha_dot") return CL_alpha_dot_;
+  if (name == "Cm_alpha_dot") return Cm_alpha_dot_;
+  if (name == "CDi_CL2") return CDi_CL2_;
+  if (name == "CY_beta") return CY_beta_;
+  if (name == "Cl_beta") return Cl_beta_;
+  if (name == "Cl_P") return Cl_P_;
+  if (name == "Cl_R") return Cl_R_;
+  if (name == "Cn_beta") return Cn_beta_;
+  if (name == "Cn_P") return Cn_P_;
+  if (name == "Cn_R") return Cn_R_;
+  if (name == "CL_de") return CL_de_;
+  if (name == "CD_de") return CD_de_;
+  if (name == "CY_dr") return CY_dr_;
+  if (name == "Cm_de") return Cm_de_;
+  if (name == "Cl_da") return Cl_da_;
+  if (name == "Cn_da") return Cn_da_;
+  if (name == "Cl_dr") return Cl_dr_;
+  if (name == "Cn_dr") return Cn_dr_;
+  throw std::invalid_argument("Unknown aerodynamic coefficient " + name + 
+      "\n");
+}
+
+//****************************************************************************80
+RigidBodyDerivative AircraftDynamics::GetRK4Derivative(
+    const RigidBodyState& state, float t, float dt) {
+  // Intermediate states, with the orientation kept unit length
+  auto stage = [&state](const RigidBodyDerivative& k, double h) {
+    RigidBodyState s = state + k * h;
+    s.orientation = glm::normalize(s.orientation);
+    return s;
+  };
+  // Every stage takes the angle rates from the acceleration of the last 
+  // step, not from whichever stage ran before it
+  const glm::vec3 acceleration = acceleration_;
+  RigidBodyDerivative k1 = GetStateDerivative(state, t, acceleration);
+  RigidBodyDerivative k2 = GetStateDerivative(stage(k1, 0.5 * dt), 
+      t + 0.5f * dt, acceleration);
+  RigidBodyDerivative k3 = GetStateDerivative(stage(k2, 0.5 * dt), 
+      t + 0.5f * dt, acceleration);
+  RigidBodyDerivative k4 = GetStateDerivative(stage(k3, dt), t + dt, 
+      acceleration);
+  RigidBodyDerivative deriv = (k1 + 2.0 * (k2 + k3) + k4) * (1.0 / 6.0);
+  forces_ = glm::vec3(deriv.force);
+  torques_ = glm::vec3(deriv.torque);
+  // Keep the acceleration averaged over the step for the next one
+  acceleration_ = WorldToAircraft(forces_ * inv_mass_, orientation_);
+  return deriv;
+}
+
+//****************************************************************************80
+void AircraftDynamics::CalcAeroForcesAndTorques(const glm::vec3& position,
+    const glm::quat& orientation, const glm::vec3& lin_momentum, 
+    const glm::vec3& omega, const glm::vec3& acceleration, 
+    glm::vec3& forces, glm::vec3& torques) const {
+  glm::vec3 va = WorldToAircraft(lin_momentum * inv_mass_, orientation);
+  float vt = glm::l2Norm(va);
+  if (vt > std::numeric_limits<float>::epsilon()) {
+    glm::vec3 aa = WorldToAircraft(acceleration, orientation);
+    float alpha = CalcAlpha(va);
+    float beta = CalcBeta(va);
+    float alpha_dot = CalcAlphaDot(va, aa); 
+    float dve = CalcTailVelocity(omega); 
+    float rho = 1.225f * exp(-position.y / 7300.0f);
+    float q = 0.5f * rho * vt * vt;
+
+    float lift = CalcLift(alpha, alpha_dot, omega, vt, dve, q, 
+        elevator_position_);
+    float drag = CalcDrag(lift, alpha, vt, dve, q, elevator_position_);
+    float side = CalcSideForce(beta, q, elevator_position_);
+    forces.x = lift * sin(alpha) - drag * cos(alpha) - side * sin(beta);
+    forces.y = side * cos(beta);
+    forces.z = -lift * cos(alpha) - drag * sin(alpha);
+
+    torques.x = CalcRollMoment(beta, omega, vt, q, aileron_position_, 
+        rudder_position_);
+    torques.y = CalcPitchMoment(alpha, alpha_dot, omega, vt, dve, q, 
+        elevator_position_, lift, drag);
+    torques.z = CalcYawMoment(beta, omega, vt, q, aileron_position_, 
+        rudder_position_);
+  }
+  else {
+    forces = glm::vec3(0.0f, 0.0f, 0.0f);
+    torques = glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+}
+
+//****************************************************************************80
+void AircraftDynamics::GetContacts(const RigidBodyState& state, float dt, 
+    std::vector<Contact>& contacts) const {
+  glm::dvec3 position = state.position;
+  glm::quat orientation((float)state.orientation.w, 
+      (float)state.orientation.x, (float)state.orientation.y, 
+      (float)state.orientation.z);
+  glm::vec3 velocity = glm::vec3(state.lin_momentum) * inv_mass_;
+  glm::vec3 ang_momentum(state.ang_momentum);
+  
+  // Collision model relative to the aircraft position, world locations are
+  // only formed in double precision
+  glm::mat4 cm_model = glm::translate(glm::mat4(), delta_center_of_mass_);
+  cm_model *= glm::toMat4(orientation);
+  cm_model *= glm::toMat4(glm::angleAxis(glm::radians(90.0f), 
+        glm::vec3(0.0f, 0.0f, 1.0f)));
+  cm_model *= glm::toMat4(glm::angleAxis(glm::radians(180.0f), 
+        glm::vec3(1.0f, 0.0f, 0.0f)));
+  cm_model = glm::translate(cm_model, -delta_center_of_mass_);
+  glm::mat3 inv_inertia_w = glm::inverse(AircraftToWorld(inertia_, 
+        orientation));
+  
+  contacts.clear();
+  // Broad phase: the collision mesh lies in a sphere about the center of 
+  // mass, compare its bottom with the highest terrain under it. There is no
+  // bound (the largest float) in procedural query mode, so nothing is culled
+  glm::dvec3 center = position + glm::dvec3(delta_center_of_mass_);
+  double radius = collision_radius_;
+  float y_max_terrain = terrain_.GetBoundingHeight(center[0] - radius, 
+      center[2] - radius, center[0] + radius, center[2] + radius);
+  if (center[1] - radius >= y_max_terrain)
+    return;
+
+  // Narrow phase: check if any vertices of collision model are below 
+  // terrain, only those below the highest terrain under the aircraft can be
+  const float d_slop = 0.01; // penetration slop
+  const float beta = 0.2; // error reduction parameter
+  auto const& cm_verts = collision_mesh_.GetVertices();
+  // Collision mesh vertices relative to the aircraft, and their world x/z
+  std::vector<glm::vec3>& cm_verts_r = contact_verts_r_;
+  std::vector<double>& x_w = contact_x_w_;
+  std::vector<double>& z_w = contact_z_w_;
+  cm_verts_r.clear();
+  x_w.clear();
+  z_w.clear();
+  for (std::size_t i = 0; i < cm_verts.size(); ++i) {
+    glm::vec3 vert_r = glm::vec3(cm_model*glm::vec4(cm_verts[i], 1.0));
+    if (position[1] + vert_r[1] >= y_max_terrain) continue;
+    cm_verts_r.push_back(vert_r);
+    x_w.push_back(position[0] + vert_r[0]);
+    z_w.push_back(position[2] + vert_r[2]);
+  }
+  // Get the terrain height under all vertices at once
+  std::vector<float>& y_terrain = contact_y_terrain_;
+  y_terrain.resize(cm_verts_r.size());
+  terrain_.GetHeights(x_w.data(), z_w.data(), y_terrain.data(), 
+      cm_verts_r.size());
+  for (std::size_t i = 0; i < cm_verts_r.size(); ++i) {
+    double y_w = position[1] + cm_verts_r[i][1];
+    if (y_terrain[i] <= y_w) continue;
+    auto n = terrain_.GetNormal(x_w[i], z_w[i]);
+    float d = (y_terrain[i] - y_w) * n[1];
+    if (d > 0.0f) {
+      auto r = cm_verts_r[i];
+      auto v = velocity + glm::cross(inv_inertia_w * ang_momentum, r);
+      auto v_dot_n = glm::dot(v,n); 
+      auto t = glm::normalize(v - v_dot_n * n);
+      auto mass_n = 1.0f / (inv_mass_ + 
+          glm::dot(n, glm::cross(inv_inertia_w * glm::cross(r,n), r)));
+      auto mass_t = 1.0f / (inv_mass_ + 
+          glm::dot(t, glm::cross(inv_inertia_w * glm::cross(r,t), r)));
+      // Add bias for position correction
+      float bias = -beta / dt * std::min(0.0f, d_slop - d);
+      // Add bias for bounce
+      auto e = e_collision_;
+      if (v_dot_n < 0.0f) {
+        // Damp bounciness when object is "resting"
+        if (-v_dot_n < 2.0 * 9.81 * dt * (1.0 + e * e))
+          e = 0.0f;
+        bias -= e * v_dot_n;
+      }
+      contacts.push_back({d, n, t, v, r, mass_n, mass_t, bias, 0.0, 0.0});
+    }
+  }
+}
+
+} // End namespace TopFun
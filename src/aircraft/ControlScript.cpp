@@ -0,0 +1,53 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "aircraft/ControlScript.h"
+
+namespace TopFun {
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+ControlScript::ControlScript(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::invalid_argument("Failed to open control script " + path +
+        "\n");
+  }
+  std::string line;
+  for (int n = 1; std::getline(file, line); ++n) {
+    std::string text = line.substr(0, line.find('#'));
+    if (text.find_first_not_of(" \t\r") == std::string::npos) continue;
+    std::istringstream fields(text);
+    std::string control, rest;
+    Event event;
+    if (!(fields >> event.t >> control >> event.value) || (fields >> rest) ||
+        (event.control = GetControlIndex(control)) < 0 ||
+        (!events_.empty() && event.t < events_.back().t)) {
+      throw std::invalid_argument("Bad line " + std::to_string(n) +
+          " in control script " + path + ": " + line + "\n");
+    }
+    events_.push_back(event);
+  }
+}
+
+//****************************************************************************80
+std::size_t ControlScript::Apply(double t, std::size_t next_event,
+    Controls& controls) const {
+  for (; next_event < events_.size() && events_[next_event].t <= t;
+      ++next_event) {
+    controls[events_[next_event].control] = events_[next_event].value;
+  }
+  return next_event;
+}
+
+//****************************************************************************80
+int ControlScript::GetControlIndex(const std::string& name) {
+  if (name == "elevator") return 0;
+  if (name == "aileron") return 1;
+  if (name == "rudder") return 2;
+  if (name == "throttle") return 3;
+  return -1;
+}
+
+} // End namespace TopFun
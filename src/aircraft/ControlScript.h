@@ -0,0 +1,62 @@
+#ifndef CONTROLSCRIPT_H
+#define CONTROLSCRIPT_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cstddef>
+
+// Timed control inputs of a flight test. A script file holds one change per
+// line: a time (s), a control name (elevator, aileron, rudder or throttle)
+// and its new position, held until the next change of that control. Blank
+// lines and text after # are ignored, and times must not decrease
+
+namespace TopFun {
+
+class ControlScript {
+
+ public:
+  // Control positions in the order elevator, aileron, rudder, throttle
+  typedef std::array<float,4> Controls;
+
+  //**************************************************************************80
+  //! \brief ControlScript - Constructor for a script with no changes
+  //**************************************************************************80
+  ControlScript() = default;
+
+  //**************************************************************************80
+  //! \brief ControlScript - Constructor, throws std::invalid_argument if the
+  //! file cannot be read or a line is malformed
+  //! \param[in] path - path to the script file
+  //**************************************************************************80
+  explicit ControlScript(const std::string& path);
+
+  //**************************************************************************80
+  //! \brief Apply - apply the changes up to a time
+  //! \param[in] t - current time
+  //! \param[in] next_event - first change not yet applied
+  //! \param[in,out] controls - control positions
+  //! \returns first change still to be applied after t
+  //**************************************************************************80
+  std::size_t Apply(double t, std::size_t next_event,
+      Controls& controls) const;
+
+  //**************************************************************************80
+  //! \brief GetControlIndex - index of a control in Controls, -1 if the name
+  //! is not a control
+  //**************************************************************************80
+  static int GetControlIndex(const std::string& name);
+
+ private:
+  // Change of one control input at a given time
+  struct Event {
+    double t;
+    int control; // index in Controls
+    float value;
+  };
+  std::vector<Event> events_;
+
+};
+} // End namespace TopFun
+
+#endif
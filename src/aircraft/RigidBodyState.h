@@ -0,0 +1,63 @@
+#ifndef RIGIDBODYSTATE_H
+#define RIGIDBODYSTATE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Fixed-size state of a rigid body and its time derivative. Both are plain
+// aggregates of doubles, so the physics loop copies them on the stack and
+// never allocates. The arithmetic operators are the ones an integrator
+// needs: scaling and summing derivatives and stepping a state by one
+
+namespace TopFun {
+
+// Position/orientation/momentum state (all in world frame)
+struct RigidBodyState {
+  glm::dvec3 position; // world location of the model origin
+  glm::dquat orientation;
+  glm::dvec3 lin_momentum;
+  glm::dvec3 ang_momentum;
+};
+
+// Time derivative of a RigidBodyState
+struct RigidBodyDerivative {
+  glm::dvec3 velocity; // derivative of position
+  glm::dquat spin; // derivative of orientation
+  glm::dvec3 force; // derivative of linear momentum
+  glm::dvec3 torque; // derivative of angular momentum
+};
+
+//****************************************************************************80
+//! \brief operator+ - sum of two derivatives
+//****************************************************************************80
+inline RigidBodyDerivative operator+(const RigidBodyDerivative& a,
+    const RigidBodyDerivative& b) {
+  return {a.velocity + b.velocity, a.spin + b.spin, a.force + b.force,
+    a.torque + b.torque};
+}
+
+//****************************************************************************80
+//! \brief operator* - derivative scaled by a time interval (or weight)
+//****************************************************************************80
+inline RigidBodyDerivative operator*(const RigidBodyDerivative& d,
+    double s) {
+  return {d.velocity * s, d.spin * s, d.force * s, d.torque * s};
+}
+
+inline RigidBodyDerivative operator*(double s, const RigidBodyDerivative& d) {
+  return d * s;
+}
+
+//****************************************************************************80
+//! \brief operator+ - state advanced by a derivative already scaled by the
+//! time interval, the orientation is left unnormalized
+//****************************************************************************80
+inline RigidBodyState operator+(const RigidBodyState& s,
+    const RigidBodyDerivative& d) {
+  return {s.position + d.velocity, s.orientation + d.spin,
+    s.lin_momentum + d.force, s.ang_momentum + d.torque};
+}
+
+} // End namespace TopFun
+
+#endif
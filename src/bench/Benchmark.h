@@ -0,0 +1,92 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstddef>
+
+namespace TopFun {
+
+// Minimal timing harness for the CPU micro-benchmarks. Each benchmark is
+// timed in batches sized to last a fraction of the minimum time, and the
+// median and fastest batch are reported per call
+
+class Benchmark {
+ public:
+  //**************************************************************************80
+  //! \brief Benchmark - Constructor
+  //! \param[in] min_seconds - minimum time spent timing each benchmark
+  //! \param[in] filter - only run benchmarks whose name contains this, all if
+  //! empty
+  //**************************************************************************80
+  Benchmark(double min_seconds, const std::string& filter) :
+    min_seconds_(min_seconds), filter_(filter) {
+    std::cout << std::left << std::setw(name_width_) << "benchmark"
+      << std::right << std::setw(12) << "calls" << std::setw(14)
+      << "median us" << std::setw(14) << "min us" << std::endl;
+  }
+
+  //**************************************************************************80
+  //! \brief Run - time a benchmark and print its results
+  //! \param[in] name - name of the benchmark
+  //! \param[in] body - callable running one call of the benchmarked code
+  //**************************************************************************80
+  template <typename F>
+  void Run(const std::string& name, F body) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) return;
+    // Size the batches from a single warm up call
+    body();
+    double t_call = std::max(TimeBatch(body, 1), 1.0e-9);
+    std::size_t batch_size = std::max<std::size_t>(1,
+        (std::size_t)(min_seconds_ / num_batches_ / t_call));
+    std::vector<double> t_batches;
+    double t_total = 0.0;
+    while (t_batches.size() < num_batches_ || t_total < min_seconds_) {
+      double t = TimeBatch(body, batch_size);
+      t_batches.push_back(t / batch_size);
+      t_total += t;
+    }
+    std::sort(t_batches.begin(), t_batches.end());
+    std::cout << std::left << std::setw(name_width_) << name << std::right
+      << std::setw(12) << batch_size * t_batches.size() << std::fixed
+      << std::setprecision(3) << std::setw(14)
+      << 1.0e6 * t_batches[t_batches.size() / 2] << std::setw(14)
+      << 1.0e6 * t_batches.front() << std::endl;
+  }
+
+  //**************************************************************************80
+  //! \brief KeepResult - keep the compiler from optimizing away a result
+  //**************************************************************************80
+  template <typename T>
+  static inline void KeepResult(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+  }
+
+ private:
+  double min_seconds_;
+  std::string filter_;
+  static const std::size_t num_batches_ = 10;
+  static const int name_width_ = 40;
+
+  //**************************************************************************80
+  //! \brief TimeBatch - time n calls of a benchmark
+  //! \returns elapsed seconds
+  //**************************************************************************80
+  template <typename F>
+  static double TimeBatch(F& body, std::size_t n) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < n; ++i) {
+      body();
+    }
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+
+};
+} // End namespace TopFun
+
+#endif
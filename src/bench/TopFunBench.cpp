@@ -0,0 +1,156 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+
+#include "bench/Benchmark.h"
+#include "terrain/TerrainCore.h"
+#include "terrain/TerrainTile.h"
+#include "terrain/TerrainElem2Node.h"
+#include "sky/NoiseCube.h"
+#include "sky/CloudRenderer.h"
+#include "aircraft/AircraftDynamics.h"
+#include "aircraft/AircraftBatchDynamics.h"
+#include "utils/ThreadPool.h"
+
+using namespace TopFun;
+
+// Micro-benchmarks of the CPU hot paths. Everything is built on the GL-free
+// terrain and aircraft cores, so no window or GL context is created. Run
+// from the same directory as TopFun, the aircraft collision mesh is loaded
+// relative to it
+int main(int argc, char** argv) {
+  // --filter <text> runs only the benchmarks whose name contains text,
+  // --min-time <seconds> sets the time spent timing each benchmark
+  std::string filter;
+  double min_seconds = 0.5;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "--filter" && i + 1 < argc) {
+      filter = argv[++i];
+    }
+    else if (arg == "--min-time" && i + 1 < argc) {
+      min_seconds = std::stod(argv[++i]);
+    }
+  }
+
+  // Same terrain as the game, the tiles within startup radius of the start
+  // are loaded once construction returns
+  float terrain_size = 150000.0f;
+  TerrainCore terrain(terrain_size, 19, {{0.0, 0.0}});
+
+  // Query locations within the center tile
+  const std::size_t num_points = 1024;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-3000.0, 3000.0);
+  std::vector<double> xs(num_points), zs(num_points);
+  for (std::size_t i = 0; i < num_points; ++i) {
+    xs[i] = uniform(rng);
+    zs[i] = uniform(rng);
+  }
+
+  Benchmark bench(min_seconds, filter);
+
+  // Relocate one tile and wait for it, as the ring does (no tile cache).
+  // Includes queueing the job, the handoff to the worker and back, and the
+  // copy to the CPU-side grids, as well as generating the vertex data
+  {
+    ThreadPool thread_pool(1);
+    double l_tile = terrain_size / 19;
+    TerrainTile tile(false, 0, {{0, 0}}, 2.0 * l_tile, 2.0 * l_tile,
+        thread_pool);
+    tile.FinishLoading(true);
+    bench.Run("TerrainTile::Relocate+FinishLoading", [&]() {
+        tile.Relocate(2.0 * l_tile, 2.0 * l_tile, thread_pool);
+        tile.FinishLoading(true); });
+  }
+
+  // Element-to-node connectivities, built at compile time by the game
+  bench.Run("BuildAllElem2Node", []() {
+      std::vector<std::uint32_t> indices;
+      std::vector<Elem2NodeRange> ranges;
+      BuildAllElem2Node(indices, ranges);
+      Benchmark::KeepResult(indices.data()); });
+
+  // Terrain queries, in both query modes
+  std::size_t k = 0;
+  const std::array<TerrainQueryMode,2> modes = {{
+    TerrainQueryMode::interpolated, TerrainQueryMode::procedural}};
+  const std::array<std::string,2> mode_names = {{"interpolated",
+    "procedural"}};
+  for (int m = 0; m < 2; ++m) {
+    terrain.SetQueryMode(modes[m]);
+    bench.Run("Terrain::GetHeight (" + mode_names[m] + ")", [&]() {
+        Benchmark::KeepResult(terrain.GetHeight(xs[k], zs[k]));
+        k = (k + 1) % num_points; });
+    bench.Run("Terrain::GetNormal (" + mode_names[m] + ")", [&]() {
+        Benchmark::KeepResult(terrain.GetNormal(xs[k], zs[k]));
+        k = (k + 1) % num_points; });
+  }
+  terrain.SetQueryMode(TerrainQueryMode::interpolated);
+
+  // Aircraft physics, starting each step from the same state. In the air
+  // the broad phase rejects all contacts, on the ground at rest the
+  // collision mesh is pushed out of the terrain
+  const float dt = 0.005f;
+  glm::quat orientation = glm::angleAxis(glm::radians(90.0f),
+      glm::vec3(1.0f, 0.0f, 0.0f));
+  AircraftDynamics aircraft(glm::dvec3(0.0, 3000.0, 0.0), orientation,
+      terrain);
+  RigidBodyState air_state = aircraft.GetState();
+  RigidBodyState ground_state = air_state;
+  ground_state.position[1] = terrain.GetHeight(0.0, 0.0);
+  ground_state.lin_momentum = glm::dvec3(0.0);
+  ground_state.ang_momentum = glm::dvec3(0.0);
+  std::vector<AircraftDynamics::Contact> contacts;
+  aircraft.GetContacts(ground_state, dt, contacts);
+  if (contacts.empty()) {
+    std::cout << "Warning: no ground contacts at the start" << std::endl;
+  }
+  bench.Run("Aircraft::DoPhysicsStep (air)", [&]() {
+      aircraft.SetState(air_state);
+      aircraft.DoPhysicsStep(0.0f, dt); });
+  bench.Run("Aircraft::DoPhysicsStep (ground)", [&]() {
+      aircraft.SetState(ground_state);
+      aircraft.DoPhysicsStep(0.0f, dt); });
+  const std::array<PhysicsIntegrator,2> integrators = {{
+    PhysicsIntegrator::rk4, PhysicsIntegrator::lie_group}};
+  const std::array<std::string,2> integrator_names = {{"rk4", "lie"}};
+  for (int m = 0; m < 2; ++m) {
+    aircraft.SetIntegrator(integrators[m]);
+    bench.Run("Aircraft::DoPhysicsStep (air, " + integrator_names[m] + ")", 
+        [&]() {
+        aircraft.SetState(air_state);
+        aircraft.DoPhysicsStep(0.0f, dt); });
+  }
+  aircraft.SetIntegrator(PhysicsIntegrator::semi_implicit_euler);
+  bench.Run("Aircraft::GetContacts (ground)", [&]() {
+      aircraft.GetContacts(ground_state, dt, contacts);
+      Benchmark::KeepResult(contacts.size()); });
+
+  // Many aircraft stepped together, spread out in the air
+  const std::size_t num_aircraft = 256;
+  AircraftBatchDynamics batch(aircraft);
+  for (std::size_t i = 0; i < num_aircraft; ++i) {
+    RigidBodyState state = air_state;
+    state.position[0] += 100.0 * i;
+    batch.Add(state);
+    batch.SetControls(i, 0.1f, 0.0f, 0.0f, 0.5f);
+  }
+  bench.Run("AircraftBatchDynamics::DoPhysicsStep 256", [&]() {
+      batch.DoPhysicsStep(dt); });
+
+  // Cloud noise, with the parameters of the cloud textures
+  bench.Run("NoiseCube::GenerateWorleyNoise 32^3", []() {
+      Benchmark::KeepResult(NoiseCube::GenerateWorleyNoise({{32, 32, 32}},
+            {2, 2, 2}).data()); });
+  bench.Run("NoiseCube::GeneratePerlinNoise 32^3", []() {
+      Benchmark::KeepResult(NoiseCube::GeneratePerlinNoise({{32, 32, 32}},
+            {{20, 6.0, 0.3}}).data()); });
+  bench.Run("CloudRenderer::GenerateWeatherData 256^2", []() {
+      Benchmark::KeepResult(CloudRenderer::GenerateWeatherData(256).data());
+      });
+
+  return 0;
+}
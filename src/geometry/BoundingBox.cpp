@@ -1,11 +1,14 @@
+#include <algorithm>
+
 #include "geometry/BoundingBox.h"
+#include "geometry/BoundingSphere.h"
 
 namespace TopFun {
 //****************************************************************************80
 // PUBLIC FUNCTIONS
 //****************************************************************************80
 BoundingBox::BoundingBox(glm::vec3 minimum, glm::vec3 maximum,
-    glm::vec3 position = glm::vec3(0.0f)) : 
+    glm::vec3 position) : 
   BoundingVolume(), minimum_(minimum), maximum_(maximum), 
   position_(position) {}
 
@@ -31,4 +34,59 @@ glm::vec3 BoundingBox::GetNegativeVertex(const glm::vec3& normal) const {
   return position_ + negativeVertex;
 }
 
+//****************************************************************************80
+BoundingVolume::TestResult BoundingBox::TestIntersection(
+    const glm::vec3& point) const {
+  glm::vec3 bmin = GetMinimum();
+  glm::vec3 bmax = GetMaximum();
+  for (int d = 0; d < 3; ++d) {
+    if (point[d] < bmin[d] || point[d] > bmax[d]) {
+      return OUTSIDE;
+    }
+  }
+  return INSIDE;
+}
+
+//****************************************************************************80
+BoundingVolume::TestResult BoundingBox::TestIntersection(
+    const BoundingBox& box) const {
+  glm::vec3 amin = GetMinimum();
+  glm::vec3 amax = GetMaximum();
+  glm::vec3 bmin = box.GetMinimum();
+  glm::vec3 bmax = box.GetMaximum();
+  TestResult result = INSIDE;
+  for (int d = 0; d < 3; ++d) {
+    if (bmax[d] < amin[d] || bmin[d] > amax[d]) {
+      return OUTSIDE;
+    }
+    if (bmin[d] < amin[d] || bmax[d] > amax[d]) {
+      result = INTERSECT;
+    }
+  }
+  return result;
+}
+
+//****************************************************************************80
+BoundingVolume::TestResult BoundingBox::TestIntersection(
+    const BoundingSphere& sphere) const {
+  glm::vec3 bmin = GetMinimum();
+  glm::vec3 bmax = GetMaximum();
+  const glm::vec3& c = sphere.GetCenter();
+  float r = sphere.GetRadius();
+  // Squared distance from the center to the closest point in the box
+  float d2 = 0.0f;
+  bool inside = true;
+  for (int d = 0; d < 3; ++d) {
+    float p = std::min(std::max(c[d], bmin[d]), bmax[d]);
+    d2 += (c[d] - p) * (c[d] - p);
+    if (c[d] - r < bmin[d] || c[d] + r > bmax[d]) {
+      inside = false;
+    }
+  }
+  if (d2 > r * r) {
+    return OUTSIDE;
+  }
+  return inside ? INSIDE : INTERSECT;
+}
+
 } // End namespace TopFun
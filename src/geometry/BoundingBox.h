@@ -9,13 +9,17 @@ namespace TopFun {
 class BoundingBox : public BoundingVolume {
  public:
 
-  BoundingBox(glm::vec3 minimum, glm::vec3 maximum, glm::vec3 position); 
+  BoundingBox(glm::vec3 minimum, glm::vec3 maximum, 
+      glm::vec3 position = glm::vec3(0.0f)); 
 
   virtual ~BoundingBox() = default;
 
   virtual glm::vec3 GetPositiveVertex(const glm::vec3& normal) const;
   virtual glm::vec3 GetNegativeVertex(const glm::vec3& normal) const;
 
+  inline glm::vec3 GetMinimum() const { return position_ + minimum_; }
+  inline glm::vec3 GetMaximum() const { return position_ + maximum_; }
+
   TestResult TestIntersection(const glm::vec3& point) const;
   TestResult TestIntersection(const BoundingBox& box) const;
   TestResult TestIntersection(const BoundingSphere& sphere) const;
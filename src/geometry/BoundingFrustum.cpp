@@ -1,5 +1,6 @@
 #include "geometry/BoundingFrustum.h"
 #include "geometry/BoundingBox.h"
+#include "geometry/BoundingSphere.h"
 
 namespace TopFun {
 //****************************************************************************80
@@ -60,10 +61,27 @@ BoundingFrustum::BoundingFrustum(const glm::mat4& viewMat,
   m_planes_[FRONT].z = cm[3][2]+cm[2][2];
   m_planes_[FRONT].w = cm[3][3]+cm[2][3];
 
+  // Normalize so that plane equations give signed distances
   for(int i = 0; i < 6; i++) {
-    m_planes_[i] = glm::normalize(m_planes_[i]);
+    m_planes_[i] /= glm::length(glm::vec3(m_planes_[i]));
   }
 }
+
+//****************************************************************************80
+const glm::vec4& BoundingFrustum::GetPlane(const int plane) const {
+  return m_planes_[plane];
+}
+
+//****************************************************************************80
+BoundingVolume::TestResult BoundingFrustum::TestIntersection(
+    const glm::vec3& point) const {
+  for(int i = 0; i < 6; i++) {
+    if (glm::dot(glm::vec3(m_planes_[i]), point) + m_planes_[i].w < 0.0f) {
+      return OUTSIDE;
+    }
+  }
+  return INSIDE;
+}
  
 //****************************************************************************80
 BoundingVolume::TestResult BoundingFrustum::TestIntersection(
@@ -84,4 +102,22 @@ BoundingVolume::TestResult BoundingFrustum::TestIntersection(
   return result;
 }
 
+//****************************************************************************80
+BoundingVolume::TestResult BoundingFrustum::TestIntersection(
+    const BoundingSphere& sphere) const {
+  TestResult result = INSIDE;
+  float r = sphere.GetRadius();
+  for(int i = 0; i < 6; i++) {
+    float d = glm::dot(glm::vec3(m_planes_[i]), sphere.GetCenter()) + 
+      m_planes_[i].w;
+    if (d < -r) {
+      return OUTSIDE;
+    }
+    if (d < r) {
+      result = INTERSECT;
+    }
+  }
+  return result;
+}
+
 } // End namespace TopFun
@@ -0,0 +1,50 @@
+#include <algorithm>
+
+#include "geometry/BoundingSphere.h"
+#include "geometry/BoundingBox.h"
+
+namespace TopFun {
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+BoundingSphere::BoundingSphere(const glm::vec3& center, float radius) :
+  BoundingVolume(), center_(center), radius_(radius) {}
+
+//****************************************************************************80
+BoundingVolume::TestResult BoundingSphere::TestIntersection(
+    const glm::vec3& point) const {
+  glm::vec3 d = point - center_;
+  return glm::dot(d, d) <= radius_ * radius_ ? INSIDE : OUTSIDE;
+}
+
+//****************************************************************************80
+BoundingVolume::TestResult BoundingSphere::TestIntersection(
+    const BoundingBox& box) const {
+  glm::vec3 bmin = box.GetMinimum();
+  glm::vec3 bmax = box.GetMaximum();
+  // Squared distance to the closest and farthest points of the box
+  float d2_min = 0.0f;
+  float d2_max = 0.0f;
+  for (int d = 0; d < 3; ++d) {
+    float p = std::min(std::max(center_[d], bmin[d]), bmax[d]);
+    d2_min += (center_[d] - p) * (center_[d] - p);
+    float q = std::max(center_[d] - bmin[d], bmax[d] - center_[d]);
+    d2_max += q * q;
+  }
+  if (d2_min > radius_ * radius_) {
+    return OUTSIDE;
+  }
+  return d2_max <= radius_ * radius_ ? INSIDE : INTERSECT;
+}
+
+//****************************************************************************80
+BoundingVolume::TestResult BoundingSphere::TestIntersection(
+    const BoundingSphere& sphere) const {
+  float d = glm::length(sphere.GetCenter() - center_);
+  if (d > radius_ + sphere.GetRadius()) {
+    return OUTSIDE;
+  }
+  return d + sphere.GetRadius() <= radius_ ? INSIDE : INTERSECT;
+}
+
+} // End namespace TopFun
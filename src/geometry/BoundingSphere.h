@@ -0,0 +1,31 @@
+#ifndef BOUNDINGSPHERE_H
+#define BOUNDINGSPHERE_H
+
+#include "geometry/BoundingVolume.h"
+
+namespace TopFun {
+
+class BoundingSphere : public BoundingVolume {
+ public:
+
+  BoundingSphere(const glm::vec3& center, float radius);
+
+  virtual ~BoundingSphere() = default;
+
+  inline const glm::vec3& GetCenter() const { return center_; }
+  inline float GetRadius() const { return radius_; }
+
+  TestResult TestIntersection(const glm::vec3& point) const;
+  TestResult TestIntersection(const BoundingBox& box) const;
+  TestResult TestIntersection(const BoundingSphere& sphere) const;
+
+ private:
+
+  glm::vec3 center_;
+  float radius_;
+
+};
+
+} // End namespace TopFun
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef COLLISIONMESH_H
+#define COLLISIONMESH_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+// assimp includes
+#include "Importer.hpp"
+#include "scene.h"
+#include "postprocess.h"
+
+namespace TopFun {
+
+// Vertex positions of a model, for physics. Loaded like Model with
+// join_verts, so it holds the same vertices, but creates no GL objects and
+// needs no GL context
+
+class CollisionMesh {
+ public:
+  // Constructor, expects a filepath to a 3D model
+  explicit CollisionMesh(const std::string& path) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path,
+        aiProcess_JoinIdenticalVertices);
+    // Check for errors
+    if (!scene ||
+        scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE ||
+        !scene->mRootNode) {
+      std::string message = "Failed to load collision mesh " + path + ": " +
+        importer.GetErrorString() + "\n";
+      throw std::invalid_argument(message);
+    }
+    ProcessNode(scene->mRootNode, scene);
+    if (vertices_.empty()) {
+      std::string message = "Collision mesh " + path + " has no vertices\n";
+      throw std::invalid_argument(message);
+    }
+    FormAABB();
+  }
+
+  // Vertex positions of all meshes, in the order Model would hold them
+  inline const std::vector<glm::vec3>& GetVertices() const {
+    return vertices_;
+  }
+
+  // Min/max extent for x,y,z, using the maximum dimension size for all
+  // dimensions like Mesh::FormAABB
+  inline const std::array<std::array<float,2>,3>& GetAABB() const {
+    return AABB_;
+  }
+
+ private:
+  std::vector<glm::vec3> vertices_;
+  std::array<std::array<float,2>,3> AABB_;
+
+  // Processes a node recursively
+  void ProcessNode(const aiNode* node, const aiScene* scene) {
+    for (unsigned i = 0; i < node->mNumMeshes; ++i) {
+      const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+      for (unsigned v = 0; v < mesh->mNumVertices; ++v) {
+        const aiVector3D& p = mesh->mVertices[v];
+        vertices_.push_back(glm::vec3(p.x, p.y, p.z));
+      }
+    }
+    for (unsigned i = 0; i < node->mNumChildren; ++i) {
+      ProcessNode(node->mChildren[i], scene);
+    }
+  }
+
+  // Forms the AABB, a cube spanning the extent of all dimensions
+  void FormAABB() {
+    float bmin = vertices_[0].x;
+    float bmax = vertices_[0].x;
+    for (const glm::vec3& v : vertices_) {
+      for (int d = 0; d < 3; ++d) {
+        bmin = std::min(v[d], bmin);
+        bmax = std::max(v[d], bmax);
+      }
+    }
+    for (int d = 0; d < 3; ++d) {
+      AABB_[d] = {{bmin, bmax}};
+    }
+  }
+};
+} // End namespace TopFun
+
+#endif
@@ -127,6 +127,10 @@ class Camera {
 
   inline GLfloat GetZoom() const { return zoom_; }
 
+  inline const std::array<GLuint,2>& GetScreenSize() const { 
+    return screen_size_; 
+  }
+
   inline const glm::vec3& GetFront() const { return front_; }
 
   inline const std::array<float,2> GetNearFar() const {return {{near_, far_}};}
@@ -46,7 +46,7 @@ void DepthMapRenderer::Render(Terrain& terrain, const Sky& sky,
   glViewport(0, 0, map_width_, map_height_);
   glBindFramebuffer(GL_FRAMEBUFFER, depth_mapFBO_);
   glClear(GL_DEPTH_BUFFER_BIT);
-  DrawScene(terrain, sky, aircraft, camera, nullptr, &shader); 
+  DrawScene(terrain, sky, aircraft, camera, nullptr, &shader, &proj_view); 
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
   // Reset viewport
@@ -13,8 +13,9 @@ class ShadowCascadeRenderer;
 
 inline void DrawScene(Terrain& terrain, const Sky& sky, 
     Aircraft& aircraft, const Camera& camera, 
-    const ShadowCascadeRenderer* pshadow_renderer, const Shader* shader=NULL) {
-  terrain.Draw(camera, sky, pshadow_renderer, shader);
+    const ShadowCascadeRenderer* pshadow_renderer, const Shader* shader=NULL,
+    const glm::mat4* proj_view=NULL) {
+  terrain.Draw(camera, sky, pshadow_renderer, shader, proj_view);
   // Only draw the sky if not rendering shadows
   if (!shader) {
     sky.Draw(camera);
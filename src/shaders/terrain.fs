@@ -4,12 +4,13 @@
 #include "material.glsl"
 #include "fog.glsl"
 #include "shadow.glsl"
-#include "noise.glsl"
 
 in vec3 FragPos;  
 in vec3 Position;  
 in vec3 Normal;  
 in vec2 TexCoord;
+flat in int AlbedoLayer;
+flat in float AlbedoLevel;
 in vec4 FragPosEyeSpace;
 in vec4 FragPosLightSpace[MAX_NUM_CASCADES];
   
@@ -19,6 +20,19 @@ uniform vec3 viewPos;
 uniform Material material;
 uniform Light light;
 uniform Fog fog;
+uniform sampler2DArray albedoMap; // one baked layer per tile slot
+uniform float albedoSize; // texels along a side of level 0
+
+// Albedo baked for this tile. Levels finer than the tile has been baked at
+// are not sampled
+vec4 GetAlbedo() {
+  vec2 st = TexCoord * (albedoSize - 1.0);
+  vec2 dx = dFdx(st);
+  vec2 dy = dFdy(st);
+  float level = max(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), AlbedoLevel);
+  return textureLod(albedoMap, vec3((st + 0.5) / albedoSize, 
+        float(AlbedoLayer)), level);
+}
 
 void main() {
   // Ambient
@@ -39,23 +53,9 @@ void main() {
   // TODO
   vec3 norm_bump = vec3(0.0);
  
-  // Generate grass texture 
-  vec4 grass = vec4(0.2, 0.3, 0.1, 1.0);
-  grass.r -= 0.07 * filtered_octave_snoise2D(Position.xz, 2, 0.5, 0.01, 4, 0.125);
-
-  // Add dirt highlights
-  vec4 dirt = vec4(0.61, 0.46, 0.33, 1.0);
-  dirt -= 0.1 * filtered_octave_snoise2D(Position.xz, 5, 0.5, 0.005, 4, 0.125);
-  
-  vec3 norm;
-  if (dirt.a < 0.95) {
-    color = grass;
-    norm = normalize(normalize(Normal) + 0.1 * norm_bump);
-  }
-  else {
-    color = dirt;
-    norm = normalize(normalize(Normal) + norm_bump);
-  }
+  // Grass and dirt, baked per tile
+  color = GetAlbedo();
+  vec3 norm = normalize(normalize(Normal) + 0.1 * norm_bump);
 	
   // Diffuse 
   vec3 lightDir = normalize(-light.direction);  
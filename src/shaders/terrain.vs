@@ -1,14 +1,13 @@
 #version 330 core
 
 #include "shadow.glsl"
-
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 texCoord;
+#include "terrain_vertex.glsl"
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoord;
+flat out int AlbedoLayer;
+flat out float AlbedoLevel;
 out vec4 FragPosEyeSpace;
 out vec4 FragPosLightSpace[MAX_NUM_CASCADES];
 out vec3 Position;
@@ -18,13 +17,17 @@ uniform mat4 view;
 uniform mat4 projection;
 
 void main() {
+  vec4 texel = GetTerrainTexel();
+  vec3 position = GetTerrainPosition(texel);
   vec4 model_position = model * vec4(position, 1.0f);
   FragPos = model_position.xyz;
   FragPosEyeSpace = view * model_position;
   gl_Position = projection * FragPosEyeSpace;
   Position = position;
-  Normal = normal;  
-	TexCoord = texCoord;
+  Normal = texel.gba;  
+  TexCoord = GetTerrainTexCoord();
+  AlbedoLayer = GetTerrainLayer();
+  AlbedoLevel = GetTerrainAlbedoLevel();
   for (int i = 0; i < num_cascades; ++i) {
     FragPosLightSpace[i] = lightSpaceMatrix[i] * vec4(FragPos, 1.0);
   }
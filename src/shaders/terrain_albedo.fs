@@ -0,0 +1,37 @@
+#version 330 core
+
+#include "noise.glsl"
+
+// Bakes one mip level of a tile's albedo. Level 0 texel centers lie on the
+// tile edges, so neighboring tiles agree along their shared edge, and every
+// level uses the texel to world mapping of level 0 so the levels line up 
+// under trilinear filtering. The noise is filtered to the texel size
+
+out vec4 color;
+
+uniform vec2 tileOrigin; // x/z of the tile corner
+uniform float tileLength;
+uniform float baseSize; // texels along a side of level 0
+uniform float levelSize; // texels along a side of the baked level
+
+void main() {
+  vec2 uv = gl_FragCoord.xy / levelSize;
+  vec2 Position = tileOrigin + tileLength * (uv * baseSize - 0.5) / 
+    (baseSize - 1.0);
+
+  // Generate grass texture 
+  vec4 grass = vec4(0.2, 0.3, 0.1, 1.0);
+  grass.r -= 0.07 * filtered_octave_snoise2D(Position, 2, 0.5, 0.01, 4, 0.125);
+
+  // Add dirt highlights
+  vec4 dirt = vec4(0.61, 0.46, 0.33, 1.0);
+  dirt -= 0.1 * filtered_octave_snoise2D(Position, 5, 0.5, 0.005, 4, 0.125);
+  
+  if (dirt.a < 0.95) {
+    color = grass;
+  }
+  else {
+    color = dirt;
+  }
+  color.a = 1.0;
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+#include "terrain_vertex.glsl"
+
+uniform mat4 projection_view; // product of projection and view matrices
+uniform mat4 model;
+
+void main() {
+  vec3 position = GetTerrainPosition(GetTerrainTexel());
+  gl_Position = projection_view * model * vec4(position, 1.0);
+}
@@ -0,0 +1,128 @@
+// Terrain vertices have no attributes. Vertex index gl_VertexID is 
+// slot*gridSize^2 + gridSize*j + i (the base vertex of each draw selects the
+// ring slot), the height and normal of grid vertex (i,j) of each slot are
+// stored in a block of texels of the height map
+
+// r: height scaled to the tile's height range, gb: octahedral encoded normal
+uniform sampler2D heightMap;
+// Four texels per slot. 0: x/z of the tile corner, LoD, morph factor. 
+// 1: minimum height of the tile, height range, finest baked albedo level.
+// 2: LoD of the N, E, S and W edges. 3: morph factor of those edges
+uniform sampler2D tileData;
+uniform float gridSpacing; // distance between grid vertices
+uniform int gridSize; // number of grid vertices along a tile edge
+uniform int ringSize; // number of tile slots along an edge of the ring
+
+ivec2 GetTerrainSlot() {
+  int slot = gl_VertexID / (gridSize * gridSize);
+  return ivec2(slot % ringSize, slot / ringSize);
+}
+
+ivec2 GetTerrainGrid() {
+  int v = gl_VertexID % (gridSize * gridSize);
+  return ivec2(v % gridSize, v / gridSize);
+}
+
+vec4 FetchTileData(ivec2 slot, int i) {
+  return texelFetch(tileData, ivec2(4 * slot.x + i, slot.y), 0);
+}
+
+vec3 DecodeTerrainNormal(vec2 p) {
+  vec2 v = 2.0 * p - 1.0;
+  vec3 n = vec3(v.x, 1.0 - abs(v.x) - abs(v.y), v.y);
+  if (n.y < 0.0) {
+    n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, 
+                                    n.z >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(n);
+}
+
+// Height and normal of grid vertex (i,j) of a slot
+vec4 FetchTerrainTexel(ivec2 slot, ivec2 grid) {
+  vec4 packed = texelFetch(heightMap, gridSize * slot + grid, 0);
+  vec2 range = FetchTileData(slot, 1).rg;
+  return vec4(range.x + range.y * packed.r, DecodeTerrainNormal(packed.gb));
+}
+
+// Height and normal of this vertex. Vertices of the tile's LoD that are not
+// in the next coarser LoD move toward the coarser surface by the morph 
+// factor, so switching LoD does not pop. Vertices on the tile edges morph 
+// along the edge by the edge's LoD and morph factor, which the neighbor 
+// shares, so stitched edges stay watertight
+vec4 GetTerrainTexel() {
+  ivec2 slot = GetTerrainSlot();
+  ivec2 grid = GetTerrainGrid();
+  vec4 texel = FetchTerrainTexel(slot, grid);
+  int num_elem = gridSize - 1;
+  bvec2 on_edge = bvec2(grid.x == 0 || grid.x == num_elem,
+                        grid.y == 0 || grid.y == num_elem);
+  if (all(on_edge)) {
+    // Corners are in every LoD
+    return texel;
+  }
+  if (any(on_edge)) {
+    // Along the edge, which is drawn at the finer LoD of the two tiles
+    int edge = on_edge.y ? (grid.y == num_elem ? 0 : 2) : 
+                           (grid.x == num_elem ? 1 : 3);
+    float morph = FetchTileData(slot, 3)[edge];
+    int step = 1 << int(FetchTileData(slot, 2)[edge]);
+    ivec2 along = on_edge.y ? ivec2(step, 0) : ivec2(0, step);
+    int p = on_edge.y ? grid.x : grid.y;
+    if (morph > 0.0 && p % (2 * step) == step) {
+      vec4 target = 0.5 * (FetchTerrainTexel(slot, grid - along) +
+                           FetchTerrainTexel(slot, grid + along));
+      texel = mix(texel, target, morph);
+    }
+    return texel;
+  }
+  vec4 data = FetchTileData(slot, 0);
+  int step = 1 << int(data.b);
+  int coarse_step = 2 * step;
+  ivec2 r = grid % coarse_step;
+  if (data.a > 0.0 && r != ivec2(0)) {
+    vec4 target;
+    if (r.y == 0) {
+      // Middle of a coarse x edge
+      target = 0.5 * (FetchTerrainTexel(slot, grid - ivec2(step, 0)) +
+                      FetchTerrainTexel(slot, grid + ivec2(step, 0)));
+    }
+    else if (r.x == 0) {
+      // Middle of a coarse z edge
+      target = 0.5 * (FetchTerrainTexel(slot, grid - ivec2(0, step)) +
+                      FetchTerrainTexel(slot, grid + ivec2(0, step)));
+    }
+    else if ((grid.x < num_elem / 2) == (grid.y < num_elem / 2)) {
+      // Center of a coarse cell split along (0,0)-(1,1)
+      target = 0.5 * (FetchTerrainTexel(slot, grid - ivec2(step)) +
+                      FetchTerrainTexel(slot, grid + ivec2(step)));
+    }
+    else {
+      // Center of a coarse cell split along (1,0)-(0,1)
+      target = 0.5 * (FetchTerrainTexel(slot, grid + ivec2(step, -step)) +
+                      FetchTerrainTexel(slot, grid + ivec2(-step, step)));
+    }
+    texel = mix(texel, target, data.a);
+  }
+  return texel;
+}
+
+// Layer of the albedo map holding this vertex's tile
+int GetTerrainLayer() {
+  ivec2 slot = GetTerrainSlot();
+  return ringSize * slot.y + slot.x;
+}
+
+float GetTerrainAlbedoLevel() {
+  return FetchTileData(GetTerrainSlot(), 1).b;
+}
+
+// Location of this vertex within its tile, in [0,1]
+vec2 GetTerrainTexCoord() {
+  return vec2(GetTerrainGrid()) / float(gridSize - 1);
+}
+
+vec3 GetTerrainPosition(vec4 texel) {
+  vec2 xz = FetchTileData(GetTerrainSlot(), 0).rg + 
+    gridSpacing * vec2(GetTerrainGrid());
+  return vec3(xz.x, texel.r, xz.y);
+}
@@ -155,6 +155,42 @@ void CloudRenderer::BlendWithScene() const {
   glDisable(GL_BLEND);
 }
 
+//****************************************************************************80
+std::vector<unsigned char> CloudRenderer::GenerateWeatherData(unsigned size) {
+  // Generate the coverge and height data
+  noise::module::Perlin perlin_generator;
+  perlin_generator.SetOctaveCount(8);
+  perlin_generator.SetFrequency(6.0);
+  perlin_generator.SetPersistence(0.4);
+  std::vector<unsigned char> pixels(size * size * 3);
+  for (std::size_t i = 0; i < size; ++i) {
+    for (std::size_t j = 0; j < size; ++j) {
+      float x = (float)i / size;
+      float y = (float)j / size;
+      float a = perlin_generator.GetValue(x    ,y ,   0.0);
+      float b = perlin_generator.GetValue(x+1.0,y ,   0.0);
+      float c = perlin_generator.GetValue(x    ,y+1.0,0.0);
+      float d = perlin_generator.GetValue(x+1.0,y+1.0,0.0);
+      float xmix = 1.0 - x;
+      float ymix = 1.0 - y;
+      float x1 = glm::mix(a, b, xmix);
+      float x2 = glm::mix(c, d, xmix);
+      float val = glm::mix(x1, x2, ymix);
+      // Clamp strictly between 0 and 1
+      val = val> 1.0 ? 1.0 :val;
+      val = val< 0.0 ? 0.0 :val;
+      std::size_t n = size * j + i;
+      pixels[3*n    ] = (unsigned char)std::round(val * 255);
+      pixels[3*n + 1] = (unsigned char)std::round(val * 255);
+    }
+  }
+  // Generate the altitude data
+  // TODO
+  for (std::size_t n = 0; n < size * size; ++n)
+    pixels[3*n + 2] = (unsigned char)0;
+  return pixels;
+}
+
 //****************************************************************************80
 // PRIVATE FUNCTIONS
 //****************************************************************************80
@@ -232,38 +268,8 @@ void CloudRenderer::SetShaderData(const Sky& sky, Camera const& camera) {
 
 //****************************************************************************80
 void CloudRenderer::GenerateWeatherTexture(unsigned size) {
-  // Generate the coverge and height data
-  noise::module::Perlin perlin_generator;
-  perlin_generator.SetOctaveCount(8);
-  perlin_generator.SetFrequency(6.0);
-  perlin_generator.SetPersistence(0.4);
-  std::vector<unsigned char> pixels(size * size * 3);
-  for (std::size_t i = 0; i < size; ++i) {
-    for (std::size_t j = 0; j < size; ++j) {
-      float x = (float)i / size;
-      float y = (float)j / size;
-      float a = perlin_generator.GetValue(x    ,y ,   0.0);
-      float b = perlin_generator.GetValue(x+1.0,y ,   0.0);
-      float c = perlin_generator.GetValue(x    ,y+1.0,0.0);
-      float d = perlin_generator.GetValue(x+1.0,y+1.0,0.0);
-      float xmix = 1.0 - x;
-      float ymix = 1.0 - y;
-      float x1 = glm::mix(a, b, xmix);
-      float x2 = glm::mix(c, d, xmix);
-      float val = glm::mix(x1, x2, ymix);
-      // Clamp strictly between 0 and 1
-      val = val> 1.0 ? 1.0 :val;
-      val = val< 0.0 ? 0.0 :val;
-      std::size_t n = size * j + i;
-      pixels[3*n    ] = (unsigned char)std::round(val * 255);
-      pixels[3*n + 1] = (unsigned char)std::round(val * 255);
-    }
-  }
-  // Generate the altitude data
-  // TODO
-  for (std::size_t n = 0; n < size * size; ++n)
-    pixels[3*n + 2] = (unsigned char)0;
-  
+  std::vector<unsigned char> pixels = GenerateWeatherData(size);
+
   // Load the texture
   glGenTextures(1, &weather_);
   glBindTexture(GL_TEXTURE_2D, weather_); 
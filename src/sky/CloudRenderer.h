@@ -1,6 +1,9 @@
 #ifndef CLOUDRENDERER_H
 #define CLOUDRENDERER_H
 
+#include <vector>
+#include <array>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -40,6 +43,13 @@ class CloudRenderer {
   inline void SetCloudStartEnd(const std::array<float,2>& cloud_start_end) {
     cloud_start_end_ = cloud_start_end;
   }
+  
+  //**************************************************************************80
+  //! \brief GenerateWeatherData - generate the RGB pixels of the weather 
+  //! texture (coverage/height/altitude) on the CPU, needs no GL context
+  //! \param[in] size - number of pixels in x/y dimensions of the texture
+  //**************************************************************************80
+  static std::vector<unsigned char> GenerateWeatherData(unsigned size);
 
  private:
   GLuint map_width_;
@@ -76,7 +86,7 @@ class CloudRenderer {
   void SetShaderData(const Sky& sky, const Camera& camera);
   
   //**************************************************************************80
-  //! \brief GenerateWeatherTexture - generate the data for the weather texture
+  //! \brief GenerateWeatherTexture - generate and upload the weather texture
   //! \param[in] size - number of pixels in x/y dimensions of the texture
   //**************************************************************************80
   void GenerateWeatherTexture(unsigned size);
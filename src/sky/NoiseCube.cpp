@@ -13,6 +13,27 @@ namespace TopFun {
 NoiseCube::NoiseCube(const std::array<unsigned,3>& size, 
     const std::string& type, 
     const std::vector<std::vector<NoiseParams>>& params) {
+  std::vector<unsigned char> pixels = GeneratePixels(size, type, params);
+
+  // Load the texture
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_3D, texture_); 
+  // Set our texture parameters
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // Bind the data
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_RED, size[0], size[1], size[2], 0, GL_RED, 
+      GL_UNSIGNED_BYTE, (GLvoid*)pixels.data());
+  glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+//****************************************************************************80
+std::vector<unsigned char> NoiseCube::GeneratePixels(
+    const std::array<unsigned,3>& size, const std::string& type, 
+    const std::vector<std::vector<NoiseParams>>& params) {
   // Check for consistent data sizes
   unsigned num_components = params.size();
   if ((type.compare("shape") == 0 && num_components != 4) || 
@@ -49,28 +70,13 @@ NoiseCube::NoiseCube(const std::array<unsigned,3>& size,
     std::string message = "Invalid noise type\n";
     throw std::invalid_argument(message);
   }
-
-  // Load the texture
-  glGenTextures(1, &texture_);
-  glBindTexture(GL_TEXTURE_3D, texture_); 
-  // Set our texture parameters
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  // Bind the data
-  glTexImage3D(GL_TEXTURE_3D, 0, GL_RED, size[0], size[1], size[2], 0, GL_RED, 
-      GL_UNSIGNED_BYTE, (GLvoid*)pixels.data());
-  glBindTexture(GL_TEXTURE_3D, 0);
+  return pixels;
 }
 
-//****************************************************************************80
-// PRIVATE FUNCTIONS
 //****************************************************************************80
 std::vector<float> NoiseCube::GenerateWorleyNoise(
     const std::array<unsigned,3>& size,
-    const std::vector<NoiseParams>& params) const {
+    const std::vector<NoiseParams>& params) {
   // Check for data size consistency
   std::array<unsigned,3> n_cells;
   glm::vec3 pixel_size;
@@ -144,7 +150,7 @@ std::vector<float> NoiseCube::GenerateWorleyNoise(
 //****************************************************************************80
 std::vector<float> NoiseCube::GeneratePerlinNoise(
     const std::array<unsigned,3>& size,
-    const std::vector<NoiseParams>& params) const {
+    const std::vector<NoiseParams>& params) {
   noise::module::Perlin perlin_generator;
   perlin_generator.SetOctaveCount(params[0].n_octaves_);
   perlin_generator.SetFrequency(params[0].frequency_);
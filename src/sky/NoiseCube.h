@@ -3,6 +3,7 @@
 
 #include <array>
 #include <vector>
+#include <string>
 
 #include <GL/glew.h>
 
@@ -45,22 +46,35 @@ class NoiseCube {
   //**************************************************************************80
   GLuint GetTexture() const { return texture_; }
   
- private:
-  GLuint texture_;
+  //**************************************************************************80
+  //! \brief GeneratePixels - generate the texture data on the CPU, needs no 
+  //! GL context
+  //! \param[in] size - x,y,z dimensions of the cube
+  //! \param[in] type - type of noise ("shape" or "detail")
+  //! \param[in] params - vector of noise parameters for each component
+  //**************************************************************************80
+  static std::vector<unsigned char> GeneratePixels(
+      const std::array<unsigned,3>& size, const std::string& type, 
+      const std::vector<std::vector<NoiseParams>>& params);
   
   //**************************************************************************80
   //! \brief GenerateWorleyNoise - generate tileable Worley noise data
   //! \param[in] params - noise parameters for each dimension
   //**************************************************************************80
-  std::vector<float> GenerateWorleyNoise(const std::array<unsigned,3>& size,
-      const std::vector<NoiseParams>& params) const;
+  static std::vector<float> GenerateWorleyNoise(
+      const std::array<unsigned,3>& size, 
+      const std::vector<NoiseParams>& params);
   
   //**************************************************************************80
   //! \brief GeneratePerlinNoise - generate tileable Perlin noise data
   //! \param[in] params - noise parameters for each dimension
   //**************************************************************************80
-  std::vector<float> GeneratePerlinNoise(const std::array<unsigned,3>& size,
-      const std::vector<NoiseParams>& params) const;
+  static std::vector<float> GeneratePerlinNoise(
+      const std::array<unsigned,3>& size, 
+      const std::vector<NoiseParams>& params);
+  
+ private:
+  GLuint texture_;
 
 };
 } // End namespace TopFun
@@ -1,3 +1,6 @@
+#include <cmath>
+#include <limits>
+
 #include "SOIL.h"
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/gtx/string_cast.hpp"
@@ -111,6 +114,22 @@ void Sky::Draw(Camera const& camera) const {
   glDepthFunc(GL_LESS); // Set depth function back to default
 }
 
+//****************************************************************************80
+float Sky::GetFogOpaqueDistance() const {
+  // Distance where the fog factor in fog.glsl reaches 255/256
+  const float log_256 = std::log(256.0f);
+  switch (fog_eq_) {
+    case 0:
+      return fog_start_end_[1];
+    case 1:
+      return log_256 / fog_density_;
+    case 2:
+      return std::sqrt(log_256) / fog_density_;
+    default:
+      return std::numeric_limits<float>::max();
+  }
+}
+
 //****************************************************************************80
 // PRIVATE FUNCTIONS
 //****************************************************************************80
@@ -88,6 +88,12 @@ class Sky {
   //! \brief SetFogEquation - sets the equation index used to compute fog
   //**************************************************************************80
   inline void SetFogEquation(GLuint fog_eq) { fog_eq_ = fog_eq; }
+  
+  //**************************************************************************80
+  //! \brief GetFogOpaqueDistance - gets the eye-space depth beyond which the 
+  //! fog hides everything (to 8-bit precision)
+  //**************************************************************************80
+  float GetFogOpaqueDistance() const;
 
  private:
   Shader shader_;
@@ -0,0 +1,327 @@
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include "terrain/DEMHeightSource.h"
+
+namespace TopFun {
+
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+DEMHeightSource::DEMHeightSource(const std::vector<File>& files) {
+  std::ostringstream key;
+  key << "dem" << std::setprecision(9);
+  grids_.reserve(files.size());
+  for (const File& file : files) {
+    struct stat st;
+    if (stat(file.path.c_str(), &st) != 0) {
+      std::string message = "Could not read DEM file " + file.path + "\n";
+      throw std::invalid_argument(message);
+    }
+    grids_.emplace_back();
+    Grid& grid = grids_.back();
+    grid.file = file;
+    grid.data = MappedFile(file.path);
+    std::size_t num_samples = grid.data.GetSize() / 2;
+    if (!grid.data.IsOpen() || grid.data.GetSize() % 2 != 0) {
+      std::string message = "Could not map DEM file " + file.path + "\n";
+      throw std::invalid_argument(message);
+    }
+    if (grid.file.width == 0) {
+      grid.file.width = std::lround(std::sqrt((double)num_samples));
+    }
+    if (grid.file.width < 2 || num_samples % grid.file.width != 0 || 
+        num_samples / grid.file.width < 2) {
+      std::string message = "Size of DEM file " + file.path + 
+        " does not match its width\n";
+      throw std::invalid_argument(message);
+    }
+    int height = num_samples / grid.file.width;
+    for (int d = 0; d < 2; ++d) {
+      grid.xz1[d] = grid.file.xz0[d] + grid.file.spacing[d] * 
+        ((d == 0 ? grid.file.width : height) - 1);
+    }
+
+    MipHeader header;
+    std::memset(&header, 0, sizeof(MipHeader));
+    std::memcpy(header.magic, "TFDM", 4);
+    header.version = mip_version_;
+    header.width = grid.file.width;
+    header.height = height;
+    header.num_levels = 1;
+    header.source_size = st.st_size;
+    header.source_mtime = st.st_mtime;
+    LoadPyramid(grid, header);
+
+    key << " " << file.path << " " << (int)file.format << " " 
+      << grid.file.width << " " << file.spacing[0] << " " << file.spacing[1]
+      << " " << file.xz0[0] << " " << file.xz0[1] << " " 
+      << file.height_scale << " " << file.height_offset << " " 
+      << header.source_size << " " << header.source_mtime;
+  }
+  key_ = key.str();
+}
+
+//****************************************************************************80
+DEMHeightSource::File DEMHeightSource::GetSRTMFile(const std::string& path, 
+    float lat_ref, float lon_ref) {
+  // Tile name is [NS]dd[EW]ddd, after any directory
+  std::string name = path.substr(path.find_last_of('/') + 1);
+  int lat, lon;
+  char ns, ew;
+  if (std::sscanf(name.c_str(), "%c%2d%c%3d", &ns, &lat, &ew, &lon) != 4 ||
+      (ns != 'N' && ns != 'S') || (ew != 'E' && ew != 'W')) {
+    std::string message = "Could not parse SRTM tile name " + name + "\n";
+    throw std::invalid_argument(message);
+  }
+  if (ns == 'S') lat = -lat;
+  if (ew == 'W') lon = -lon;
+
+  // 1 or 3 arc second tiles, rows from north to south
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    std::string message = "Could not read DEM file " + path + "\n";
+    throw std::invalid_argument(message);
+  }
+  int width = std::lround(std::sqrt(st.st_size / 2.0));
+  if (width < 2 || 2 * width * width != st.st_size) {
+    std::string message = "SRTM file " + path + " is not square\n";
+    throw std::invalid_argument(message);
+  }
+  const double pi = 3.14159265358979323846;
+  const double earth_radius = 6371000.0;
+  double m_per_deg_z = pi * earth_radius / 180.0;
+  double m_per_deg_x = m_per_deg_z * std::cos(lat_ref * pi / 180.0);
+  File file;
+  file.path = path;
+  file.format = Format::srtm;
+  file.width = width;
+  file.spacing = {{(float)(m_per_deg_x / (width - 1)), 
+    (float)(m_per_deg_z / (width - 1))}};
+  file.xz0 = {{(float)((lon - lon_ref) * m_per_deg_x), 
+    (float)((lat_ref - (lat + 1)) * m_per_deg_z)}};
+  file.height_scale = 1.0f;
+  file.height_offset = 0.0f;
+  return file;
+}
+
+//****************************************************************************80
+void DEMHeightSource::GetHeights(const float* x, const float* z, float* out,
+    std::size_t n, float footprint) const {
+  Sample(x, z, out, nullptr, nullptr, n, footprint);
+}
+
+//****************************************************************************80
+void DEMHeightSource::GetHeightsAndGradients(const float* x, const float* z,
+    float* out, float* dhdx, float* dhdz, std::size_t n, 
+    float footprint) const {
+  Sample(x, z, out, dhdx, dhdz, n, footprint);
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+void DEMHeightSource::Sample(const float* x, const float* z, float* out, 
+    float* dhdx, float* dhdz, std::size_t n, float footprint) const {
+  // Batches usually fall in one file, so try the last one first
+  const Grid* last = nullptr;
+  for (std::size_t i = 0; i < n; ++i) {
+    const Grid* grid = nullptr;
+    if (last && x[i] >= last->file.xz0[0] && x[i] <= last->xz1[0] && 
+        z[i] >= last->file.xz0[1] && z[i] <= last->xz1[1]) {
+      grid = last;
+    }
+    for (std::size_t g = 0; !grid && g < grids_.size(); ++g) {
+      const Grid& candidate = grids_[g];
+      if (x[i] >= candidate.file.xz0[0] && x[i] <= candidate.xz1[0] && 
+          z[i] >= candidate.file.xz0[1] && z[i] <= candidate.xz1[1]) {
+        grid = &candidate;
+      }
+    }
+    if (!grid) {
+      out[i] = 0.0f;
+      if (dhdx) dhdx[i] = dhdz[i] = 0.0f;
+      continue;
+    }
+    last = grid;
+    // Coarsest level whose samples are no further apart than the footprint
+    float spacing = std::max(grid->file.spacing[0], grid->file.spacing[1]);
+    int level = 0;
+    while (level + 1 < (int)grid->levels.size() && 
+        std::ldexp(spacing, level + 1) <= footprint) {
+      ++level;
+    }
+    if (dhdx) {
+      std::array<float,2> gradient;
+      out[i] = Interpolate(*grid, level, x[i], z[i], &gradient);
+      dhdx[i] = gradient[0];
+      dhdz[i] = gradient[1];
+    }
+    else {
+      out[i] = Interpolate(*grid, level, x[i], z[i], nullptr);
+    }
+  }
+}
+
+//****************************************************************************80
+void DEMHeightSource::LoadPyramid(Grid& grid, const MipHeader& header) {
+  // Level sizes, halving (rounded up) until either side is 2 samples
+  Level level0 = {header.width, header.height, grid.file.spacing, nullptr};
+  grid.levels.assign(1, level0);
+  std::vector<std::size_t> offsets(1, 0); // of each level in the mip data
+  std::size_t num_mip_samples = 0;
+  while (std::min(grid.levels.back().width, grid.levels.back().height) > 2) {
+    const Level& fine = grid.levels.back();
+    Level coarse = {(fine.width - 1) / 2 + 1, (fine.height - 1) / 2 + 1,
+      {{2.0f * fine.spacing[0], 2.0f * fine.spacing[1]}}, nullptr};
+    offsets.push_back(num_mip_samples);
+    num_mip_samples += (std::size_t)coarse.width * coarse.height;
+    grid.levels.push_back(coarse);
+  }
+  MipHeader expected = header;
+  expected.num_levels = grid.levels.size();
+  std::size_t mip_bytes = sizeof(float) * num_mip_samples;
+
+  // Map the stored pyramid if it matches the file
+  std::string path = grid.file.path + ".mip";
+  MappedFile mip_file(path);
+  MipHeader stored;
+  if (mip_file.IsOpen() && 
+      mip_file.GetSize() == sizeof(MipHeader) + mip_bytes) {
+    std::memcpy(&stored, mip_file.GetData(), sizeof(MipHeader));
+  }
+  else {
+    std::memset(&stored, 0, sizeof(MipHeader));
+  }
+  if (std::memcmp(stored.magic, expected.magic, 4) == 0 &&
+      stored.version == expected.version && 
+      stored.width == expected.width && stored.height == expected.height &&
+      stored.num_levels == expected.num_levels &&
+      stored.source_size == expected.source_size &&
+      stored.source_mtime == expected.source_mtime) {
+    grid.mip_file = std::move(mip_file);
+    const float* samples = reinterpret_cast<const float*>(
+        static_cast<const char*>(grid.mip_file.GetData()) + 
+        sizeof(MipHeader));
+    for (std::size_t l = 1; l < grid.levels.size(); ++l) {
+      grid.levels[l].samples = samples + offsets[l];
+    }
+    return;
+  }
+
+  // Build each level from the one below with a [1 2 1]^2/16 filter centered
+  // on the coincident sample
+  grid.mip_samples.resize(num_mip_samples);
+  for (std::size_t l = 1; l < grid.levels.size(); ++l) {
+    Level& coarse = grid.levels[l];
+    const Level& fine = grid.levels[l - 1];
+    float* samples = grid.mip_samples.data() + offsets[l];
+    const float weights[3] = {0.25f, 0.5f, 0.25f};
+    for (int j = 0; j < coarse.height; ++j) {
+      for (int i = 0; i < coarse.width; ++i) {
+        float sum = 0.0f;
+        for (int dj = -1; dj <= 1; ++dj) {
+          int jf = std::min(std::max(2 * j + dj, 0), fine.height - 1);
+          for (int di = -1; di <= 1; ++di) {
+            int iff = std::min(std::max(2 * i + di, 0), fine.width - 1);
+            sum += weights[di + 1] * weights[dj + 1] * 
+              GetSample(grid, l - 1, iff, jf);
+          }
+        }
+        samples[coarse.width * j + i] = sum;
+      }
+    }
+    coarse.samples = samples;
+  }
+
+  // Store it next to the file, failures are ignored since the pyramid is
+  // in memory anyway
+  std::string tmp_path = path + ".tmp";
+  std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+  if (!file) return;
+  bool ok = std::fwrite(&expected, sizeof(MipHeader), 1, file) == 1 &&
+    std::fwrite(grid.mip_samples.data(), mip_bytes, 1, file) == 1;
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+  }
+}
+
+//****************************************************************************80
+float DEMHeightSource::GetSample(const Grid& grid, int level, int i, int j) {
+  if (level > 0) {
+    return grid.levels[level].samples[grid.levels[level].width * j + i];
+  }
+  const unsigned char* p = static_cast<const unsigned char*>(
+      grid.data.GetData()) + 2 * ((std::size_t)grid.file.width * j + i);
+  float sample;
+  if (grid.file.format == Format::srtm) {
+    std::int16_t s = (std::int16_t)((p[0] << 8) | p[1]);
+    // Voids are treated as sea level
+    sample = (s == -32768) ? 0.0f : s;
+  }
+  else {
+    sample = (std::uint16_t)(p[0] | (p[1] << 8));
+  }
+  return grid.file.height_scale * sample + grid.file.height_offset;
+}
+
+//****************************************************************************80
+std::array<float,2> DEMHeightSource::GetSampleGradient(const Grid& grid, 
+    int level, int i, int j) {
+  const Level& l = grid.levels[level];
+  int i0 = std::max(i - 1, 0);
+  int i1 = std::min(i + 1, l.width - 1);
+  int j0 = std::max(j - 1, 0);
+  int j1 = std::min(j + 1, l.height - 1);
+  return {{(GetSample(grid, level, i1, j) - GetSample(grid, level, i0, j)) /
+             ((i1 - i0) * l.spacing[0]),
+           (GetSample(grid, level, i, j1) - GetSample(grid, level, i, j0)) /
+             ((j1 - j0) * l.spacing[1])}};
+}
+
+//****************************************************************************80
+float DEMHeightSource::Interpolate(const Grid& grid, int level, float x, 
+    float z, std::array<float,2>* gradient) {
+  const Level& l = grid.levels[level];
+  std::array<int,2> size = {{l.width, l.height}};
+  std::array<float,2> xz = {{x, z}};
+  std::array<int,2> ix;
+  std::array<float,2> s;
+  for (int d = 0; d < 2; ++d) {
+    float u = (xz[d] - grid.file.xz0[d]) / l.spacing[d];
+    u = std::min(std::max(u, 0.0f), (float)(size[d] - 1));
+    ix[d] = std::min((int)u, size[d] - 2);
+    s[d] = u - ix[d];
+  }
+  float h00 = GetSample(grid, level, ix[0]    , ix[1]    );
+  float h10 = GetSample(grid, level, ix[0] + 1, ix[1]    );
+  float h01 = GetSample(grid, level, ix[0]    , ix[1] + 1);
+  float h11 = GetSample(grid, level, ix[0] + 1, ix[1] + 1);
+  if (gradient) {
+    std::array<float,2> g00 = GetSampleGradient(grid, level, ix[0], ix[1]);
+    std::array<float,2> g10 = GetSampleGradient(grid, level, ix[0] + 1, 
+        ix[1]);
+    std::array<float,2> g01 = GetSampleGradient(grid, level, ix[0], 
+        ix[1] + 1);
+    std::array<float,2> g11 = GetSampleGradient(grid, level, ix[0] + 1, 
+        ix[1] + 1);
+    for (int d = 0; d < 2; ++d) {
+      (*gradient)[d] = (1.0f - s[1]) * ((1.0f - s[0]) * g00[d] + 
+                                                 s[0] * g10[d]) +
+                               s[1]  * ((1.0f - s[0]) * g01[d] + 
+                                                 s[0] * g11[d]);
+    }
+  }
+  return (1.0f - s[1]) * ((1.0f - s[0]) * h00 + s[0] * h10) +
+                 s[1]  * ((1.0f - s[0]) * h01 + s[0] * h11);
+}
+
+} // End namespace TopFun
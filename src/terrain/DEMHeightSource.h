@@ -0,0 +1,157 @@
+#ifndef DEMHEIGHTSOURCE_H
+#define DEMHEIGHTSOURCE_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdint>
+
+#include "terrain/HeightSource.h"
+#include "utils/MappedFile.h"
+
+// Heights from digital elevation model (DEM) files, to fly over real regions.
+// Each file is a grid of 16-bit samples that is memory mapped, so only the 
+// pages under the sampled windows are ever read. A mip pyramid of each file
+// is computed once and stored next to it (<file>.mip), and samples taken
+// with a coarse footprint read the matching pyramid level, so distant tiles
+// never touch the full resolution data. Heights are bilinearly interpolated
+// within a level and 0 outside every file. Gradients are central differences
+// at the samples of the level, bilinearly interpolated, so normals are smooth
+// across sample cells.
+
+namespace TopFun {
+
+class DEMHeightSource : public HeightSource {
+
+ public:
+  // Sample layout of a DEM file
+  enum class Format {
+    srtm, // SRTM .hgt: big-endian signed, rows from north to south
+    raw16, // raw heightmap: little-endian unsigned
+  };
+
+  // A DEM file and where its samples lie
+  struct File {
+    std::string path;
+    Format format;
+    int width; // samples per row, 0 for a square file
+    std::array<float,2> spacing; // distance between samples in x/z
+    std::array<float,2> xz0; // location of the first sample
+    float height_scale; // height = height_scale*sample + height_offset
+    float height_offset;
+  };
+
+  //**************************************************************************80
+  //! \brief DEMHeightSource - Constructor, maps the files and loads or builds
+  //! their mip pyramids
+  //! \param[in] files - the DEM files, the first one containing a location 
+  //! gives its height
+  //**************************************************************************80
+  explicit DEMHeightSource(const std::vector<File>& files);
+
+  //**************************************************************************80
+  //! \brief ~DEMHeightSource - Destructor
+  //**************************************************************************80
+  ~DEMHeightSource() = default;
+
+  //**************************************************************************80
+  //! \brief GetSRTMFile - describe an SRTM tile placed by its name (e.g. 
+  //! N37W122.hgt names the tile whose south-west corner is at 37N 122W).
+  //! x points east and z south, from a reference latitude/longitude at the
+  //! origin, using an equirectangular projection about the reference
+  //! \param[in] path - path of the .hgt file
+  //! \param[in] lat_ref - latitude at x = z = 0 in degrees
+  //! \param[in] lon_ref - longitude at x = z = 0 in degrees
+  //**************************************************************************80
+  static File GetSRTMFile(const std::string& path, float lat_ref, 
+      float lon_ref);
+
+  //**************************************************************************80
+  //! \brief GetHeights - sample the DEM at n (x,z) locations, from the
+  //! coarsest pyramid level with sample spacing no larger than footprint
+  //**************************************************************************80
+  void GetHeights(const float* x, const float* z, float* out, std::size_t n,
+      float footprint) const override;
+
+  //**************************************************************************80
+  //! \brief GetHeightsAndGradients - sample the DEM and its gradient at n 
+  //! (x,z) locations, from the same level as GetHeights
+  //**************************************************************************80
+  void GetHeightsAndGradients(const float* x, const float* z, float* out, 
+      float* dhdx, float* dhdz, std::size_t n, 
+      float footprint) const override;
+
+  //**************************************************************************80
+  //! \brief GetKey - string identifying the files, their placement and 
+  //! their modification times
+  //**************************************************************************80
+  std::string GetKey() const override { return key_; }
+
+ private:
+  // One level of a mip pyramid. Sample (i,j) of level l lies on sample 
+  // (2^l*i, 2^l*j) of the file
+  struct Level {
+    int width, height;
+    std::array<float,2> spacing;
+    const float* samples; // null for level 0, which reads the file
+  };
+  // A mapped DEM file and its pyramid
+  struct Grid {
+    File file;
+    MappedFile data; // file samples
+    MappedFile mip_file; // stored pyramid, closed if it could not be stored
+    std::vector<float> mip_samples; // pyramid if it could not be stored
+    std::vector<Level> levels;
+    std::array<float,2> xz1; // location of the last sample
+  };
+  // Start of every pyramid file
+  struct MipHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t width, height;
+    std::int32_t num_levels;
+    std::uint64_t source_size;
+    std::int64_t source_mtime;
+  };
+  static const std::uint32_t mip_version_ = 1;
+  std::vector<Grid> grids_;
+  std::string key_;
+
+  //**************************************************************************80
+  //! \brief Sample - sample the DEM at n (x,z) locations
+  //! \param[out] dhdx, dhdz - gradients, not computed if null
+  //**************************************************************************80
+  void Sample(const float* x, const float* z, float* out, float* dhdx, 
+      float* dhdz, std::size_t n, float footprint) const;
+
+  //**************************************************************************80
+  //! \brief LoadPyramid - map the stored pyramid of a grid, or build it and 
+  //! try to store it
+  //! \param[in,out] grid - grid with its file mapped, levels is filled in
+  //! \param[in] header - expected header of the stored pyramid
+  //**************************************************************************80
+  static void LoadPyramid(Grid& grid, const MipHeader& header);
+
+  //**************************************************************************80
+  //! \brief GetSample - get sample (i,j) of a pyramid level
+  //**************************************************************************80
+  static float GetSample(const Grid& grid, int level, int i, int j);
+
+  //**************************************************************************80
+  //! \brief GetSampleGradient - central difference gradient at sample (i,j)
+  //! of a pyramid level (one-sided at the edges)
+  //**************************************************************************80
+  static std::array<float,2> GetSampleGradient(const Grid& grid, int level, 
+      int i, int j);
+
+  //**************************************************************************80
+  //! \brief Interpolate - bilinearly interpolate a pyramid level at (x,z)
+  //! \param[out] gradient - interpolated gradient, not computed if null
+  //**************************************************************************80
+  static float Interpolate(const Grid& grid, int level, float x, float z,
+      std::array<float,2>* gradient);
+
+};
+} // End namespace TopFun
+
+#endif
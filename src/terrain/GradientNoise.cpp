@@ -0,0 +1,652 @@
+#include <cmath>
+#include <sstream>
+
+#include "terrain/GradientNoise.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define GRADIENTNOISE_X86
+#include <immintrin.h>
+#endif
+
+// Gradient table, defined in libnoise (noise/vectortable.h)
+namespace noise {
+extern double g_randomVectors[256 * 4];
+}
+
+namespace TopFun {
+
+namespace {
+// libnoise lattice hash constants (NOISE_VERSION 2)
+const unsigned x_noise_gen = 1619;
+const unsigned y_noise_gen = 31337;
+const unsigned z_noise_gen = 6971;
+const unsigned seed_noise_gen = 1013;
+
+//****************************************************************************80
+//! \brief Corner - gradient noise contribution of a single lattice point
+//! \param[in] g - gradient table
+//! \param[in] h - lattice hash
+//! \param[in] px, py, pz - offset from the lattice point
+//****************************************************************************80
+inline float Corner(const float* g, unsigned h, float px, float py, float pz) {
+  unsigned ix = ((h ^ (h >> 8)) & 0xff) << 2;
+  return (g[ix] * px + g[ix+1] * py) + g[ix+2] * pz;
+}
+
+//****************************************************************************80
+inline float Lerp(float n0, float n1, float a) {
+  return ((1.0f - a) * n0) + (a * n1);
+}
+
+//****************************************************************************80
+//! \brief CornerGradient - Corner, also returning the x/y components of the
+//! lattice gradient (the derivatives of the contribution)
+//****************************************************************************80
+inline float CornerGradient(const float* g, unsigned h, float px, float py, 
+    float pz, float& gx, float& gy) {
+  unsigned ix = ((h ^ (h >> 8)) & 0xff) << 2;
+  gx = g[ix];
+  gy = g[ix+1];
+  return (g[ix] * px + g[ix+1] * py) + g[ix+2] * pz;
+}
+
+//****************************************************************************80
+//! \brief PlaneGradient - interpolates the corners of one lattice z plane 
+//! and returns the derivatives of the interpolant
+//! \param[in] g - gradient table
+//! \param[in] h - lattice hash of the lower x/y corner
+//! \param[in] fx, fy, fz - offset from the lower corner
+//! \param[in] xs, ys - s-curves of fx and fy
+//! \param[in] dxs, dys - derivatives of the s-curves
+//! \param[out] dx, dy - derivatives in x/y
+//****************************************************************************80
+inline float PlaneGradient(const float* g, unsigned h, float fx, float fy,
+    float fz, float xs, float ys, float dxs, float dys, float& dx, 
+    float& dy) {
+  float g00x, g00y, g10x, g10y, g01x, g01y, g11x, g11y;
+  float n00 = CornerGradient(g, h, fx, fy, fz, g00x, g00y);
+  float n10 = CornerGradient(g, h + x_noise_gen, fx - 1.0f, fy, fz, g10x, 
+      g10y);
+  float n01 = CornerGradient(g, h + y_noise_gen, fx, fy - 1.0f, fz, g01x, 
+      g01y);
+  float n11 = CornerGradient(g, h + x_noise_gen + y_noise_gen, fx - 1.0f, 
+      fy - 1.0f, fz, g11x, g11y);
+  float ix0 = Lerp(n00, n10, xs);
+  float ix1 = Lerp(n01, n11, xs);
+  dx = Lerp(Lerp(g00x, g10x, xs) + (n10 - n00) * dxs, 
+            Lerp(g01x, g11x, xs) + (n11 - n01) * dxs, ys);
+  dy = Lerp(Lerp(g00y, g10y, xs), Lerp(g01y, g11y, xs), ys) + 
+    (ix1 - ix0) * dys;
+  return Lerp(ix0, ix1, ys);
+}
+
+#ifdef GRADIENTNOISE_X86
+//****************************************************************************80
+__attribute__((target("sse4.1")))
+inline __m128 CornerSSE41(const float* g, __m128i h, __m128 px, __m128 py,
+    __m128 pz) {
+  __m128i ix = _mm_slli_epi32(_mm_and_si128(_mm_xor_si128(h,
+          _mm_srli_epi32(h, 8)), _mm_set1_epi32(0xff)), 2);
+  alignas(16) int i[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(i), ix);
+  __m128 gx = _mm_setr_ps(g[i[0]], g[i[1]], g[i[2]], g[i[3]]);
+  __m128 gy = _mm_setr_ps(g[i[0]+1], g[i[1]+1], g[i[2]+1], g[i[3]+1]);
+  __m128 gz = _mm_setr_ps(g[i[0]+2], g[i[1]+2], g[i[2]+2], g[i[3]+2]);
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, px), _mm_mul_ps(gy, py)),
+      _mm_mul_ps(gz, pz));
+}
+
+//****************************************************************************80
+__attribute__((target("sse4.1")))
+inline __m128 LerpSSE41(__m128 n0, __m128 n1, __m128 a) {
+  return _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a), n0),
+      _mm_mul_ps(a, n1));
+}
+
+//****************************************************************************80
+__attribute__((target("sse4.1")))
+inline __m128 CornerGradientSSE41(const float* g, __m128i h, __m128 px, 
+    __m128 py, __m128 pz, __m128& gx, __m128& gy) {
+  __m128i ix = _mm_slli_epi32(_mm_and_si128(_mm_xor_si128(h,
+          _mm_srli_epi32(h, 8)), _mm_set1_epi32(0xff)), 2);
+  alignas(16) int i[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(i), ix);
+  gx = _mm_setr_ps(g[i[0]], g[i[1]], g[i[2]], g[i[3]]);
+  gy = _mm_setr_ps(g[i[0]+1], g[i[1]+1], g[i[2]+1], g[i[3]+1]);
+  __m128 gz = _mm_setr_ps(g[i[0]+2], g[i[1]+2], g[i[2]+2], g[i[3]+2]);
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, px), _mm_mul_ps(gy, py)),
+      _mm_mul_ps(gz, pz));
+}
+
+//****************************************************************************80
+__attribute__((target("sse4.1")))
+inline __m128 PlaneGradientSSE41(const float* g, __m128i h, __m128 fx, 
+    __m128 fy, __m128 fz, __m128 xs, __m128 ys, __m128 dxs, __m128 dys, 
+    __m128& dx, __m128& dy) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128 fx1 = _mm_sub_ps(fx, one);
+  __m128 fy1 = _mm_sub_ps(fy, one);
+  __m128i hx = _mm_add_epi32(h, _mm_set1_epi32(x_noise_gen));
+  __m128i hy = _mm_add_epi32(h, _mm_set1_epi32(y_noise_gen));
+  __m128i hxy = _mm_add_epi32(hx, _mm_set1_epi32(y_noise_gen));
+  __m128 g00x, g00y, g10x, g10y, g01x, g01y, g11x, g11y;
+  __m128 n00 = CornerGradientSSE41(g, h, fx, fy, fz, g00x, g00y);
+  __m128 n10 = CornerGradientSSE41(g, hx, fx1, fy, fz, g10x, g10y);
+  __m128 n01 = CornerGradientSSE41(g, hy, fx, fy1, fz, g01x, g01y);
+  __m128 n11 = CornerGradientSSE41(g, hxy, fx1, fy1, fz, g11x, g11y);
+  __m128 ix0 = LerpSSE41(n00, n10, xs);
+  __m128 ix1 = LerpSSE41(n01, n11, xs);
+  dx = LerpSSE41(
+      _mm_add_ps(LerpSSE41(g00x, g10x, xs), 
+        _mm_mul_ps(_mm_sub_ps(n10, n00), dxs)),
+      _mm_add_ps(LerpSSE41(g01x, g11x, xs), 
+        _mm_mul_ps(_mm_sub_ps(n11, n01), dxs)), ys);
+  dy = _mm_add_ps(LerpSSE41(LerpSSE41(g00y, g10y, xs), 
+        LerpSSE41(g01y, g11y, xs), ys), 
+      _mm_mul_ps(_mm_sub_ps(ix1, ix0), dys));
+  return LerpSSE41(ix0, ix1, ys);
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 CornerAVX2(const float* g, __m256i h, __m256 px, __m256 py,
+    __m256 pz) {
+  __m256i ix = _mm256_slli_epi32(_mm256_and_si256(_mm256_xor_si256(h,
+          _mm256_srli_epi32(h, 8)), _mm256_set1_epi32(0xff)), 2);
+  __m256 gx = _mm256_i32gather_ps(g, ix, 4);
+  __m256 gy = _mm256_i32gather_ps(g + 1, ix, 4);
+  __m256 gz = _mm256_i32gather_ps(g + 2, ix, 4);
+  return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, px),
+        _mm256_mul_ps(gy, py)), _mm256_mul_ps(gz, pz));
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 LerpAVX2(__m256 n0, __m256 n1, __m256 a) {
+  return _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), a),
+        n0), _mm256_mul_ps(a, n1));
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 CornerGradientAVX2(const float* g, __m256i h, __m256 px, 
+    __m256 py, __m256 pz, __m256& gx, __m256& gy) {
+  __m256i ix = _mm256_slli_epi32(_mm256_and_si256(_mm256_xor_si256(h,
+          _mm256_srli_epi32(h, 8)), _mm256_set1_epi32(0xff)), 2);
+  gx = _mm256_i32gather_ps(g, ix, 4);
+  gy = _mm256_i32gather_ps(g + 1, ix, 4);
+  __m256 gz = _mm256_i32gather_ps(g + 2, ix, 4);
+  return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, px),
+        _mm256_mul_ps(gy, py)), _mm256_mul_ps(gz, pz));
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+inline __m256 PlaneGradientAVX2(const float* g, __m256i h, __m256 fx, 
+    __m256 fy, __m256 fz, __m256 xs, __m256 ys, __m256 dxs, __m256 dys, 
+    __m256& dx, __m256& dy) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256 fx1 = _mm256_sub_ps(fx, one);
+  __m256 fy1 = _mm256_sub_ps(fy, one);
+  __m256i hx = _mm256_add_epi32(h, _mm256_set1_epi32(x_noise_gen));
+  __m256i hy = _mm256_add_epi32(h, _mm256_set1_epi32(y_noise_gen));
+  __m256i hxy = _mm256_add_epi32(hx, _mm256_set1_epi32(y_noise_gen));
+  __m256 g00x, g00y, g10x, g10y, g01x, g01y, g11x, g11y;
+  __m256 n00 = CornerGradientAVX2(g, h, fx, fy, fz, g00x, g00y);
+  __m256 n10 = CornerGradientAVX2(g, hx, fx1, fy, fz, g10x, g10y);
+  __m256 n01 = CornerGradientAVX2(g, hy, fx, fy1, fz, g01x, g01y);
+  __m256 n11 = CornerGradientAVX2(g, hxy, fx1, fy1, fz, g11x, g11y);
+  __m256 ix0 = LerpAVX2(n00, n10, xs);
+  __m256 ix1 = LerpAVX2(n01, n11, xs);
+  dx = LerpAVX2(
+      _mm256_add_ps(LerpAVX2(g00x, g10x, xs), 
+        _mm256_mul_ps(_mm256_sub_ps(n10, n00), dxs)),
+      _mm256_add_ps(LerpAVX2(g01x, g11x, xs), 
+        _mm256_mul_ps(_mm256_sub_ps(n11, n01), dxs)), ys);
+  dy = _mm256_add_ps(LerpAVX2(LerpAVX2(g00y, g10y, xs), 
+        LerpAVX2(g01y, g11y, xs), ys), 
+      _mm256_mul_ps(_mm256_sub_ps(ix1, ix0), dys));
+  return LerpAVX2(ix0, ix1, ys);
+}
+#endif
+
+//****************************************************************************80
+//! \brief GetSIMDLevel - widest vector path the CPU supports, 0: scalar, 
+//! 1: SSE4.1, 2: AVX2
+//****************************************************************************80
+int GetSIMDLevel() {
+#ifdef GRADIENTNOISE_X86
+  static const int simd_level = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return 2;
+    if (__builtin_cpu_supports("sse4.1")) return 1;
+    return 0;
+  }();
+  return simd_level;
+#else
+  return 0;
+#endif
+}
+} // End anonymous namespace
+
+//****************************************************************************80
+// STATIC MEMBERS
+//****************************************************************************80
+std::array<float,256*4> GradientNoise::gradients_ =
+  GradientNoise::LoadGradients();
+
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+GradientNoise::GradientNoise(int octave_count, double frequency,
+    double lacunarity, double persistence, int seed, double z,
+    float amplitude) : amplitude_(amplitude) {
+  double f = frequency;
+  double p = 1.0;
+  for (int k = 0; k < octave_count; ++k) {
+    // Same lattice plane and s-curve as noise::GradientCoherentNoise3D
+    double zk = z * f;
+    int z0 = (zk > 0.0 ? (int)zk : (int)zk - 1);
+    double fz = zk - (double)z0;
+    unsigned hash_z0 = z_noise_gen * (unsigned)z0 +
+      seed_noise_gen * (unsigned)(seed + k);
+    Octave o;
+    o.frequency = (float)f;
+    o.persistence = (float)p;
+    o.hash_z0 = (int)hash_z0;
+    o.fz = (float)fz;
+    o.zs = (float)(fz * fz * (3.0 - 2.0 * fz));
+    octaves_.push_back(o);
+    f *= lacunarity;
+    p *= persistence;
+  }
+  std::ostringstream key;
+  key.precision(17);
+  key << "perlin " << octave_count << " " << frequency << " " << lacunarity 
+    << " " << persistence << " " << seed << " " << z << " " << amplitude;
+  key_ = key.str();
+}
+
+//****************************************************************************80
+float GradientNoise::GetValue(float x, float y) const {
+  float value;
+  GetValuesScalar(&x, &y, &value, 1);
+  return value;
+}
+
+//****************************************************************************80
+void GradientNoise::GetValues(const float* x, const float* y, float* out,
+    std::size_t n) const {
+#ifdef GRADIENTNOISE_X86
+  int simd_level = GetSIMDLevel();
+  if (simd_level == 2) {
+    GetValuesAVX2(x, y, out, n);
+    return;
+  }
+  if (simd_level == 1) {
+    GetValuesSSE41(x, y, out, n);
+    return;
+  }
+#endif
+  GetValuesScalar(x, y, out, n);
+}
+
+//****************************************************************************80
+void GradientNoise::GetValuesAndGradients(const float* x, const float* y, 
+    float* out, float* dx, float* dy, std::size_t n) const {
+#ifdef GRADIENTNOISE_X86
+  int simd_level = GetSIMDLevel();
+  if (simd_level == 2) {
+    GetValuesAndGradientsAVX2(x, y, out, dx, dy, n);
+    return;
+  }
+  if (simd_level == 1) {
+    GetValuesAndGradientsSSE41(x, y, out, dx, dy, n);
+    return;
+  }
+#endif
+  GetValuesAndGradientsScalar(x, y, out, dx, dy, n);
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+void GradientNoise::GetValuesScalar(const float* x, const float* y,
+    float* out, std::size_t n) const {
+  const float* g = gradients_.data();
+  for (std::size_t i = 0; i < n; ++i) {
+    float value = 0.0f;
+    for (const Octave& o : octaves_) {
+      float X = x[i] * o.frequency;
+      float Y = y[i] * o.frequency;
+      float x0 = std::floor(X);
+      float y0 = std::floor(Y);
+      float fx = X - x0;
+      float fy = Y - y0;
+      float xs = fx * fx * (3.0f - 2.0f * fx);
+      float ys = fy * fy * (3.0f - 2.0f * fy);
+      unsigned h = x_noise_gen * (unsigned)(int)x0 +
+        y_noise_gen * (unsigned)(int)y0 + (unsigned)o.hash_z0;
+      // Lower z plane
+      float n0 = Corner(g, h, fx, fy, o.fz);
+      float n1 = Corner(g, h + x_noise_gen, fx - 1.0f, fy, o.fz);
+      float ix0 = Lerp(n0, n1, xs);
+      n0 = Corner(g, h + y_noise_gen, fx, fy - 1.0f, o.fz);
+      n1 = Corner(g, h + x_noise_gen + y_noise_gen, fx - 1.0f, fy - 1.0f,
+          o.fz);
+      float ix1 = Lerp(n0, n1, xs);
+      float iy0 = Lerp(ix0, ix1, ys);
+      // Upper z plane
+      h += z_noise_gen;
+      float fz = o.fz - 1.0f;
+      n0 = Corner(g, h, fx, fy, fz);
+      n1 = Corner(g, h + x_noise_gen, fx - 1.0f, fy, fz);
+      ix0 = Lerp(n0, n1, xs);
+      n0 = Corner(g, h + y_noise_gen, fx, fy - 1.0f, fz);
+      n1 = Corner(g, h + x_noise_gen + y_noise_gen, fx - 1.0f, fy - 1.0f, fz);
+      ix1 = Lerp(n0, n1, xs);
+      float iy1 = Lerp(ix0, ix1, ys);
+      value = value + Lerp(iy0, iy1, o.zs) * o.persistence;
+    }
+    out[i] = amplitude_ * value;
+  }
+}
+
+//****************************************************************************80
+void GradientNoise::GetValuesAndGradientsScalar(const float* x, 
+    const float* y, float* out, float* dx, float* dy, std::size_t n) const {
+  const float* g = gradients_.data();
+  for (std::size_t i = 0; i < n; ++i) {
+    float value = 0.0f;
+    float gx = 0.0f;
+    float gy = 0.0f;
+    for (const Octave& o : octaves_) {
+      float X = x[i] * o.frequency;
+      float Y = y[i] * o.frequency;
+      float x0 = std::floor(X);
+      float y0 = std::floor(Y);
+      float fx = X - x0;
+      float fy = Y - y0;
+      float xs = fx * fx * (3.0f - 2.0f * fx);
+      float ys = fy * fy * (3.0f - 2.0f * fy);
+      float dxs = 6.0f * fx * (1.0f - fx);
+      float dys = 6.0f * fy * (1.0f - fy);
+      unsigned h = x_noise_gen * (unsigned)(int)x0 +
+        y_noise_gen * (unsigned)(int)y0 + (unsigned)o.hash_z0;
+      // Lower and upper z planes
+      float dx0, dy0, dx1, dy1;
+      float iy0 = PlaneGradient(g, h, fx, fy, o.fz, xs, ys, dxs, dys, dx0,
+          dy0);
+      float iy1 = PlaneGradient(g, h + z_noise_gen, fx, fy, o.fz - 1.0f, xs,
+          ys, dxs, dys, dx1, dy1);
+      value = value + Lerp(iy0, iy1, o.zs) * o.persistence;
+      // Chain rule through the octave frequency
+      float scale = o.persistence * o.frequency;
+      gx = gx + Lerp(dx0, dx1, o.zs) * scale;
+      gy = gy + Lerp(dy0, dy1, o.zs) * scale;
+    }
+    out[i] = amplitude_ * value;
+    dx[i] = amplitude_ * gx;
+    dy[i] = amplitude_ * gy;
+  }
+}
+
+#ifdef GRADIENTNOISE_X86
+//****************************************************************************80
+__attribute__((target("sse4.1")))
+void GradientNoise::GetValuesSSE41(const float* x, const float* y,
+    float* out, std::size_t n) const {
+  const float* g = gradients_.data();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 three = _mm_set1_ps(3.0f);
+  const __m128i dhx = _mm_set1_epi32(x_noise_gen);
+  const __m128i dhy = _mm_set1_epi32(y_noise_gen);
+  const __m128i dhz = _mm_set1_epi32(z_noise_gen);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 xi = _mm_loadu_ps(x + i);
+    __m128 yi = _mm_loadu_ps(y + i);
+    __m128 value = _mm_setzero_ps();
+    for (const Octave& o : octaves_) {
+      __m128 f = _mm_set1_ps(o.frequency);
+      __m128 X = _mm_mul_ps(xi, f);
+      __m128 Y = _mm_mul_ps(yi, f);
+      __m128 x0 = _mm_floor_ps(X);
+      __m128 y0 = _mm_floor_ps(Y);
+      __m128 fx = _mm_sub_ps(X, x0);
+      __m128 fy = _mm_sub_ps(Y, y0);
+      __m128 fx1 = _mm_sub_ps(fx, one);
+      __m128 fy1 = _mm_sub_ps(fy, one);
+      __m128 xs = _mm_mul_ps(_mm_mul_ps(fx, fx),
+          _mm_sub_ps(three, _mm_mul_ps(two, fx)));
+      __m128 ys = _mm_mul_ps(_mm_mul_ps(fy, fy),
+          _mm_sub_ps(three, _mm_mul_ps(two, fy)));
+      __m128i h = _mm_add_epi32(_mm_add_epi32(
+            _mm_mullo_epi32(_mm_cvttps_epi32(x0), dhx),
+            _mm_mullo_epi32(_mm_cvttps_epi32(y0), dhy)),
+          _mm_set1_epi32(o.hash_z0));
+      __m128i hx = _mm_add_epi32(h, dhx);
+      __m128i hy = _mm_add_epi32(h, dhy);
+      __m128i hxy = _mm_add_epi32(hx, dhy);
+      // Lower z plane
+      __m128 fz = _mm_set1_ps(o.fz);
+      __m128 ix0 = LerpSSE41(CornerSSE41(g, h, fx, fy, fz),
+          CornerSSE41(g, hx, fx1, fy, fz), xs);
+      __m128 ix1 = LerpSSE41(CornerSSE41(g, hy, fx, fy1, fz),
+          CornerSSE41(g, hxy, fx1, fy1, fz), xs);
+      __m128 iy0 = LerpSSE41(ix0, ix1, ys);
+      // Upper z plane
+      fz = _mm_set1_ps(o.fz - 1.0f);
+      h = _mm_add_epi32(h, dhz);
+      hx = _mm_add_epi32(hx, dhz);
+      hy = _mm_add_epi32(hy, dhz);
+      hxy = _mm_add_epi32(hxy, dhz);
+      ix0 = LerpSSE41(CornerSSE41(g, h, fx, fy, fz),
+          CornerSSE41(g, hx, fx1, fy, fz), xs);
+      ix1 = LerpSSE41(CornerSSE41(g, hy, fx, fy1, fz),
+          CornerSSE41(g, hxy, fx1, fy1, fz), xs);
+      __m128 iy1 = LerpSSE41(ix0, ix1, ys);
+      value = _mm_add_ps(value, _mm_mul_ps(LerpSSE41(iy0, iy1,
+              _mm_set1_ps(o.zs)), _mm_set1_ps(o.persistence)));
+    }
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_set1_ps(amplitude_), value));
+  }
+  GetValuesScalar(x + i, y + i, out + i, n - i);
+}
+
+//****************************************************************************80
+__attribute__((target("sse4.1")))
+void GradientNoise::GetValuesAndGradientsSSE41(const float* x, 
+    const float* y, float* out, float* dx, float* dy, std::size_t n) const {
+  const float* g = gradients_.data();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 three = _mm_set1_ps(3.0f);
+  const __m128 six = _mm_set1_ps(6.0f);
+  const __m128i dhx = _mm_set1_epi32(x_noise_gen);
+  const __m128i dhy = _mm_set1_epi32(y_noise_gen);
+  const __m128i dhz = _mm_set1_epi32(z_noise_gen);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 xi = _mm_loadu_ps(x + i);
+    __m128 yi = _mm_loadu_ps(y + i);
+    __m128 value = _mm_setzero_ps();
+    __m128 gx = _mm_setzero_ps();
+    __m128 gy = _mm_setzero_ps();
+    for (const Octave& o : octaves_) {
+      __m128 f = _mm_set1_ps(o.frequency);
+      __m128 X = _mm_mul_ps(xi, f);
+      __m128 Y = _mm_mul_ps(yi, f);
+      __m128 x0 = _mm_floor_ps(X);
+      __m128 y0 = _mm_floor_ps(Y);
+      __m128 fx = _mm_sub_ps(X, x0);
+      __m128 fy = _mm_sub_ps(Y, y0);
+      __m128 xs = _mm_mul_ps(_mm_mul_ps(fx, fx),
+          _mm_sub_ps(three, _mm_mul_ps(two, fx)));
+      __m128 ys = _mm_mul_ps(_mm_mul_ps(fy, fy),
+          _mm_sub_ps(three, _mm_mul_ps(two, fy)));
+      __m128 dxs = _mm_mul_ps(_mm_mul_ps(six, fx), _mm_sub_ps(one, fx));
+      __m128 dys = _mm_mul_ps(_mm_mul_ps(six, fy), _mm_sub_ps(one, fy));
+      __m128i h = _mm_add_epi32(_mm_add_epi32(
+            _mm_mullo_epi32(_mm_cvttps_epi32(x0), dhx),
+            _mm_mullo_epi32(_mm_cvttps_epi32(y0), dhy)),
+          _mm_set1_epi32(o.hash_z0));
+      // Lower and upper z planes
+      __m128 dx0, dy0, dx1, dy1;
+      __m128 iy0 = PlaneGradientSSE41(g, h, fx, fy, _mm_set1_ps(o.fz), xs, 
+          ys, dxs, dys, dx0, dy0);
+      __m128 iy1 = PlaneGradientSSE41(g, _mm_add_epi32(h, dhz), fx, fy, 
+          _mm_set1_ps(o.fz - 1.0f), xs, ys, dxs, dys, dx1, dy1);
+      __m128 zs = _mm_set1_ps(o.zs);
+      value = _mm_add_ps(value, _mm_mul_ps(LerpSSE41(iy0, iy1, zs), 
+            _mm_set1_ps(o.persistence)));
+      // Chain rule through the octave frequency
+      __m128 scale = _mm_set1_ps(o.persistence * o.frequency);
+      gx = _mm_add_ps(gx, _mm_mul_ps(LerpSSE41(dx0, dx1, zs), scale));
+      gy = _mm_add_ps(gy, _mm_mul_ps(LerpSSE41(dy0, dy1, zs), scale));
+    }
+    __m128 amplitude = _mm_set1_ps(amplitude_);
+    _mm_storeu_ps(out + i, _mm_mul_ps(amplitude, value));
+    _mm_storeu_ps(dx + i, _mm_mul_ps(amplitude, gx));
+    _mm_storeu_ps(dy + i, _mm_mul_ps(amplitude, gy));
+  }
+  GetValuesAndGradientsScalar(x + i, y + i, out + i, dx + i, dy + i, n - i);
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+void GradientNoise::GetValuesAVX2(const float* x, const float* y,
+    float* out, std::size_t n) const {
+  const float* g = gradients_.data();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 three = _mm256_set1_ps(3.0f);
+  const __m256i dhx = _mm256_set1_epi32(x_noise_gen);
+  const __m256i dhy = _mm256_set1_epi32(y_noise_gen);
+  const __m256i dhz = _mm256_set1_epi32(z_noise_gen);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 xi = _mm256_loadu_ps(x + i);
+    __m256 yi = _mm256_loadu_ps(y + i);
+    __m256 value = _mm256_setzero_ps();
+    for (const Octave& o : octaves_) {
+      __m256 f = _mm256_set1_ps(o.frequency);
+      __m256 X = _mm256_mul_ps(xi, f);
+      __m256 Y = _mm256_mul_ps(yi, f);
+      __m256 x0 = _mm256_floor_ps(X);
+      __m256 y0 = _mm256_floor_ps(Y);
+      __m256 fx = _mm256_sub_ps(X, x0);
+      __m256 fy = _mm256_sub_ps(Y, y0);
+      __m256 fx1 = _mm256_sub_ps(fx, one);
+      __m256 fy1 = _mm256_sub_ps(fy, one);
+      __m256 xs = _mm256_mul_ps(_mm256_mul_ps(fx, fx),
+          _mm256_sub_ps(three, _mm256_mul_ps(two, fx)));
+      __m256 ys = _mm256_mul_ps(_mm256_mul_ps(fy, fy),
+          _mm256_sub_ps(three, _mm256_mul_ps(two, fy)));
+      __m256i h = _mm256_add_epi32(_mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_cvttps_epi32(x0), dhx),
+            _mm256_mullo_epi32(_mm256_cvttps_epi32(y0), dhy)),
+          _mm256_set1_epi32(o.hash_z0));
+      __m256i hx = _mm256_add_epi32(h, dhx);
+      __m256i hy = _mm256_add_epi32(h, dhy);
+      __m256i hxy = _mm256_add_epi32(hx, dhy);
+      // Lower z plane
+      __m256 fz = _mm256_set1_ps(o.fz);
+      __m256 ix0 = LerpAVX2(CornerAVX2(g, h, fx, fy, fz),
+          CornerAVX2(g, hx, fx1, fy, fz), xs);
+      __m256 ix1 = LerpAVX2(CornerAVX2(g, hy, fx, fy1, fz),
+          CornerAVX2(g, hxy, fx1, fy1, fz), xs);
+      __m256 iy0 = LerpAVX2(ix0, ix1, ys);
+      // Upper z plane
+      fz = _mm256_set1_ps(o.fz - 1.0f);
+      h = _mm256_add_epi32(h, dhz);
+      hx = _mm256_add_epi32(hx, dhz);
+      hy = _mm256_add_epi32(hy, dhz);
+      hxy = _mm256_add_epi32(hxy, dhz);
+      ix0 = LerpAVX2(CornerAVX2(g, h, fx, fy, fz),
+          CornerAVX2(g, hx, fx1, fy, fz), xs);
+      ix1 = LerpAVX2(CornerAVX2(g, hy, fx, fy1, fz),
+          CornerAVX2(g, hxy, fx1, fy1, fz), xs);
+      __m256 iy1 = LerpAVX2(ix0, ix1, ys);
+      value = _mm256_add_ps(value, _mm256_mul_ps(LerpAVX2(iy0, iy1,
+              _mm256_set1_ps(o.zs)), _mm256_set1_ps(o.persistence)));
+    }
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_set1_ps(amplitude_),
+          value));
+  }
+  GetValuesScalar(x + i, y + i, out + i, n - i);
+}
+
+//****************************************************************************80
+__attribute__((target("avx2")))
+void GradientNoise::GetValuesAndGradientsAVX2(const float* x, 
+    const float* y, float* out, float* dx, float* dy, std::size_t n) const {
+  const float* g = gradients_.data();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 three = _mm256_set1_ps(3.0f);
+  const __m256 six = _mm256_set1_ps(6.0f);
+  const __m256i dhx = _mm256_set1_epi32(x_noise_gen);
+  const __m256i dhy = _mm256_set1_epi32(y_noise_gen);
+  const __m256i dhz = _mm256_set1_epi32(z_noise_gen);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 xi = _mm256_loadu_ps(x + i);
+    __m256 yi = _mm256_loadu_ps(y + i);
+    __m256 value = _mm256_setzero_ps();
+    __m256 gx = _mm256_setzero_ps();
+    __m256 gy = _mm256_setzero_ps();
+    for (const Octave& o : octaves_) {
+      __m256 f = _mm256_set1_ps(o.frequency);
+      __m256 X = _mm256_mul_ps(xi, f);
+      __m256 Y = _mm256_mul_ps(yi, f);
+      __m256 x0 = _mm256_floor_ps(X);
+      __m256 y0 = _mm256_floor_ps(Y);
+      __m256 fx = _mm256_sub_ps(X, x0);
+      __m256 fy = _mm256_sub_ps(Y, y0);
+      __m256 xs = _mm256_mul_ps(_mm256_mul_ps(fx, fx),
+          _mm256_sub_ps(three, _mm256_mul_ps(two, fx)));
+      __m256 ys = _mm256_mul_ps(_mm256_mul_ps(fy, fy),
+          _mm256_sub_ps(three, _mm256_mul_ps(two, fy)));
+      __m256 dxs = _mm256_mul_ps(_mm256_mul_ps(six, fx), 
+          _mm256_sub_ps(one, fx));
+      __m256 dys = _mm256_mul_ps(_mm256_mul_ps(six, fy), 
+          _mm256_sub_ps(one, fy));
+      __m256i h = _mm256_add_epi32(_mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_cvttps_epi32(x0), dhx),
+            _mm256_mullo_epi32(_mm256_cvttps_epi32(y0), dhy)),
+          _mm256_set1_epi32(o.hash_z0));
+      // Lower and upper z planes
+      __m256 dx0, dy0, dx1, dy1;
+      __m256 iy0 = PlaneGradientAVX2(g, h, fx, fy, _mm256_set1_ps(o.fz), xs, 
+          ys, dxs, dys, dx0, dy0);
+      __m256 iy1 = PlaneGradientAVX2(g, _mm256_add_epi32(h, dhz), fx, fy, 
+          _mm256_set1_ps(o.fz - 1.0f), xs, ys, dxs, dys, dx1, dy1);
+      __m256 zs = _mm256_set1_ps(o.zs);
+      value = _mm256_add_ps(value, _mm256_mul_ps(LerpAVX2(iy0, iy1, zs), 
+            _mm256_set1_ps(o.persistence)));
+      // Chain rule through the octave frequency
+      __m256 scale = _mm256_set1_ps(o.persistence * o.frequency);
+      gx = _mm256_add_ps(gx, _mm256_mul_ps(LerpAVX2(dx0, dx1, zs), scale));
+      gy = _mm256_add_ps(gy, _mm256_mul_ps(LerpAVX2(dy0, dy1, zs), scale));
+    }
+    __m256 amplitude = _mm256_set1_ps(amplitude_);
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(amplitude, value));
+    _mm256_storeu_ps(dx + i, _mm256_mul_ps(amplitude, gx));
+    _mm256_storeu_ps(dy + i, _mm256_mul_ps(amplitude, gy));
+  }
+  GetValuesAndGradientsScalar(x + i, y + i, out + i, dx + i, dy + i, n - i);
+}
+#endif
+
+//****************************************************************************80
+std::array<float,256*4> GradientNoise::LoadGradients() {
+  std::array<float,256*4> gradients;
+  for (std::size_t i = 0; i < gradients.size(); ++i) {
+    gradients[i] = (float)(2.12 * noise::g_randomVectors[i]);
+  }
+  return gradients;
+}
+
+} // End namespace TopFun
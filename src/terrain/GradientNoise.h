@@ -0,0 +1,137 @@
+#ifndef GRADIENTNOISE_H
+#define GRADIENTNOISE_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// Batched, single precision evaluation of libnoise's Perlin module (standard
+// quality) on a plane of constant z. Uses the libnoise lattice hash and
+// gradient table, so results match noise::module::Perlin::GetValue to within
+// float round-off. The batch path is vectorized with SSE4.1 or AVX2 when the
+// CPU supports it; all paths perform the same float operations in the same
+// order, so they return bit-identical results. The noise gradient can be
+// evaluated along with the values by differentiating the interpolation
+// analytically, at about the cost of the values alone.
+
+namespace TopFun {
+
+class GradientNoise {
+
+ public:
+  //**************************************************************************80
+  //! \brief GradientNoise - Constructor
+  //! \param[in] octave_count - number of octaves
+  //! \param[in] frequency - frequency of the first octave
+  //! \param[in] lacunarity - frequency multiplier between octaves
+  //! \param[in] persistence - amplitude multiplier between octaves
+  //! \param[in] seed - libnoise seed
+  //! \param[in] z - z coordinate of the sampled plane (before frequency)
+  //! \param[in] amplitude - scale factor applied to the output
+  //**************************************************************************80
+  GradientNoise(int octave_count, double frequency, double lacunarity,
+      double persistence, int seed, double z, float amplitude);
+
+  //**************************************************************************80
+  //! \brief ~GradientNoise - Destructor
+  //**************************************************************************80
+  ~GradientNoise() = default;
+
+  //**************************************************************************80
+  //! \brief GetValue - evaluate the noise at a single (x,y) location
+  //**************************************************************************80
+  float GetValue(float x, float y) const;
+
+  //**************************************************************************80
+  //! \brief GetValues - evaluate the noise at n (x,y) locations
+  //! \param[in] x - x coordinates
+  //! \param[in] y - y coordinates
+  //! \param[out] out - noise values
+  //! \param[in] n - number of locations
+  //**************************************************************************80
+  void GetValues(const float* x, const float* y, float* out,
+      std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetValuesAndGradients - evaluate the noise and its gradient at n
+  //! (x,y) locations. Values are bit-identical to GetValues
+  //! \param[in] x - x coordinates
+  //! \param[in] y - y coordinates
+  //! \param[out] out - noise values
+  //! \param[out] dx - derivatives of the noise in x
+  //! \param[out] dy - derivatives of the noise in y
+  //! \param[in] n - number of locations
+  //**************************************************************************80
+  void GetValuesAndGradients(const float* x, const float* y, float* out,
+      float* dx, float* dy, std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetKey - string identifying the noise parameters, equal keys 
+  //! give equal noise
+  //**************************************************************************80
+  inline const std::string& GetKey() const { return key_; }
+
+ private:
+  // Per-octave constants
+  struct Octave {
+    float frequency;
+    float persistence;
+    int hash_z0; // hash contribution of seed and lower z lattice plane
+    float fz; // offset of the plane from the lower z lattice plane
+    float zs; // s-curve of fz
+  };
+  std::vector<Octave> octaves_;
+  float amplitude_;
+  std::string key_;
+  // libnoise gradient vectors (x,y,z,pad), prescaled by 2.12
+  static std::array<float,256*4> gradients_;
+
+  //**************************************************************************80
+  //! \brief GetValuesScalar - portable path of GetValues
+  //**************************************************************************80
+  void GetValuesScalar(const float* x, const float* y, float* out,
+      std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetValuesSSE41 - 4-wide SSE4.1 path of GetValues
+  //**************************************************************************80
+  void GetValuesSSE41(const float* x, const float* y, float* out,
+      std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetValuesAVX2 - 8-wide AVX2 path of GetValues
+  //**************************************************************************80
+  void GetValuesAVX2(const float* x, const float* y, float* out,
+      std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetValuesAndGradientsScalar - portable path of 
+  //! GetValuesAndGradients
+  //**************************************************************************80
+  void GetValuesAndGradientsScalar(const float* x, const float* y, 
+      float* out, float* dx, float* dy, std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetValuesAndGradientsSSE41 - 4-wide SSE4.1 path of 
+  //! GetValuesAndGradients
+  //**************************************************************************80
+  void GetValuesAndGradientsSSE41(const float* x, const float* y, 
+      float* out, float* dx, float* dy, std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetValuesAndGradientsAVX2 - 8-wide AVX2 path of 
+  //! GetValuesAndGradients
+  //**************************************************************************80
+  void GetValuesAndGradientsAVX2(const float* x, const float* y, 
+      float* out, float* dx, float* dy, std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief LoadGradients - copy the libnoise gradient table to float
+  //**************************************************************************80
+  static std::array<float,256*4> LoadGradients();
+
+};
+} // End namespace TopFun
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef HEIGHTSOURCE_H
+#define HEIGHTSOURCE_H
+
+#include <string>
+#include <cstddef>
+
+// Terrain height function sampled by the tiles and the height queries.
+// Implementations must be safe to call from several threads at once, since
+// tiles are generated on a thread pool.
+
+namespace TopFun {
+
+class HeightSource {
+
+ public:
+  //**************************************************************************80
+  //! \brief ~HeightSource - Destructor
+  //**************************************************************************80
+  virtual ~HeightSource() = default;
+
+  //**************************************************************************80
+  //! \brief GetHeight - get the height at a single (x,z) location
+  //! \param[in] x - x coordinate
+  //! \param[in] z - z coordinate
+  //! \param[in] footprint - distance between the samples the caller takes,
+  //! sources may return data prefiltered to it. 0 for full resolution
+  //**************************************************************************80
+  inline float GetHeight(float x, float z, float footprint = 0.0f) const {
+    float height;
+    GetHeights(&x, &z, &height, 1, footprint);
+    return height;
+  }
+
+  //**************************************************************************80
+  //! \brief GetHeights - get the height at n (x,z) locations
+  //! \param[in] x - x coordinates
+  //! \param[in] z - z coordinates
+  //! \param[out] out - heights
+  //! \param[in] n - number of locations
+  //! \param[in] footprint - distance between the samples the caller takes,
+  //! sources may return data prefiltered to it. 0 for full resolution
+  //**************************************************************************80
+  virtual void GetHeights(const float* x, const float* z, float* out, 
+      std::size_t n, float footprint) const = 0;
+
+  //**************************************************************************80
+  //! \brief GetHeightsAndGradients - get the height and its gradient at n 
+  //! (x,z) locations, heights equal those of GetHeights
+  //! \param[in] x - x coordinates
+  //! \param[in] z - z coordinates
+  //! \param[out] out - heights
+  //! \param[out] dhdx - derivatives of the height in x
+  //! \param[out] dhdz - derivatives of the height in z
+  //! \param[in] n - number of locations
+  //! \param[in] footprint - as for GetHeights
+  //**************************************************************************80
+  virtual void GetHeightsAndGradients(const float* x, const float* z, 
+      float* out, float* dhdx, float* dhdz, std::size_t n, 
+      float footprint) const = 0;
+
+  //**************************************************************************80
+  //! \brief GetKey - string identifying the height function, equal keys give
+  //! equal heights (used to validate cached tiles)
+  //**************************************************************************80
+  virtual std::string GetKey() const = 0;
+
+};
+} // End namespace TopFun
+
+#endif
@@ -1,33 +1,44 @@
-#include <boost/tuple/tuple.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
-#include <boost/unordered_map.hpp>
+#ifndef NEIGHBORLOD_H
+#define NEIGHBORLOD_H
+
+#include <cstdint>
 
 namespace TopFun {
 
+// Number of levels of detail of a terrain tile (at most 8, see NeighborLoD)
+const unsigned short terrain_num_lod = 6;
+
+// Level of detail of a tile (c) and its north, east, south and west 
+// neighbors, packed 3 bits each into a 15 bit key (c<<12|n<<9|e<<6|s<<3|w)
+// that directly indexes the stitching tables
 struct NeighborLoD {
+  static const int num_keys = 1 << 15;
+
   NeighborLoD(unsigned short lod_c, unsigned short lod_n, unsigned short lod_e,
       unsigned short lod_s, unsigned short lod_w)
-    : tuple(lod_c,lod_n,lod_e,lod_s,lod_w) {}
-  boost::tuples::tuple<unsigned short, unsigned short, unsigned short, 
-    unsigned short, unsigned short> tuple;
+    : key((lod_c << 12) | (lod_n << 9) | (lod_e << 6) | (lod_s << 3) | lod_w) {}
+  
+  // Level of detail ix (0:c, 1:n, 2:e, 3:s, 4:w)
+  inline unsigned short Get(int ix) const { 
+    return (key >> (3*(4 - ix))) & 7; 
+  }
+
+  inline void Set(int ix, unsigned short lod) {
+    int shift = 3*(4 - ix);
+    key = (key & ~(7 << shift)) | (lod << shift);
+  }
+
+  std::uint16_t key;
 };
 
 inline bool operator==(const NeighborLoD &a, const NeighborLoD &b) {
-  return a.tuple == b.tuple;
+  return a.key == b.key;
 }
 
 inline bool operator!=(const NeighborLoD &a, const NeighborLoD &b) {
-  return a.tuple != b.tuple;
-}
-
-inline std::size_t hash_value(const NeighborLoD &e) {
-  std::size_t seed = 0;
-  boost::hash_combine(seed, e.tuple.get<0>());
-  boost::hash_combine(seed, e.tuple.get<1>());
-  boost::hash_combine(seed, e.tuple.get<2>());
-  boost::hash_combine(seed, e.tuple.get<3>());
-  boost::hash_combine(seed, e.tuple.get<4>());
-  return seed;
+  return a.key != b.key;
 }
 
 } // End namespace TopFun
+
+#endif
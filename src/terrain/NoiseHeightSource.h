@@ -0,0 +1,50 @@
+#ifndef NOISEHEIGHTSOURCE_H
+#define NOISEHEIGHTSOURCE_H
+
+#include "terrain/HeightSource.h"
+#include "terrain/GradientNoise.h"
+
+// Procedural heights from gradient noise. The noise is evaluated exactly at
+// every location, so the sample footprint is ignored.
+
+namespace TopFun {
+
+class NoiseHeightSource : public HeightSource {
+
+ public:
+  //**************************************************************************80
+  //! \brief NoiseHeightSource - Constructor
+  //! \param[in] noise - noise giving the height
+  //**************************************************************************80
+  explicit NoiseHeightSource(const GradientNoise& noise) : noise_(noise) {}
+
+  //**************************************************************************80
+  //! \brief GetHeights - evaluate the noise at n (x,z) locations
+  //**************************************************************************80
+  void GetHeights(const float* x, const float* z, float* out, std::size_t n,
+      float /*footprint*/) const override {
+    noise_.GetValues(x, z, out, n);
+  }
+
+  //**************************************************************************80
+  //! \brief GetHeightsAndGradients - evaluate the noise and its analytic 
+  //! gradient at n (x,z) locations
+  //**************************************************************************80
+  void GetHeightsAndGradients(const float* x, const float* z, float* out, 
+      float* dhdx, float* dhdz, std::size_t n, 
+      float /*footprint*/) const override {
+    noise_.GetValuesAndGradients(x, z, out, dhdx, dhdz, n);
+  }
+
+  //**************************************************************************80
+  //! \brief GetKey - string identifying the noise parameters
+  //**************************************************************************80
+  std::string GetKey() const override { return "noise " + noise_.GetKey(); }
+
+ private:
+  GradientNoise noise_;
+
+};
+} // End namespace TopFun
+
+#endif
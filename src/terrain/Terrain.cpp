@@ -1,3 +1,7 @@
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
 #include <SOIL.h>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -6,147 +10,161 @@
 #include "render/ShadowCascadeRenderer.h"
 
 namespace TopFun {
-//****************************************************************************80
-// STATIC MEMBERS
-//****************************************************************************80
-noise::module::Perlin Terrain::perlin_generator_;
-
 //****************************************************************************80
 // PUBLIC FUNCTIONS
 //****************************************************************************80
-Terrain::Terrain(float l, int ntile, const std::array<float,2>& xz_center0) :
-  shader_("shaders/terrain.vs", "shaders/terrain.fs"), ntile_(ntile),
-  ltile_(l / ntile), xz_center0_(xz_center0) {
-  // Use odd number of tiles to make math easier
-  if (ntile_ % 2 == 0) {
-    std::string message = "Number of tiles in each direction should be odd\n";
-    throw std::invalid_argument(message);
-  }
+Terrain::Terrain(float l, int ntile, const std::array<double,2>& xz_center0,
+    const std::string& tile_cache_directory, 
+    std::unique_ptr<HeightSource> height_source) :
+  TerrainCore(l, ntile, xz_center0, tile_cache_directory, 
+      std::move(height_source), true), height_map_(0), tile_data_(0),
+  pixel_tolerance_(2.0f) {
+  GLint nv = TerrainTile::GetNumVertices();
+  shader_.reset(new Shader("shaders/terrain.vs", "shaders/terrain.fs"));
+  depth_shader_.reset(new Shader("shaders/terrain_depth.vs", 
+        "shaders/depthmap.fs"));
+  albedo_.reset(new TerrainAlbedo(ntile * ntile, ltile_));
 
-  // Set the noise parameters
-  perlin_generator_.SetOctaveCount(3);
-  perlin_generator_.SetFrequency(0.04);
-  perlin_generator_.SetPersistence(0.75);
-  
   // Load the textures
   // LoadTextures();
+  
+  // Allocate the height map holding the vertices of every tile slot
+  GLint max_texture_size;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+  if (ntile_ * nv > max_texture_size) {
+    std::string message = "Number of tiles exceeds the height map size\n";
+    throw std::invalid_argument(message);
+  }
+  glGenTextures(1, &height_map_);
+  glBindTexture(GL_TEXTURE_2D, height_map_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, ntile_ * nv, ntile_ * nv, 0, 
+      GL_RGBA, GL_UNSIGNED_SHORT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  
+  // Texels per slot holding the location, LoD, height range and edge LoDs
+  // of its tile
+  glGenTextures(1, &tile_data_);
+  glBindTexture(GL_TEXTURE_2D, tile_data_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, tile_data_texels_ * ntile_, 
+      ntile_, 0, GL_RGBA, GL_FLOAT, NULL);
+  tile_data_staging_.resize(4 * tile_data_texels_ * ntile_ * ntile_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  TerrainTile::CreateSharedObjects();
     
-  // Set up the tiles
-  TerrainTile::SetTileLength(ltile_);
-  int half_ntile = (ntile_ - 1) / 2;
-  for (int i = -half_ntile; i <= half_ntile; ++i) {
-    for (int j = -half_ntile; j <= half_ntile; ++j) {
-      tiles_.emplace(std::piecewise_construct,
-                     std::forward_as_tuple(ntile_*j + i),
-                     std::forward_as_tuple(shader_, 
-                       xz_center0_[0] + ltile_*(i - 0.5), 
-                       xz_center0_[1] + ltile_*(j - 0.5)));
+  // Upload the tiles the core finished loading, the rest draw a coarse 
+  // placeholder until SetXZCenter uploads them as they finish
+  for (auto& t : tiles_) {
+    if (t->IsLoaded()) {
+      t->UploadTexels(height_map_);
+    }
+    else {
+      t->UploadPlaceholder(height_map_);
     }
   }
-  tile_bounding_box_ = {{-half_ntile, -half_ntile, half_ntile, half_ntile}};
-  UpdateTileConnectivity();
+  UpdateQuadtree();
+  // Valid tile data for depth passes drawn before the first main pass
+  UpdateTileData();
 }
 
 //****************************************************************************80
-void Terrain::SetXZCenter(const std::array<float,2>& xz_center) {
-  bool changed = false;
-  // Determine where the new center tile is located
-  std::array<int,2> ij_center, ij_center_old;
-  ij_center[0] = (int)std::ceil(xz_center[0] - xz_center0_[0]) / ltile_;
-  ij_center[1] = (int)std::ceil(xz_center[1] - xz_center0_[1]) / ltile_;
-  ij_center_old[0] = (tile_bounding_box_[2] + tile_bounding_box_[0]) / 2;
-  ij_center_old[1] = (tile_bounding_box_[3] + tile_bounding_box_[1]) / 2;
-  
-  // Remove the tiles that are no longer visible
-  int half_ntile = (ntile_ - 1) / 2;
-  for (int i = tile_bounding_box_[0]; i <= tile_bounding_box_[2]; ++i) {
-    for (int j = tile_bounding_box_[1]; j <= tile_bounding_box_[3]; ++j) {
-      if (i < ij_center[0] - half_ntile || i > ij_center[0] + half_ntile || 
-          j < ij_center[1] - half_ntile || j > ij_center[1] + half_ntile) {
-        changed = true;
-        tiles_.erase(ntile_*j + i);
-      }
-    }
-  }
-  
-  // Update the bounding box 
-  tile_bounding_box_ = {{ij_center[0] - half_ntile, ij_center[1] - half_ntile, 
-    ij_center[0] + half_ntile, ij_center[1] + half_ntile}};
-
-  // Create new tiles and update the connectivity
-  for (int i = tile_bounding_box_[0]; i <= tile_bounding_box_[2]; ++i) {
-    for (int j = tile_bounding_box_[1]; j <= tile_bounding_box_[3]; ++j) {
-      int ix = ntile_*j + i;
-      if (tiles_.find(ix) == tiles_.end()) {
-        tiles_.emplace(std::piecewise_construct,
-                       std::forward_as_tuple(ix),
-                       std::forward_as_tuple(shader_, 
-                         xz_center0_[0] + ltile_*(i - 0.5), 
-                         xz_center0_[1] + ltile_*(j - 0.5)));
-      }
-    }
-  } 
-  if (changed) {
-    UpdateTileConnectivity();
-  }
+Terrain::~Terrain() {
+  TerrainTile::DeleteSharedObjects();
+  glDeleteTextures(1, &height_map_);
+  glDeleteTextures(1, &tile_data_);
 }
 
 //****************************************************************************80
 void Terrain::Draw(Camera const& camera, const Sky& sky, 
-    const ShadowCascadeRenderer* pshadow_renderer, const Shader* shader) {
+    const ShadowCascadeRenderer* pshadow_renderer, const Shader* shader,
+    const glm::mat4* proj_view) {
+  glm::mat4 pv = proj_view ? *proj_view : 
+    camera.GetProjectionMatrix() * camera.GetViewMatrix();
+  const Shader& tile_shader = shader ? *depth_shader_ : *shader_;
+  const std::array<GLuint,2>& screen_size = camera.GetScreenSize();
+  float lod_scale = screen_size[1] / 
+    (2.0f * std::tan(glm::radians(camera.GetZoom()) / 2.0f)) / 
+    pixel_tolerance_;
+  glm::vec3 camera_pos = GetLocalPosition(camera.GetPosition());
   if (!shader) {
-    // Send data to the shaders
+    // Select the LoD of every tile with the main camera and bake tile 
+    // albedo once per frame, then send data to the shaders. The depth 
+    // passes draw the LoD uploaded here, one frame old for those drawn 
+    // before the main pass
+    for (auto& t : tiles_) {
+      t->UpdateLoD(camera_pos, lod_scale);
+    }
+    UpdateAlbedo(camera, lod_scale);
+    UpdateTileData();
     SetShaderData(camera, sky, *pshadow_renderer);
+    albedo_->SetShaderData(*shader_, albedo_unit_);
   }
   else {
-    shader->Use();
+    // Positions come from the height map, so draw depth with our own shader
+    depth_shader_->Use();
     glm::mat4 model = GetModelMatrix(camera);
-    glUniformMatrix4fv(glGetUniformLocation(shader->GetProgram(), "model"), 1, 
-        GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(glGetUniformLocation(depth_shader_->GetProgram(), 
+          "model"), 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(glGetUniformLocation(depth_shader_->GetProgram(),
+          "projection_view"), 1, GL_FALSE, glm::value_ptr(pv));
   }
-  
-  // Loop over tiles and update LoD
-  for (auto& t : tiles_) {
-    t.second.UpdateLoD(camera.GetPosition());
+  SetHeightMapData(tile_shader);
+
+  // Cull against the frustum of this pass, which is relative to the camera 
+  // position. The main pass also culls beyond the depth where the fog 
+  // becomes opaque, depth passes keep tiles past it that can cast shadows
+  BoundingFrustum frustum(glm::mat4(), pv);
+  glm::vec4 fog_plane(-camera.GetFront(), sky.GetFogOpaqueDistance());
+  if (shader) {
+    fog_plane = glm::vec4(0.0f, 0.0f, 0.0f, 
+        std::numeric_limits<float>::max());
   }
+  quadtree_.GetVisibleTiles(frustum, fog_plane, camera_pos, visible_tiles_);
 
-  // Loop over tiles and draw
-  for (auto& t : tiles_) {
-    t.second.Draw();
+  // Draw all visible tiles in a single call
+  std::size_t num_visible = visible_tiles_.size();
+  draw_counts_.resize(num_visible);
+  draw_indices_.resize(num_visible);
+  draw_base_vertices_.resize(num_visible);
+  for (std::size_t i = 0; i < num_visible; ++i) {
+    visible_tiles_[i]->GetDrawCommand(draw_counts_[i], draw_indices_[i], 
+        draw_base_vertices_[i]);
   }
+  TerrainTile::MultiDraw(draw_counts_, draw_indices_, draw_base_vertices_);
+  glActiveTexture(GL_TEXTURE0 + height_map_unit_);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0 + tile_data_unit_);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0 + albedo_unit_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  glActiveTexture(GL_TEXTURE0);
 }
 
 //****************************************************************************80
-float Terrain::GetHeight(float x, float z) {
-  const float height_scale = 100.0f;
-  const float horiz_scale = 0.003f;
-  // TODO
-  // return 0.0;
-  return height_scale * 
-    perlin_generator_.GetValue(x*horiz_scale, z*horiz_scale, 0.5);
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+void Terrain::OnTileRelocated(TerrainTile& tile) {
+  // Keep the ground drawn while the worker runs, coarsely
+  tile.UploadPlaceholder(height_map_);
 }
 
 //****************************************************************************80
-float Terrain::GetBoundingHeight(float x, float z) const {
-  // Determine which tile we're in
-  int i = (int)((x - xz_center0_[0] + 0.5*ltile_) / ltile_);
-  int j = (int)((z - xz_center0_[1] + 0.5*ltile_) / ltile_);
-  int ix = ntile_*j + i;
-  return tiles_.at(ix).GetBoundingHeight();
+void Terrain::OnTileLoaded(TerrainTile& tile) {
+  tile.UploadTexels(height_map_);
 }
 
 //****************************************************************************80
-glm::vec3 Terrain::GetNormal(float x, float z) {
-  float eps = 1.0e-1f;
-  float h0 = Terrain::GetHeight(x,z);
-  return glm::normalize(glm::vec3(
-        (h0 - Terrain::GetHeight(x+eps,z)) / eps,
-        1.0f,
-        (h0 - Terrain::GetHeight(x,z+eps)) / eps));
+void Terrain::OnRingChanged(bool moved) {
+  UpdateQuadtree();
+  if (moved) {
+    UpdateTileData();
+  }
 }
 
-//****************************************************************************80
-// PRIVATE FUNCTIONS
 //****************************************************************************80
 void Terrain::LoadTextures() {
   // TODO give better path...
@@ -180,121 +198,222 @@ void Terrain::LoadTextures() {
   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+//****************************************************************************80
+void Terrain::SetHeightMapData(const Shader& shader) const {
+  glActiveTexture(GL_TEXTURE0 + height_map_unit_);
+  glBindTexture(GL_TEXTURE_2D, height_map_);
+  glUniform1i(glGetUniformLocation(shader.GetProgram(), "heightMap"), 
+      height_map_unit_);
+  glActiveTexture(GL_TEXTURE0 + tile_data_unit_);
+  glBindTexture(GL_TEXTURE_2D, tile_data_);
+  glUniform1i(glGetUniformLocation(shader.GetProgram(), "tileData"), 
+      tile_data_unit_);
+  glUniform1f(glGetUniformLocation(shader.GetProgram(), "gridSpacing"), 
+      TerrainTile::GetGridSpacing());
+  glUniform1i(glGetUniformLocation(shader.GetProgram(), "gridSize"), 
+      TerrainTile::GetNumVertices());
+  glUniform1i(glGetUniformLocation(shader.GetProgram(), "ringSize"), ntile_);
+  glActiveTexture(GL_TEXTURE0);
+}
+
 //****************************************************************************80
 void Terrain::SetShaderData(Camera const& camera, const Sky& sky, 
     const ShadowCascadeRenderer& shadow_renderer) {
   // Activate shader
-  shader_.Use();
+  shader_->Use();
   // Set model/view/projection uniforms  
   glm::mat4 model = GetModelMatrix(camera);
-  glUniformMatrix4fv(glGetUniformLocation(shader_.GetProgram(), "model"), 1, 
+  glUniformMatrix4fv(glGetUniformLocation(shader_->GetProgram(), "model"), 1, 
       GL_FALSE, glm::value_ptr(model));
-  glUniformMatrix4fv(glGetUniformLocation(shader_.GetProgram(), "view"), 1, 
+  glUniformMatrix4fv(glGetUniformLocation(shader_->GetProgram(), "view"), 1, 
       GL_FALSE, glm::value_ptr(camera.GetViewMatrix()));
-  glUniformMatrix4fv(glGetUniformLocation(shader_.GetProgram(), "projection"),
+  glUniformMatrix4fv(glGetUniformLocation(shader_->GetProgram(), "projection"),
       1, GL_FALSE, glm::value_ptr(camera.GetProjectionMatrix()));
 
   // Set material uniforms
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), 
         "material.specular"), 1.0f, 1.0f, 1.0f);
-  glUniform1f(glGetUniformLocation(shader_.GetProgram(), 
+  glUniform1f(glGetUniformLocation(shader_->GetProgram(), 
         "material.shiny"), 0.01f);
 
   // Set lighting uniforms
   const glm::vec3& sun_dir = sky.GetSunDirection();
   const glm::vec3& sun_color = sky.GetSunColor();
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "light.direction"),
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "light.direction"),
       sun_dir.x, sun_dir.y, sun_dir.z);
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "light.ambient"), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "light.ambient"), 
       0.7*sun_color.x, 0.7*sun_color.y, 0.7*sun_color.z);
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "light.diffuse"), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "light.diffuse"), 
       0.7*sun_color.x, 0.7*sun_color.y, 0.7*sun_color.z);
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "light.specular"), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "light.specular"), 
       0.7*sun_color.x, 0.7*sun_color.y, 0.7*sun_color.z);
 
   // Set fog uniforms
   const glm::vec3& fog_color = sky.GetFogColor();
   const std::array<float,2>& fog_start_end = sky.GetFogStartEnd();
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "fog.Color"),
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "fog.Color"),
       fog_color.x, fog_color.y, fog_color.z);
-  glUniform1f(glGetUniformLocation(shader_.GetProgram(), "fog.Start"), 
+  glUniform1f(glGetUniformLocation(shader_->GetProgram(), "fog.Start"), 
       fog_start_end[0]);
-  glUniform1f(glGetUniformLocation(shader_.GetProgram(), "fog.End"), 
+  glUniform1f(glGetUniformLocation(shader_->GetProgram(), "fog.End"), 
       fog_start_end[1]);
-  glUniform1f(glGetUniformLocation(shader_.GetProgram(), "fog.Density"), 
+  glUniform1f(glGetUniformLocation(shader_->GetProgram(), "fog.Density"), 
       sky.GetFogDensity());
-  glUniform1i(glGetUniformLocation(shader_.GetProgram(), "fog.Equation"), 
+  glUniform1i(glGetUniformLocation(shader_->GetProgram(), "fog.Equation"), 
       sky.GetFogEquation());
   
   // Set the camera position uniform
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "viewPos"), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "viewPos"), 
       0.0f, 0.0f, 0.0f);
     
   // Bind the texture data
   /*
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, textures_[0]);
-  glUniform1i(glGetUniformLocation(shader_.GetProgram(), "grassTexture0"), 0);
+  glUniform1i(glGetUniformLocation(shader_->GetProgram(), "grassTexture0"), 0);
   glActiveTexture(GL_TEXTURE1);
   glBindTexture(GL_TEXTURE_2D, textures_[1]);
-  glUniform1i(glGetUniformLocation(shader_.GetProgram(), "grassTexture1"), 1);
+  glUniform1i(glGetUniformLocation(shader_->GetProgram(), "grassTexture1"), 1);
   glActiveTexture(GL_TEXTURE2);
   glBindTexture(GL_TEXTURE_2D, textures_[2]);
-  glUniform1i(glGetUniformLocation(shader_.GetProgram(), "grassTexture2"), 2);
+  glUniform1i(glGetUniformLocation(shader_->GetProgram(), "grassTexture2"), 2);
   */
   
   // Set the shadow data
-  glUniform1i(glGetUniformLocation(shader_.GetProgram(), "num_cascades"), 
+  glUniform1i(glGetUniformLocation(shader_->GetProgram(), "num_cascades"), 
       shadow_renderer.GetNumCascades());
   for (int i = 0; i < shadow_renderer.GetNumCascades(); ++i) { 
     // Send the depth maps
     glActiveTexture(GL_TEXTURE3 + i);
     glBindTexture(GL_TEXTURE_2D, shadow_renderer.GetDepthMap(i));
     std::string tmp = "depthMap[" + std::to_string(i) + "]";
-    glUniform1i(glGetUniformLocation(shader_.GetProgram(), tmp.c_str()), 3 + i);
+    glUniform1i(glGetUniformLocation(shader_->GetProgram(), tmp.c_str()), 
+        3 + i);
     // Send the subfrusta end points
     tmp = "subfrusta_extents[" + std::to_string(i) + "]";
-    glUniform1f(glGetUniformLocation(shader_.GetProgram(), tmp.c_str()), 
+    glUniform1f(glGetUniformLocation(shader_->GetProgram(), tmp.c_str()), 
         shadow_renderer.GetSubfrustaExtent(i));
     // Send the light space matrices
     tmp = "lightSpaceMatrix[" + std::to_string(i) + "]";
-    glUniformMatrix4fv(glGetUniformLocation(shader_.GetProgram(), tmp.c_str()), 
-        1, GL_FALSE, glm::value_ptr(shadow_renderer.GetLightSpaceMatrix(i)));
+    glUniformMatrix4fv(glGetUniformLocation(shader_->GetProgram(), 
+          tmp.c_str()), 1, GL_FALSE, 
+        glm::value_ptr(shadow_renderer.GetLightSpaceMatrix(i)));
     // Send the shadow biases
     tmp = "shadow_bias[" + std::to_string(i) + "]";
-    glUniform1f(glGetUniformLocation(shader_.GetProgram(), tmp.c_str()), 
+    glUniform1f(glGetUniformLocation(shader_->GetProgram(), tmp.c_str()), 
         shadow_renderer.GetShadowBias(i));
   }
   glm::vec3 camera_front = camera.GetFront();
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "cameraFront"), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "cameraFront"), 
       camera_front.x, camera_front.y, camera_front.z);
   glm::vec3 frustum_origin = camera.GetFrustumOrigin();
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "frustumOrigin"), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "frustumOrigin"), 
       frustum_origin.x, frustum_origin.y, frustum_origin.z);
   glm::vec3 frustum_terminus = camera.GetFrustumTerminus();
-  glUniform3f(glGetUniformLocation(shader_.GetProgram(), "frustumTerminus"), 
+  glUniform3f(glGetUniformLocation(shader_->GetProgram(), "frustumTerminus"), 
       frustum_terminus.x, frustum_terminus.y, frustum_terminus.z);
 }
 
 //****************************************************************************80
-void Terrain::UpdateTileConnectivity() {
-  for (int i = tile_bounding_box_[0]; i <= tile_bounding_box_[2]; ++i) {
-    for (int j = tile_bounding_box_[1]; j <= tile_bounding_box_[3]; ++j) {
-      int ix = ntile_*j + i;
-      if (i > tile_bounding_box_[0]) {
-        tiles_.at(ix).SetNeighborPointer(&tiles_.at(ntile_*j + i - 1), 3);
-      }
-      if (i < tile_bounding_box_[2]) {
-        tiles_.at(ix).SetNeighborPointer(&tiles_.at(ntile_*j + i + 1), 1);
-      }
-      if (j > tile_bounding_box_[1]) {
-        tiles_.at(ix).SetNeighborPointer(&tiles_.at(ntile_*(j-1) + i), 2);
-      }
-      if (j < tile_bounding_box_[3]) {
-        tiles_.at(ix).SetNeighborPointer(&tiles_.at(ntile_*(j+1) + i), 0);
+void Terrain::UpdateTileData() {
+  std::array<GLfloat,4> edge_lods, edge_morphs;
+  for (std::size_t slot = 0; slot < tiles_.size(); ++slot) {
+    const TerrainTile& tile = *tiles_[slot];
+    glm::vec3 origin = tile.GetAABBMinimum();
+    glm::vec3 extent = tile.GetAABBMaximum() - origin;
+    GLfloat* data = &tile_data_staging_[4 * tile_data_texels_ * slot];
+    data[0] = origin[0];
+    data[1] = origin[2];
+    data[2] = tile.GetLoD();
+    data[3] = tile.GetMorph();
+    data[4] = origin[1];
+    data[5] = extent[1];
+    data[6] = albedo_->GetLevel(slot);
+    tile.GetEdgeLoDs(edge_lods, edge_morphs);
+    std::copy(edge_lods.begin(), edge_lods.end(), data + 8);
+    std::copy(edge_morphs.begin(), edge_morphs.end(), data + 12);
+  }
+  glBindTexture(GL_TEXTURE_2D, tile_data_);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tile_data_texels_ * ntile_, ntile_,
+      GL_RGBA, GL_FLOAT, tile_data_staging_.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+//****************************************************************************80
+void Terrain::UpdateAlbedo(const Camera& camera, float lod_scale) {
+  // A pixel at distance d covers d/(lod_scale*tolerance) on the ground
+  glm::vec3 camera_pos = GetLocalPosition(camera.GetPosition());
+  float pixel_scale = 1.0f / (lod_scale * pixel_tolerance_);
+  albedo_refines_.clear();
+  bool baking = false;
+  GLint framebuffer;
+  GLint viewport[4];
+  GLboolean blend, depth_test;
+  auto bake = [&](int slot, float x0, float z0, int level) {
+    if (!baking) {
+      // Bakes render to the albedo map, save the state of the frame
+      baking = true;
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      blend = glIsEnabled(GL_BLEND);
+      depth_test = glIsEnabled(GL_DEPTH_TEST);
+      glDisable(GL_BLEND);
+      glDisable(GL_DEPTH_TEST);
+    }
+    albedo_->Bake(slot, x0, z0, level);
+  };
+  for (std::size_t slot = 0; slot < tiles_.size(); ++slot) {
+    const TerrainTile& tile = *tiles_[slot];
+    glm::vec3 closest = glm::clamp(camera_pos, tile.GetAABBMinimum(), 
+        tile.GetAABBMaximum());
+    float distance = glm::length(camera_pos - closest);
+    int level = albedo_->GetLevelForFootprint(distance * pixel_scale);
+    // Albedo is baked from world locations
+    std::array<double,2> corner = tile.GetCorner();
+    if (!albedo_->NeedsBake(slot, corner[0], corner[1], level)) continue;
+    if (albedo_->HoldsTile(slot, corner[0], corner[1])) {
+      albedo_refines_.push_back({distance, (int)slot, level});
+    }
+    else {
+      // The slot holds the albedo of the tile it left, bake it now
+      bake(slot, corner[0], corner[1], level);
+    }
+  }
+
+  // Refine the nearest tiles first
+  std::size_t num_refines = std::min<std::size_t>(albedo_refines_.size(), 
+      max_albedo_refines_);
+  std::partial_sort(albedo_refines_.begin(), albedo_refines_.begin() + 
+      num_refines, albedo_refines_.end(), 
+      [](const AlbedoRefine& a, const AlbedoRefine& b) { 
+        return a.distance < b.distance; });
+  for (std::size_t i = 0; i < num_refines; ++i) {
+    const AlbedoRefine& r = albedo_refines_[i];
+    std::array<double,2> corner = tiles_[r.slot]->GetCorner();
+    bake(r.slot, corner[0], corner[1], r.level);
+  }
+
+  if (baking) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (blend) glEnable(GL_BLEND);
+    if (depth_test) glEnable(GL_DEPTH_TEST);
+  }
+}
+
+//****************************************************************************80
+void Terrain::UpdateQuadtree() {
+  std::vector<TerrainTile*> tiles(ntile_*ntile_, nullptr);
+  for (int j = 0; j < ntile_; ++j) {
+    for (int i = 0; i < ntile_; ++i) {
+      TerrainTile* tile = tiles_[GetSlot(i + tile_bounding_box_[0], 
+          j + tile_bounding_box_[1])].get();
+      if (tile->IsDrawable()) {
+        tiles[ntile_*j + i] = tile;
       }
     }
   }
+  quadtree_.Build(tiles, ntile_, ntile_);
 }
 
 } // End namespace TopFun
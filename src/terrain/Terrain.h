@@ -3,75 +3,127 @@
 
 #include <vector>
 #include <array>
-#include <unordered_map>
+#include <string>
+#include <memory>
 
 #include <glm/glm.hpp>
 
-#include "module/perlin.h"
-
 #include "shaders/Shader.h"
 #include "render/Camera.h"
+#include "terrain/TerrainCore.h"
 #include "terrain/TerrainTile.h"
+#include "terrain/HeightSource.h"
+#include "terrain/TerrainQuadtree.h"
+#include "terrain/TerrainAlbedo.h"
 
 namespace TopFun {
 
 class ShadowCascadeRenderer;
 class Sky;
 
-class Terrain {
+class Terrain : public TerrainCore {
  
  public:
   //**************************************************************************80
   //! \brief Terrain - Constructor for empty terrain object
   //! \param[in] l - length of terrain in the x/z directions
   //! \param[in] ntile - number of terrain tiles in the x/z directions
-  //! \param[in] xz_center0 - starting location of center of rendered terrain
-  //**************************************************************************80
-  Terrain(float l, int ntile, const std::array<float,2>& xz_center0);
+  //! \param[in] xz_center0 - starting world location of center of rendered 
+  //! terrain
+  //! \param[in] tile_cache_directory - directory to cache generated tiles in,
+  //! empty to always generate them
+  //! \param[in] height_source - source of the terrain heights, null for the
+  //! default procedural terrain
+  //**************************************************************************80
+  Terrain(float l, int ntile, const std::array<double,2>& xz_center0,
+      const std::string& tile_cache_directory = "",
+      std::unique_ptr<HeightSource> height_source = nullptr);
   
   //**************************************************************************80
   //! \brief ~Terrain - Destructor
   //**************************************************************************80
-  ~Terrain() = default;
+  virtual ~Terrain();
   
   //**************************************************************************80
-  //! \brief SetXZCenter - Update the location of the center of rendered terrain
-  //! \param[in] xz_center - new location of center of rendered terrain
+  //! \brief SetPixelTolerance - Set the maximum screen-space geometric error
+  //! used to pick the tile levels of detail
+  //! \param[in] pixel_tolerance - tolerance in pixels
   //**************************************************************************80
-  void SetXZCenter(const std::array<float,2>& xz_center); 
+  inline void SetPixelTolerance(float pixel_tolerance) {
+    pixel_tolerance_ = pixel_tolerance;
+  }
+  
+  //**************************************************************************80
+  //! \brief GetPixelTolerance - Get the maximum screen-space geometric error
+  //**************************************************************************80
+  inline float GetPixelTolerance() const { return pixel_tolerance_; }
 
   //**************************************************************************80
-  //! \brief GetHeight - Get the terrain height at a some (x,z) location
+  //! \brief Draw - draws the tiles that are inside the view frustum and not
+  //! hidden by fog
+  //! \param[in] camera - reference to the camera
+  //! \param[in] sky - reference to the sky
+  //! \param[in] pshadow_renderer - shadow renderer (main pass only)
+  //! \param[in] shader - depth shader of the pass, NULL for the main pass. The
+  //! terrain draws depth with its own shader, which reads the height map
+  //! \param[in] proj_view - projection-view matrix of this pass (relative to 
+  //! the camera position), NULL to use the camera's
   //**************************************************************************80
-  static float GetHeight(float x, float z);
+  void Draw(const Camera& camera, const Sky& sky, 
+      const ShadowCascadeRenderer* pshadow_renderer, const Shader* shader=NULL,
+      const glm::mat4* proj_view=NULL);
 
+ private:
+  std::unique_ptr<Shader> shader_;
+  std::unique_ptr<Shader> depth_shader_; // for shadow and cloud depth passes
+  // Quantized height and normal of every tile vertex. Slot (si,sj) owns the
+  // block of texels starting at (si,sj)*TerrainTile::GetNumVertices()
+  GLuint height_map_;
+  // Per slot: x/z location of the tile corner relative to the origin, LoD, 
+  // morph factor, the height range the height map is quantized to, and the 
+  // LoD and morph factor of each edge (N, E, S, W)
+  GLuint tile_data_;
+  static const int tile_data_texels_ = 4; // RGBA texels per slot
+  std::vector<GLfloat> tile_data_staging_; // CPU copy of tile_data_
+  // Baked grass/dirt texture of each slot
+  std::unique_ptr<TerrainAlbedo> albedo_;
+  // A slot whose tile needs more albedo detail
+  struct AlbedoRefine {
+    float distance; // from the camera to the tile
+    int slot;
+    int level; // finest mip level needed
+  };
+  static const int max_albedo_refines_ = 4; // per frame, nearest tiles first
+  std::vector<AlbedoRefine> albedo_refines_;
+  // Texture units, after the shadow depth maps
+  static const GLint height_map_unit_ = 13;
+  static const GLint tile_data_unit_ = 14;
+  static const GLint albedo_unit_ = 15;
+  float pixel_tolerance_; // maximum projected geometric error
+  TerrainQuadtree quadtree_; // over the drawable tiles, for culling
+  std::vector<TerrainTile*> visible_tiles_; // tiles drawn in the current pass
+  // Multi-draw arguments of the visible tiles
+  std::vector<GLsizei> draw_counts_;
+  std::vector<GLvoid*> draw_indices_;
+  std::vector<GLint> draw_base_vertices_;
+  std::vector<GLuint> textures_;
+  
   //**************************************************************************80
-  //! \brief GetBoundingHeight - Get the maximum height in the tile containing
-  //! some (x,z) location
+  //! \brief OnTileRelocated - uploads the placeholder of a relocated tile
   //**************************************************************************80
-  float GetBoundingHeight(float x, float z) const;
+  virtual void OnTileRelocated(TerrainTile& tile);
 
   //**************************************************************************80
-  //! \brief GetNormal - Get the surface normal at some (x,z) location
+  //! \brief OnTileLoaded - uploads the texels of a loaded tile
   //**************************************************************************80
-  static glm::vec3 GetNormal(float x, float z);
+  virtual void OnTileLoaded(TerrainTile& tile);
 
   //**************************************************************************80
-  //! \brief Draw - draws the terrain
+  //! \brief OnRingChanged - rebuilds the quadtree, and uploads the new tile 
+  //! origins before the depth passes of the next frame if the ring moved
   //**************************************************************************80
-  void Draw(const Camera& camera, const Sky& sky, 
-      const ShadowCascadeRenderer* pshadow_renderer, const Shader* shader=NULL);
+  virtual void OnRingChanged(bool moved);
 
- private:
-  Shader shader_;
-  int ntile_;
-  float ltile_;
-  std::array<float,2> xz_center0_; // center of terrain
-  std::array<int,4> tile_bounding_box_; // bounding box in tile coordinates
-  static noise::module::Perlin perlin_generator_;
-  std::unordered_map<int,TerrainTile> tiles_;
-  std::vector<GLuint> textures_;
-  
   //**************************************************************************80
   //! \brief LoadTextures - load the terrain textures
   //**************************************************************************80
@@ -84,17 +136,40 @@ class Terrain {
       const ShadowCascadeRenderer& shadow_renderer);
   
   //**************************************************************************80
-  //! \brief GetModelMatrix - get the model matrix for the terrain
+  //! \brief SetHeightMapData - binds the height map and tile origins and
+  //! sends the grid uniforms required by the terrain vertex shader
+  //! \param[in] shader - shader about to draw the tiles
+  //**************************************************************************80
+  void SetHeightMapData(const Shader& shader) const;
+  
+  //**************************************************************************80
+  //! \brief GetModelMatrix - get the model matrix for the terrain, which
+  //! takes positions relative to the origin to relative to the camera
   //! \param[in] camera - reference to the camera
   //**************************************************************************80
   inline glm::mat4 GetModelMatrix(const Camera& camera) const {
-    return glm::translate(glm::mat4(), (glm::vec3)-camera.GetPosition());
+    return glm::translate(glm::mat4(), -GetLocalPosition(camera.GetPosition()));
   }
 
   //**************************************************************************80
-  //! \brief UpdateTileConnectivity - update tile neighbor pointers
+  //! \brief UpdateTileData - upload the corner location, LoD and morph factor
+  //! of each slot's tile, once per frame and when the ring moves
+  //**************************************************************************80
+  void UpdateTileData();
+
+  //**************************************************************************80
+  //! \brief UpdateAlbedo - bake the albedo of tiles that moved or need more
+  //! detail. Tiles that moved are baked at once, refinements are limited
+  //! per frame
+  //! \param[in] camera - reference to the camera
+  //! \param[in] lod_scale - distance over the size of a pixel on the ground
+  //**************************************************************************80
+  void UpdateAlbedo(const Camera& camera, float lod_scale);
+
+  //**************************************************************************80
+  //! \brief UpdateQuadtree - rebuild the culling quadtree over drawable tiles
   //**************************************************************************80
-  void UpdateTileConnectivity();
+  void UpdateQuadtree();
 
 };
 } // End namespace TopFun
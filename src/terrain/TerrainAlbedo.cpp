@@ -0,0 +1,99 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "terrain/TerrainAlbedo.h"
+
+namespace TopFun {
+
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+TerrainAlbedo::TerrainAlbedo(int num_slots, GLfloat l_tile) :
+  shader_("shaders/terrain_albedo.vs", "shaders/terrain_albedo.fs"),
+  l_tile_(l_tile), layers_(num_slots, Layer{0.0f, 0.0f, num_levels_}) {
+  GLint max_layers;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  if (num_slots > max_layers) {
+    std::string message = "Number of tiles exceeds the albedo map layers\n";
+    throw std::invalid_argument(message);
+  }
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+  for (int level = 0; level < num_levels_; ++level) {
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size_ >> level, 
+        size_ >> level, num_slots, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  }
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, 
+      GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, num_levels_ - 1);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  glGenFramebuffers(1, &FBO_);
+  glGenVertexArrays(1, &VAO_);
+}
+
+//****************************************************************************80
+TerrainAlbedo::~TerrainAlbedo() {
+  glDeleteVertexArrays(1, &VAO_);
+  glDeleteFramebuffers(1, &FBO_);
+  glDeleteTextures(1, &texture_);
+}
+
+//****************************************************************************80
+bool TerrainAlbedo::NeedsBake(int slot, GLfloat x0, GLfloat z0, 
+    int level) const {
+  return !HoldsTile(slot, x0, z0) || level < layers_[slot].level;
+}
+
+//****************************************************************************80
+void TerrainAlbedo::Bake(int slot, GLfloat x0, GLfloat z0, int level) {
+  Layer& layer = layers_[slot];
+  // A new tile needs every level, an old one only the missing finer ones
+  int level_end = HoldsTile(slot, x0, z0) ? layer.level : num_levels_;
+  level = std::min(level, level_end);
+  
+  shader_.Use();
+  glUniform2f(glGetUniformLocation(shader_.GetProgram(), "tileOrigin"), x0,
+      z0);
+  glUniform1f(glGetUniformLocation(shader_.GetProgram(), "tileLength"), 
+      l_tile_);
+  glUniform1f(glGetUniformLocation(shader_.GetProgram(), "baseSize"), size_);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
+  glBindVertexArray(VAO_);
+  for (int l = level; l < level_end; ++l) {
+    GLsizei size = size_ >> l;
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_,
+        l, slot);
+    glViewport(0, 0, size, size);
+    glUniform1f(glGetUniformLocation(shader_.GetProgram(), "levelSize"), 
+        size);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+  glBindVertexArray(0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  layer.x0 = x0;
+  layer.z0 = z0;
+  layer.level = level;
+}
+
+//****************************************************************************80
+int TerrainAlbedo::GetLevelForFootprint(GLfloat footprint) const {
+  GLfloat texels = footprint * (size_ - 1) / l_tile_;
+  int level = texels > 1.0f ? (int)std::floor(std::log2(texels)) : 0;
+  return std::min(level, num_levels_ - 1);
+}
+
+//****************************************************************************80
+void TerrainAlbedo::SetShaderData(const Shader& shader, GLint unit) const {
+  glActiveTexture(GL_TEXTURE0 + unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+  glUniform1i(glGetUniformLocation(shader.GetProgram(), "albedoMap"), unit);
+  glUniform1f(glGetUniformLocation(shader.GetProgram(), "albedoSize"), size_);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+} // End namespace TopFun
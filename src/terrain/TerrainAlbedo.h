@@ -0,0 +1,107 @@
+#ifndef TERRAINALBEDO_H
+#define TERRAINALBEDO_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "shaders/Shader.h"
+
+// Grass/dirt albedo of the terrain tiles, baked on the GPU into one layer of
+// a mipmapped texture array per ring slot. Each level of a layer is rendered
+// straight from the procedural noise, filtered to its texel size, so baking 
+// one layer never touches the others. A layer is baked down to the finest 
+// level its tile needs, refined when the tile needs more detail and rebaked
+// when the slot is reused for another tile.
+
+namespace TopFun {
+
+class TerrainAlbedo {
+
+ public:
+  //**************************************************************************80
+  //! \brief TerrainAlbedo - Constructor, allocates the texture array
+  //! \param[in] num_slots - number of tile slots (texture layers)
+  //! \param[in] l_tile - length of the tile edge
+  //**************************************************************************80
+  TerrainAlbedo(int num_slots, GLfloat l_tile);
+  
+  //**************************************************************************80
+  //! \brief ~TerrainAlbedo - Destructor
+  //**************************************************************************80
+  ~TerrainAlbedo();
+
+  TerrainAlbedo(const TerrainAlbedo&) = delete;
+  TerrainAlbedo& operator=(const TerrainAlbedo&) = delete;
+
+  //**************************************************************************80
+  //! \brief NeedsBake - check if a slot must be baked to give a tile the 
+  //! requested detail
+  //! \param[in] slot - slot index
+  //! \param[in] x0 - x coordinate of the tile corner
+  //! \param[in] z0 - z coordinate of the tile corner
+  //! \param[in] level - finest mip level the tile needs
+  //**************************************************************************80
+  bool NeedsBake(int slot, GLfloat x0, GLfloat z0, int level) const;
+
+  //**************************************************************************80
+  //! \brief HoldsTile - check if a slot has been baked for a tile, at any
+  //! level
+  //! \param[in] slot - slot index
+  //! \param[in] x0 - x coordinate of the tile corner
+  //! \param[in] z0 - z coordinate of the tile corner
+  //**************************************************************************80
+  inline bool HoldsTile(int slot, GLfloat x0, GLfloat z0) const {
+    const Layer& layer = layers_[slot];
+    return layer.level < num_levels_ && layer.x0 == x0 && layer.z0 == z0;
+  }
+
+  //**************************************************************************80
+  //! \brief Bake - bake the levels of a slot that NeedsBake asks for. Changes
+  //! the bound framebuffer and viewport, which the caller restores
+  //**************************************************************************80
+  void Bake(int slot, GLfloat x0, GLfloat z0, int level);
+
+  //**************************************************************************80
+  //! \brief GetLevel - finest baked mip level of a slot
+  //**************************************************************************80
+  inline int GetLevel(int slot) const { return layers_[slot].level; }
+
+  //**************************************************************************80
+  //! \brief GetLevelForFootprint - finest mip level worth baking for a tile 
+  //! whose pixels cover some distance on the ground
+  //! \param[in] footprint - ground distance covered by one pixel
+  //**************************************************************************80
+  int GetLevelForFootprint(GLfloat footprint) const;
+
+  //**************************************************************************80
+  //! \brief SetShaderData - binds the albedo map and sends its uniforms
+  //! \param[in] shader - shader about to draw the tiles
+  //! \param[in] unit - texture unit to bind the map to
+  //**************************************************************************80
+  void SetShaderData(const Shader& shader, GLint unit) const;
+
+  //**************************************************************************80
+  //! \brief GetSize - texels along a side of the finest level
+  //**************************************************************************80
+  static inline GLsizei GetSize() { return size_; }
+
+ private:
+  // What a slot's layer holds
+  struct Layer {
+    GLfloat x0, z0; // tile corner
+    int level; // finest baked level, num_levels_ if never baked
+  };
+  static const GLsizei size_ = 256;
+  static const int num_levels_ = 9; // down to 1x1
+  Shader shader_;
+  GLuint texture_;
+  GLuint FBO_;
+  GLuint VAO_; // empty, the bake shader needs no attributes
+  GLfloat l_tile_;
+  std::vector<Layer> layers_;
+
+};
+} // End namespace TopFun
+
+#endif
@@ -0,0 +1,381 @@
+#include <limits>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "terrain/TerrainCore.h"
+#include "terrain/NoiseHeightSource.h"
+
+namespace TopFun {
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+TerrainCore::TerrainCore(float l, int ntile, 
+    const std::array<double,2>& xz_center0, 
+    const std::string& tile_cache_directory, 
+    std::unique_ptr<HeightSource> height_source) :
+  TerrainCore(l, ntile, xz_center0, tile_cache_directory, 
+      std::move(height_source), false) {}
+
+//****************************************************************************80
+TerrainCore::~TerrainCore() {
+  TerrainTile::SetHeightSource(nullptr);
+  TerrainTile::SetTileCache(nullptr);
+}
+
+//****************************************************************************80
+void TerrainCore::SetXZCenter(const std::array<double,2>& xz_center, 
+    bool wait) {
+  // Determine where the new center tile is located
+  std::array<int,2> ij_center = GetTileIndex(xz_center[0], xz_center[1]);
+  std::array<int,4> box_old = tile_bounding_box_;
+  int half_ntile = (ntile_ - 1) / 2;
+  tile_bounding_box_ = {{ij_center[0] - half_ntile, ij_center[1] - half_ntile, 
+    ij_center[0] + half_ntile, ij_center[1] + half_ntile}};
+  bool moved = (tile_bounding_box_ != box_old);
+  bool changed = moved;
+
+  // Relocate the slots of tiles that left the ring to the tiles that 
+  // entered, nearest the center first
+  if (moved) {
+    for (const std::array<int,2>& ij : GetTilesNearestFirst(
+          tile_bounding_box_, ij_center, &box_old)) {
+      std::array<double,2> corner = GetTileCorner(ij[0], ij[1]);
+      TerrainTile& tile = *tiles_[GetSlot(ij[0], ij[1])];
+      tile.Relocate(corner[0], corner[1], thread_pool_);
+      OnTileRelocated(tile);
+    }
+    UpdateTileConnectivity();
+    // Rebase on the new center tile
+    SetOrigin(ij_center);
+  }
+
+  // Finish tiles whose vertex data is ready, others are drawn once they are
+  for (auto& t : tiles_) {
+    if (t->FinishLoading(wait)) {
+      changed = true;
+      OnTileLoaded(*t);
+      if (num_startup_tiles_ > 0) {
+        CountStartupLoad(*t);
+      }
+    }
+  }
+  if (changed) {
+    OnRingChanged(moved);
+  }
+}
+
+//****************************************************************************80
+float TerrainCore::GetHeight(double x, double z) const {
+  if (query_mode_ == TerrainQueryMode::interpolated) {
+    const TerrainTile* tile = FindTile(x, z);
+    if (tile) return tile->GetHeight(x - origin_[0], z - origin_[1]);
+  }
+  return GetSourceHeight(x, z);
+}
+
+//****************************************************************************80
+void TerrainCore::GetHeights(const double* x, const double* z, float* out, 
+    std::size_t n) const {
+  if (query_mode_ == TerrainQueryMode::procedural) {
+    GetSourceHeights(x, z, out, n);
+    return;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    out[i] = GetHeight(x[i], z[i]);
+  }
+}
+
+//****************************************************************************80
+float TerrainCore::GetBoundingHeight(double x, double z) const {
+  const TerrainTile* tile = FindTile(x, z);
+  if (tile) return tile->GetBoundingHeight();
+  return std::numeric_limits<float>::max();
+}
+
+//****************************************************************************80
+float TerrainCore::GetBoundingHeight(double x0, double z0, double x1, 
+    double z1) const {
+  // The source varies between the grid vertices, above their maximum
+  if (query_mode_ == TerrainQueryMode::procedural) {
+    return std::numeric_limits<float>::max();
+  }
+  std::array<int,2> ij0 = GetTileIndex(x0, z0);
+  std::array<int,2> ij1 = GetTileIndex(x1, z1);
+  float y_max = std::numeric_limits<float>::lowest();
+  for (int j = ij0[1]; j <= ij1[1]; ++j) {
+    for (int i = ij0[0]; i <= ij1[0]; ++i) {
+      if (i < tile_bounding_box_[0] || i > tile_bounding_box_[2] ||
+          j < tile_bounding_box_[1] || j > tile_bounding_box_[3]) {
+        return std::numeric_limits<float>::max();
+      }
+      const TerrainTile& tile = *tiles_[GetSlot(i, j)];
+      y_max = std::max(y_max, tile.GetMaxHeight(x0 - origin_[0], 
+            z0 - origin_[1], x1 - origin_[0], z1 - origin_[1]));
+    }
+  }
+  return y_max;
+}
+
+//****************************************************************************80
+glm::vec3 TerrainCore::GetNormal(double x, double z) const {
+  if (query_mode_ == TerrainQueryMode::interpolated) {
+    const TerrainTile* tile = FindTile(x, z);
+    if (tile) return tile->GetNormal(x - origin_[0], z - origin_[1]);
+  }
+  return GetSourceNormal(x, z);
+}
+
+//****************************************************************************80
+float TerrainCore::GetSourceHeight(double x, double z) const {
+  return height_source_->GetHeight(x, z);
+}
+
+//****************************************************************************80
+void TerrainCore::GetSourceHeights(const double* x, const double* z, 
+    float* out, std::size_t n) const {
+  // Height sources sample in single precision, which resolves world 
+  // locations far finer than any source varies. Convert in chunks on the 
+  // stack, so physics queries never touch the heap
+  const std::size_t chunk = 64;
+  float xs[chunk], zs[chunk];
+  for (std::size_t i0 = 0; i0 < n; i0 += chunk) {
+    std::size_t m = std::min(chunk, n - i0);
+    for (std::size_t i = 0; i < m; ++i) {
+      xs[i] = x[i0 + i];
+      zs[i] = z[i0 + i];
+    }
+    height_source_->GetHeights(xs, zs, out + i0, m, 0.0f);
+  }
+}
+
+//****************************************************************************80
+glm::vec3 TerrainCore::GetSourceNormal(double x, double z) const {
+  float xs = x, zs = z;
+  float h, dhdx, dhdz;
+  height_source_->GetHeightsAndGradients(&xs, &zs, &h, &dhdx, &dhdz, 1, 
+      0.0f);
+  return glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+}
+
+//****************************************************************************80
+bool TerrainCore::Raycast(const glm::dvec3& world_origin, 
+    const glm::vec3& dir, float max_dist, TerrainRayHit& hit) const {
+  float dir_length = glm::length(dir);
+  if (dir_length == 0.0f) return false;
+  glm::vec3 d = dir / dir_length;
+  // Ray in tile coordinates, tile (i,j) spans [i,i+1] x [j,j+1]
+  glm::vec3 origin = GetLocalPosition(world_origin);
+  glm::vec2 p(origin[0] / ltile_ + 0.5f + ij_origin_[0],
+              origin[2] / ltile_ + 0.5f + ij_origin_[1]);
+  glm::vec2 dp(d[0] / ltile_, d[2] / ltile_);
+  
+  // Clip the ray to the ring
+  float t = 0.0f;
+  float t_end = max_dist;
+  for (int k = 0; k < 2; ++k) {
+    float lo = tile_bounding_box_[k];
+    float hi = tile_bounding_box_[k+2] + 1;
+    if (dp[k] == 0.0f) {
+      if (p[k] < lo || p[k] > hi) return false;
+      continue;
+    }
+    float ta = (lo - p[k]) / dp[k];
+    float tb = (hi - p[k]) / dp[k];
+    t = std::max(t, std::min(ta, tb));
+    t_end = std::min(t_end, std::max(ta, tb));
+  }
+  if (t > t_end) return false;
+
+  // Walk the tiles the ray crosses in order, the first hit is the nearest
+  std::array<int,2> ij, step;
+  std::array<float,2> t_next, t_delta;
+  for (int k = 0; k < 2; ++k) {
+    ij[k] = std::min(std::max((int)std::floor(p[k] + dp[k] * t), 
+        tile_bounding_box_[k]), tile_bounding_box_[k+2]);
+    step[k] = dp[k] < 0.0f ? -1 : 1;
+    if (dp[k] == 0.0f) {
+      t_next[k] = std::numeric_limits<float>::max();
+      t_delta[k] = 0.0f;
+    }
+    else {
+      t_next[k] = (ij[k] + (step[k] > 0 ? 1 : 0) - p[k]) / dp[k];
+      t_delta[k] = std::abs(1.0f / dp[k]);
+    }
+  }
+  while (t <= t_end) {
+    float t_exit = std::min(std::min(t_next[0], t_next[1]), t_end);
+    const TerrainTile* tile = tiles_[GetSlot(ij[0], ij[1])].get();
+    float t_hit;
+    if (tile->Raycast(origin, d, t, t_exit, t_hit)) {
+      glm::vec3 position = origin + d * t_hit;
+      hit.distance = t_hit;
+      hit.position = world_origin + (glm::dvec3)(d * t_hit);
+      hit.normal = tile->GetNormal(position[0], position[2]);
+      return true;
+    }
+    int k = t_next[0] < t_next[1] ? 0 : 1;
+    ij[k] += step[k];
+    if (ij[k] < tile_bounding_box_[k] || ij[k] > tile_bounding_box_[k+2]) {
+      break;
+    }
+    t = t_next[k];
+    t_next[k] += t_delta[k];
+  }
+  return false;
+}
+
+//****************************************************************************80
+// PROTECTED FUNCTIONS
+//****************************************************************************80
+TerrainCore::TerrainCore(float l, int ntile, 
+    const std::array<double,2>& xz_center0, 
+    const std::string& tile_cache_directory, 
+    std::unique_ptr<HeightSource> height_source, bool pack) :
+  ntile_(ntile), ltile_(l / ntile), xz_center0_(xz_center0), 
+  height_source_(std::move(height_source)), 
+  query_mode_(TerrainQueryMode::interpolated) {
+  // Use odd number of tiles to make math easier
+  if (ntile_ % 2 == 0) {
+    std::string message = "Number of tiles in each direction should be odd\n";
+    throw std::invalid_argument(message);
+  }
+  if (!height_source_) {
+    // Perlin noise (3 octaves, frequency 0.04, persistence 0.75) sampled at 
+    // (0.003*x, 0.003*z, 0.5) and scaled by 100
+    height_source_.reset(new NoiseHeightSource(GradientNoise(3, 0.04*0.003, 
+            2.0, 0.75, 0, 0.5/0.003, 100.0f)));
+  }
+    
+  // Set up the tiles
+  GLint nv = TerrainTile::GetNumVertices();
+  TerrainTile::SetTileLength(ltile_);
+  if (!tile_cache_directory.empty()) {
+    tile_cache_.reset(new TerrainTileCache(tile_cache_directory, 
+          height_source_->GetKey(), ltile_, nv));
+  }
+  TerrainTile::SetHeightSource(height_source_.get());
+  TerrainTile::SetTileCache(tile_cache_.get());
+  SetOrigin({{0, 0}});
+  int half_ntile = (ntile_ - 1) / 2;
+  tile_bounding_box_ = {{-half_ntile, -half_ntile, half_ntile, half_ntile}};
+  tiles_.resize(ntile_*ntile_);
+  // The pool runs jobs in the order they are queued, so queue the tiles
+  // nearest the start first
+  startup_begin_ = std::chrono::steady_clock::now();
+  num_startup_tiles_ = tiles_.size();
+  startup_times_ = {0.0, 0.0, 0.0};
+  std::vector<std::array<int,2>> order = GetTilesNearestFirst(
+      tile_bounding_box_, {{0, 0}});
+  for (const std::array<int,2>& ij : order) {
+    int slot = GetSlot(ij[0], ij[1]);
+    std::array<GLint,2> texel_offset = {{nv * (slot % ntile_), 
+      nv * (slot / ntile_)}};
+    std::array<double,2> corner = GetTileCorner(ij[0], ij[1]);
+    tiles_[slot].reset(new TerrainTile(pack, slot, texel_offset,
+          corner[0], corner[1], thread_pool_));
+  }
+  // Wait for the tiles around the start, so the first frame has ground 
+  // under the camera, and finish any others that are ready. SetXZCenter
+  // finishes the rest as they are generated
+  std::size_t num_waited = 0;
+  for (const std::array<int,2>& ij : order) {
+    bool wait = std::max(std::abs(ij[0]), std::abs(ij[1])) <= startup_radius_;
+    num_waited += wait;
+    TerrainTile& tile = *tiles_[GetSlot(ij[0], ij[1])];
+    if (tile.FinishLoading(wait)) {
+      CountStartupLoad(tile);
+    }
+  }
+  if (num_startup_tiles_ > 0) {
+    std::cerr << "Terrain: " << num_waited << " tiles around the start "
+      << "loaded in " << std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - startup_begin_).count() 
+      << " s, streaming the other " << num_startup_tiles_ << " on " 
+      << thread_pool_.GetNumThreads() << " threads" << std::endl;
+  }
+  UpdateTileConnectivity();
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+const TerrainTile* TerrainCore::FindTile(double x, double z) const {
+  std::array<int,2> ij = GetTileIndex(x, z);
+  if (ij[0] < tile_bounding_box_[0] || ij[0] > tile_bounding_box_[2] ||
+      ij[1] < tile_bounding_box_[1] || ij[1] > tile_bounding_box_[3]) {
+    return nullptr;
+  }
+  const TerrainTile* tile = tiles_[GetSlot(ij[0], ij[1])].get();
+  return tile->IsLoaded() ? tile : nullptr;
+}
+
+//****************************************************************************80
+void TerrainCore::SetOrigin(const std::array<int,2>& ij) {
+  // Moves by whole tiles, so a tile's corner relative to the origin is the 
+  // same every time the origin returns to a tile
+  ij_origin_ = ij;
+  origin_ = {{xz_center0_[0] + ltile_*ij[0], xz_center0_[1] + ltile_*ij[1]}};
+  TerrainTile::SetOrigin(origin_);
+}
+
+//****************************************************************************80
+std::vector<std::array<int,2>> TerrainCore::GetTilesNearestFirst(
+    const std::array<int,4>& box, const std::array<int,2>& ij_center,
+    const std::array<int,4>* outside) const {
+  std::vector<std::array<int,2>> tiles;
+  for (int i = box[0]; i <= box[2]; ++i) {
+    for (int j = box[1]; j <= box[3]; ++j) {
+      if (outside && i >= (*outside)[0] && i <= (*outside)[2] && 
+          j >= (*outside)[1] && j <= (*outside)[3]) {
+        continue;
+      }
+      tiles.push_back({{i, j}});
+    }
+  }
+  auto distance2 = [&ij_center](const std::array<int,2>& ij) {
+    int di = ij[0] - ij_center[0];
+    int dj = ij[1] - ij_center[1];
+    return di * di + dj * dj;
+  };
+  std::stable_sort(tiles.begin(), tiles.end(), 
+      [&distance2](const std::array<int,2>& a, const std::array<int,2>& b) {
+        return distance2(a) < distance2(b); });
+  return tiles;
+}
+
+//****************************************************************************80
+void TerrainCore::CountStartupLoad(const TerrainTile& tile) {
+  const TerrainTile::LoadTimes& times = tile.GetLoadTimes();
+  startup_times_.noise += times.noise;
+  startup_times_.normals += times.normals;
+  startup_times_.upload += times.upload;
+  if (--num_startup_tiles_ > 0) return;
+  // Stage times are summed over tiles, the workers overlap them
+  std::cerr << "Terrain: all " << tiles_.size() << " tiles loaded in " 
+    << std::chrono::duration<double>(std::chrono::steady_clock::now() - 
+        startup_begin_).count() << " s (summed over tiles: noise " 
+    << startup_times_.noise << " s, normals " << startup_times_.normals 
+    << " s, upload " << startup_times_.upload << " s)" << std::endl;
+}
+
+//****************************************************************************80
+void TerrainCore::UpdateTileConnectivity() {
+  // Neighbors across the edge of the ring wrap around, so are left null
+  for (int i = tile_bounding_box_[0]; i <= tile_bounding_box_[2]; ++i) {
+    for (int j = tile_bounding_box_[1]; j <= tile_bounding_box_[3]; ++j) {
+      TerrainTile& tile = *tiles_[GetSlot(i,j)];
+      tile.SetNeighborPointer(j < tile_bounding_box_[3] ? 
+          tiles_[GetSlot(i,j+1)].get() : nullptr, 0);
+      tile.SetNeighborPointer(i < tile_bounding_box_[2] ? 
+          tiles_[GetSlot(i+1,j)].get() : nullptr, 1);
+      tile.SetNeighborPointer(j > tile_bounding_box_[1] ? 
+          tiles_[GetSlot(i,j-1)].get() : nullptr, 2);
+      tile.SetNeighborPointer(i > tile_bounding_box_[0] ? 
+          tiles_[GetSlot(i-1,j)].get() : nullptr, 3);
+    }
+  }
+}
+
+} // End namespace TopFun
@@ -0,0 +1,304 @@
+#ifndef TERRAINCORE_H
+#define TERRAINCORE_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cmath>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include "terrain/TerrainTile.h"
+#include "terrain/HeightSource.h"
+#include "terrain/TerrainTileCache.h"
+#include "utils/ThreadPool.h"
+
+// Ring of terrain tiles around a moving center and the height/normal
+// queries on it. Holds no GL state, so the headless tools link it without
+// a window or GL context. Terrain builds the drawing on top of it.
+
+namespace TopFun {
+
+// Nearest point where a ray meets the terrain
+struct TerrainRayHit {
+  float distance; // along the ray from its origin
+  glm::dvec3 position; // world location
+  glm::vec3 normal;
+};
+
+// How height/normal queries are answered
+enum class TerrainQueryMode {
+  procedural, // evaluate the height source directly
+  interpolated, // interpolate the resident tile grids (noise outside the ring)
+};
+
+class TerrainCore {
+
+ public:
+  //**************************************************************************80
+  //! \brief TerrainCore - Constructor, generates the ring of tiles
+  //! \param[in] l - length of terrain in the x/z directions
+  //! \param[in] ntile - number of terrain tiles in the x/z directions
+  //! \param[in] xz_center0 - starting world location of center of the ring
+  //! \param[in] tile_cache_directory - directory to cache generated tiles in,
+  //! empty to always generate them
+  //! \param[in] height_source - source of the terrain heights, null for the
+  //! default procedural terrain
+  //**************************************************************************80
+  TerrainCore(float l, int ntile, const std::array<double,2>& xz_center0,
+      const std::string& tile_cache_directory = "",
+      std::unique_ptr<HeightSource> height_source = nullptr);
+
+  //**************************************************************************80
+  //! \brief ~TerrainCore - Destructor
+  //**************************************************************************80
+  virtual ~TerrainCore();
+
+  TerrainCore(const TerrainCore&) = delete;
+  TerrainCore& operator=(const TerrainCore&) = delete;
+
+  //**************************************************************************80
+  //! \brief SetXZCenter - Update the location of the center of the ring and
+  //! finish loading any tiles that have finished generating in the
+  //! background. The origin follows the center tile
+  //! \param[in] xz_center - new world location of center of the ring
+  //! \param[in] wait - block until every tile of the ring is loaded, so the
+  //! queries do not depend on how fast tiles generate (headless runs)
+  //**************************************************************************80
+  void SetXZCenter(const std::array<double,2>& xz_center, bool wait = false);
+
+  //**************************************************************************80
+  //! \brief GetOrigin - Get the world x/z location the terrain is positioned
+  //! relative to internally and on the GPU, the center of the tile under the
+  //! center of the ring. It moves by whole tiles
+  //**************************************************************************80
+  inline const std::array<double,2>& GetOrigin() const { return origin_; }
+
+  //**************************************************************************80
+  //! \brief SetQueryMode - Set how GetHeight(s)/GetNormal are evaluated
+  //! \param[in] query_mode - procedural or interpolated
+  //**************************************************************************80
+  inline void SetQueryMode(TerrainQueryMode query_mode) {
+    query_mode_ = query_mode;
+  }
+
+  //**************************************************************************80
+  //! \brief GetQueryMode - Get how GetHeight(s)/GetNormal are evaluated
+  //**************************************************************************80
+  inline TerrainQueryMode GetQueryMode() const { return query_mode_; }
+
+  //**************************************************************************80
+  //! \brief GetHeight - Get the terrain height at a some world (x,z)
+  //! location
+  //**************************************************************************80
+  float GetHeight(double x, double z) const;
+
+  //**************************************************************************80
+  //! \brief GetHeights - Get the terrain height at n world (x,z) locations
+  //! \param[in] x - x coordinates
+  //! \param[in] z - z coordinates
+  //! \param[out] out - terrain heights
+  //! \param[in] n - number of locations
+  //**************************************************************************80
+  void GetHeights(const double* x, const double* z, float* out,
+      std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetBoundingHeight - Get the maximum height in the tile containing
+  //! some world (x,z) location
+  //**************************************************************************80
+  float GetBoundingHeight(double x, double z) const;
+
+  //**************************************************************************80
+  //! \brief GetBoundingHeight - Get an upper bound of the height over a world
+  //! x/z rectangle, from the min/max height pyramids of the tiles it covers.
+  //! It bounds the surface GetHeight interpolates in interpolated mode, and
+  //! is the largest float if any of the tiles is not loaded or in
+  //! procedural mode, where the source is not bounded by the grid
+  //! \param[in] x0, z0 - minimum corner
+  //! \param[in] x1, z1 - maximum corner
+  //**************************************************************************80
+  float GetBoundingHeight(double x0, double z0, double x1, double z1) const;
+
+  //**************************************************************************80
+  //! \brief GetNormal - Get the surface normal at some world (x,z) location
+  //**************************************************************************80
+  glm::vec3 GetNormal(double x, double z) const;
+
+  //**************************************************************************80
+  //! \brief GetSourceHeight - Evaluate the height source at some world (x,z)
+  //! location
+  //**************************************************************************80
+  float GetSourceHeight(double x, double z) const;
+
+  //**************************************************************************80
+  //! \brief GetSourceHeights - Evaluate the height source at n world (x,z)
+  //! locations
+  //! \param[in] x - x coordinates
+  //! \param[in] z - z coordinates
+  //! \param[out] out - terrain heights
+  //! \param[in] n - number of locations
+  //**************************************************************************80
+  void GetSourceHeights(const double* x, const double* z, float* out,
+      std::size_t n) const;
+
+  //**************************************************************************80
+  //! \brief GetSourceNormal - Evaluate the surface normal at some world (x,z)
+  //! location from the gradient of the height source
+  //**************************************************************************80
+  glm::vec3 GetSourceNormal(double x, double z) const;
+
+  //**************************************************************************80
+  //! \brief Raycast - Find the nearest point where a ray meets the terrain.
+  //! Only the loaded tiles of the ring are tested, against the same surface
+  //! GetHeight interpolates in interpolated mode
+  //! \param[in] origin - world location of the start of the ray
+  //! \param[in] dir - direction of the ray, need not be normalized
+  //! \param[in] max_dist - length of the ray
+  //! \param[out] hit - distance, location and surface normal of the hit
+  //! \returns true if the ray hits the terrain within max_dist
+  //**************************************************************************80
+  bool Raycast(const glm::dvec3& origin, const glm::vec3& dir, float max_dist,
+      TerrainRayHit& hit) const;
+
+ protected:
+  int ntile_;
+  float ltile_;
+  std::array<double,2> xz_center0_; // center of terrain
+  std::array<int,4> tile_bounding_box_; // bounding box in tile coordinates
+  // Floating origin at the center of tile ij_origin_. Tiles, the culling
+  // quadtree and the GPU work in single precision relative to it, so
+  // precision does not degrade with distance from the world origin
+  std::array<int,2> ij_origin_;
+  std::array<double,2> origin_;
+  // Declared before the pool, so they outlive jobs still running on it
+  std::unique_ptr<HeightSource> height_source_;
+  std::unique_ptr<TerrainTileCache> tile_cache_; // null if caching is off
+  ThreadPool thread_pool_; // generates tile vertex data off the render thread
+  // Fixed ring of ntile_ x ntile_ tile slots. Tile (i,j) lives in slot
+  // (i,j) mod ntile_, so the tile leaving one edge of the ring is reused
+  // for the tile entering at the opposite edge
+  std::vector<std::unique_ptr<TerrainTile>> tiles_;
+
+  //**************************************************************************80
+  //! \brief TerrainCore - Constructor for a ring whose tiles keep their
+  //! height map texels until they are uploaded
+  //! \param[in] pack - quantize the texels of each tile for a height map
+  //! \param[in] others - as for the public constructor
+  //**************************************************************************80
+  TerrainCore(float l, int ntile, const std::array<double,2>& xz_center0,
+      const std::string& tile_cache_directory,
+      std::unique_ptr<HeightSource> height_source, bool pack);
+
+  //**************************************************************************80
+  //! \brief OnTileRelocated - called once a tile has been relocated by
+  //! SetXZCenter, before it is loaded
+  //! \param[in] tile - the relocated tile
+  //**************************************************************************80
+  virtual void OnTileRelocated(TerrainTile& tile) { (void)tile; }
+
+  //**************************************************************************80
+  //! \brief OnTileLoaded - called once SetXZCenter has finished loading a
+  //! tile
+  //! \param[in] tile - the loaded tile
+  //**************************************************************************80
+  virtual void OnTileLoaded(TerrainTile& tile) { (void)tile; }
+
+  //**************************************************************************80
+  //! \brief OnRingChanged - called at the end of SetXZCenter if any tile was
+  //! relocated or loaded
+  //! \param[in] moved - true if the ring moved, so the origin may have too
+  //**************************************************************************80
+  virtual void OnRingChanged(bool moved) { (void)moved; }
+
+  //**************************************************************************80
+  //! \brief GetLocalPosition - get a world position relative to the origin
+  //**************************************************************************80
+  inline glm::vec3 GetLocalPosition(const glm::dvec3& position) const {
+    return glm::vec3(position[0] - origin_[0], position[1],
+        position[2] - origin_[1]);
+  }
+
+  //**************************************************************************80
+  //! \brief GetSlot - get the slot index of tile (i,j)
+  //**************************************************************************80
+  inline int GetSlot(int i, int j) const {
+    int si = ((i % ntile_) + ntile_) % ntile_;
+    int sj = ((j % ntile_) + ntile_) % ntile_;
+    return ntile_*sj + si;
+  }
+
+ private:
+  // Construction waits for the tiles within this many tiles of the start,
+  // the rest of the ring streams in nearest first
+  static const int startup_radius_ = 1;
+  // Tiles of the initial ring still loading, and the summed time of the
+  // load stages of those done, reported on stderr once the
+  // whole ring is loaded, so stdout of the headless tools is data only
+  std::size_t num_startup_tiles_;
+  TerrainTile::LoadTimes startup_times_;
+  std::chrono::steady_clock::time_point startup_begin_;
+  TerrainQueryMode query_mode_;
+
+  //**************************************************************************80
+  //! \brief GetTileIndex - get the (i,j) index of the tile containing world
+  //! location (x,z)
+  //**************************************************************************80
+  inline std::array<int,2> GetTileIndex(double x, double z) const {
+    // Tile (i,j) spans xz_center0_ + ltile_*([i,j] -/+ 0.5)
+    return {{(int)std::floor((x - xz_center0_[0]) / ltile_ + 0.5),
+             (int)std::floor((z - xz_center0_[1]) / ltile_ + 0.5)}};
+  }
+
+  //**************************************************************************80
+  //! \brief GetTileCorner - get the world location of the corner of tile
+  //! (i,j)
+  //**************************************************************************80
+  inline std::array<double,2> GetTileCorner(int i, int j) const {
+    return {{xz_center0_[0] + ltile_*(i - 0.5),
+             xz_center0_[1] + ltile_*(j - 0.5)}};
+  }
+
+  //**************************************************************************80
+  //! \brief FindTile - get the loaded tile containing some world (x,z)
+  //! location
+  //! \returns pointer to the tile, null if outside the ring or not loaded
+  //**************************************************************************80
+  const TerrainTile* FindTile(double x, double z) const;
+
+  //**************************************************************************80
+  //! \brief SetOrigin - move the floating origin to the center of a tile
+  //! \param[in] ij - index of the tile
+  //**************************************************************************80
+  void SetOrigin(const std::array<int,2>& ij);
+
+  //**************************************************************************80
+  //! \brief GetTilesNearestFirst - get the (i,j) index of the tiles in a box,
+  //! ordered by distance from a center tile
+  //! \param[in] box - bounding box in tile coordinates
+  //! \param[in] ij_center - index of the center tile
+  //! \param[in] outside - box whose tiles are left out, if any
+  //**************************************************************************80
+  std::vector<std::array<int,2>> GetTilesNearestFirst(
+      const std::array<int,4>& box, const std::array<int,2>& ij_center,
+      const std::array<int,4>* outside = nullptr) const;
+
+  //**************************************************************************80
+  //! \brief CountStartupLoad - add a tile of the initial ring that finished
+  //! loading to the startup timings, reporting them once all have
+  //! \param[in] tile - the loaded tile
+  //**************************************************************************80
+  void CountStartupLoad(const TerrainTile& tile);
+
+  //**************************************************************************80
+  //! \brief UpdateTileConnectivity - update tile neighbor pointers
+  //**************************************************************************80
+  void UpdateTileConnectivity();
+
+};
+} // End namespace TopFun
+
+#endif
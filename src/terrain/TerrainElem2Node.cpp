@@ -0,0 +1,214 @@
+#include <cmath>
+
+#include "terrain/TerrainElem2Node.h"
+
+namespace TopFun {
+
+//****************************************************************************80
+void BuildAllElem2Node(std::vector<std::uint32_t>& indices, 
+    std::vector<Elem2NodeRange>& ranges) {
+  indices.clear();
+  ranges.assign(NeighborLoD::num_keys, Elem2NodeRange{0, 0});
+  // Indices follow right-hand-rule is out of the page
+  std::uint32_t nv0 = std::pow(2, terrain_num_lod) + 1;
+  for (unsigned short c = 0; c < terrain_num_lod; ++c) {
+    std::uint32_t edge_size = std::pow(2, terrain_num_lod - c);
+    std::uint32_t pow2c = std::pow(2,c);
+    for (unsigned short n = 0; n <= c; ++n) {
+      for (unsigned short e = 0; e <= c; ++e) {
+        for (unsigned short s = 0; s <= c; ++s) {
+          for (unsigned short w = 0; w <= c; ++w) {
+            std::vector<std::uint32_t> elem2node;
+            // Build the north edge
+            unsigned short num_edge_splits = std::pow(2,c-n);
+            std::uint32_t df  = pow2c / (num_edge_splits);
+            for (std::uint32_t i = 0; i < edge_size; ++i) {
+              std::uint32_t j = edge_size - 1;
+              std::uint32_t i0 = i*pow2c;
+              std::uint32_t j0 = j*pow2c;
+              std::uint32_t i0p = (i+1)*pow2c;
+              std::uint32_t j0p = (j+1)*pow2c;
+              if (i < edge_size/2) {
+                // Add lower triangle
+                if (i > 0) {
+                  elem2node.push_back(nv0*j0 + i0); 
+                  elem2node.push_back(nv0*j0 + i0p);
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+                // Add upper (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*j0p + i0 + df*(f + 1));
+                  elem2node.push_back(nv0*j0p + i0 + df*f);
+                  elem2node.push_back(nv0*j0 + i0p);
+                }
+              }
+              else {
+                // Add lower triangle
+                if (i < edge_size - 1) {
+                  elem2node.push_back(nv0*j0 + i0); 
+                  elem2node.push_back(nv0*j0 + i0p);
+                  elem2node.push_back(nv0*j0p + i0p);
+                }
+                // Add upper (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*j0p + i0 + df*(f + 1));
+                  elem2node.push_back(nv0*j0p + i0 + df*f);
+                  elem2node.push_back(nv0*j0 + i0);
+                }
+              }
+            }
+            // Build the east edge
+            num_edge_splits = std::pow(2,c-e);
+            df = pow2c / (num_edge_splits);
+            for (std::uint32_t j = 0; j < edge_size; ++j) {
+              std::uint32_t i = edge_size - 1;
+              std::uint32_t i0 = i*pow2c;
+              std::uint32_t j0 = j*pow2c;
+              std::uint32_t i0p = (i+1)*pow2c;
+              std::uint32_t j0p = (j+1)*pow2c;
+              if (j < edge_size/2) {
+                // Add left triangle
+                if (j > 0) {
+                  elem2node.push_back(nv0*j0 + i0); 
+                  elem2node.push_back(nv0*j0 + i0p);
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+                // Add right (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*(j0+df*f) + i0p); 
+                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0p);
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+              }
+              else {
+                // Add left triangle
+                if (j < edge_size - 1) {
+                  elem2node.push_back(nv0*j0 + i0); 
+                  elem2node.push_back(nv0*j0p + i0p);
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+                // Add right (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*(j0+df*f) + i0p); 
+                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0p);
+                  elem2node.push_back(nv0*j0 + i0);
+                }
+              }
+            }
+            // Build the south edge
+            num_edge_splits = std::pow(2,c-s);
+            df  = pow2c / (num_edge_splits);
+            for (std::uint32_t i = 0; i < edge_size; ++i) {
+              std::uint32_t j = 0;
+              std::uint32_t i0 = i*pow2c;
+              std::uint32_t j0 = j*pow2c;
+              std::uint32_t i0p = (i+1)*pow2c;
+              std::uint32_t j0p = (j+1)*pow2c;
+              if (i < edge_size/2) {
+                // Add upper triangle
+                if (i > 0) {
+                  elem2node.push_back(nv0*j0 + i0); 
+                  elem2node.push_back(nv0*j0p + i0p);
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+                // Add lower (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*j0 + i0 + df*f); 
+                  elem2node.push_back(nv0*j0 + i0 + df*(f + 1));
+                  elem2node.push_back(nv0*j0p + i0p);
+                }
+              }
+              else {
+                // Add upper triangle
+                if (i < edge_size - 1) {
+                  elem2node.push_back(nv0*j0 + i0p); 
+                  elem2node.push_back(nv0*j0p + i0p);
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+                // Add lower (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*j0 + i0 + df*f); 
+                  elem2node.push_back(nv0*j0 + i0 + df*(f + 1));
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+              }
+            }
+            // Build the west edge
+            num_edge_splits = std::pow(2,c-w);
+            df  = pow2c / (num_edge_splits);
+            for (std::uint32_t j = 0; j < edge_size; ++j) {
+              std::uint32_t i = 0;
+              std::uint32_t i0 = i*pow2c;
+              std::uint32_t j0 = j*pow2c;
+              std::uint32_t i0p = (i+1)*pow2c;
+              std::uint32_t j0p = (j+1)*pow2c;
+              if (j < edge_size/2) {
+                // Add right triangle
+                if (j > 0) {
+                  elem2node.push_back(nv0*j0 + i0); 
+                  elem2node.push_back(nv0*j0 + i0p);
+                  elem2node.push_back(nv0*j0p + i0p);
+                }
+                // Add left (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*(j0+df*f) + i0); 
+                  elem2node.push_back(nv0*j0p + i0p);
+                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0);
+                }
+              }
+              else {
+                // Add right triangle
+                if (j < edge_size - 1) {
+                  elem2node.push_back(nv0*j0 + i0p);
+                  elem2node.push_back(nv0*j0p + i0p);
+                  elem2node.push_back(nv0*j0p + i0);
+                }
+                // Add left (split) triangles
+                for (std::uint32_t f = 0; f < num_edge_splits; ++f) {
+                  elem2node.push_back(nv0*(j0+df*f) + i0);
+                  elem2node.push_back(nv0*j0 + i0p);
+                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0);
+                }
+              }
+            }
+            // Build the center
+            if (c < terrain_num_lod - 1) {
+              for (std::uint32_t i = 1; i < edge_size - 1; ++i) {
+                for (std::uint32_t j = 1; j < edge_size - 1; ++j) {
+                  std::uint32_t i0 = i*pow2c;
+                  std::uint32_t j0 = j*pow2c;
+                  std::uint32_t i0p = (i+1)*pow2c;
+                  std::uint32_t j0p = (j+1)*pow2c;
+                  // Set diagonal edge orientation
+                  if ((i <  edge_size/2 && j <  edge_size/2) ||
+                      (i >= edge_size/2 && j >= edge_size/2)) {
+                    elem2node.push_back(nv0*j0 + i0);
+                    elem2node.push_back(nv0*j0p + i0p);
+                    elem2node.push_back(nv0*j0p + i0);
+                    elem2node.push_back(nv0*j0 + i0);
+                    elem2node.push_back(nv0*j0 + i0p);
+                    elem2node.push_back(nv0*j0p + i0p);
+                  }
+                  else {
+                    elem2node.push_back(nv0*j0 + i0);
+                    elem2node.push_back(nv0*j0 + i0p);
+                    elem2node.push_back(nv0*j0p + i0);
+                    elem2node.push_back(nv0*j0 + i0p);
+                    elem2node.push_back(nv0*j0p + i0p);
+                    elem2node.push_back(nv0*j0p + i0);
+                  }
+                }
+              }
+            }
+            NeighborLoD neigh_lod(c, n, e, s, w);
+            ranges[neigh_lod.key].offset = indices.size();
+            ranges[neigh_lod.key].count = elem2node.size();
+            indices.insert(indices.end(), elem2node.begin(), elem2node.end());
+          }
+        }
+      }
+    }
+  }
+}
+
+} // End namespace TopFun
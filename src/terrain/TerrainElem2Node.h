@@ -0,0 +1,42 @@
+#ifndef TERRAINELEM2NODE_H
+#define TERRAINELEM2NODE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "terrain/NeighborLoD.h"
+
+// Element-to-node connectivities of a terrain tile for every combination of
+// tile LoD and (finer or equal) neighbor LoDs. The tables are generated at
+// build time by terrain_elem2node_gen, which calls BuildAllElem2Node, into
+// one contiguous index array plus a range table indexed by NeighborLoD::key.
+// Indices are local to a tile (the draws add the slot's base vertex), so the
+// generated array is stored as 16-bit
+
+namespace TopFun {
+
+// Location of one connectivity in the index array
+struct Elem2NodeRange {
+  std::uint32_t offset; // first index
+  std::uint32_t count; // number of indices, 0 if the key is unused
+};
+
+//****************************************************************************80
+//! \brief BuildAllElem2Node - builds all element-to-node connectivities
+//! \param[out] indices - all connectivities, one after the other
+//! \param[out] ranges - range of indices of each NeighborLoD key
+//****************************************************************************80
+void BuildAllElem2Node(std::vector<std::uint32_t>& indices, 
+    std::vector<Elem2NodeRange>& ranges);
+
+// Tables generated at build time (TerrainElem2NodeTable.cpp)
+namespace Elem2NodeTable {
+extern const std::uint16_t indices[];
+extern const std::size_t num_indices;
+extern const Elem2NodeRange ranges[NeighborLoD::num_keys];
+} // End namespace Elem2NodeTable
+
+} // End namespace TopFun
+
+#endif
@@ -0,0 +1,54 @@
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <limits>
+
+#include "terrain/TerrainElem2Node.h"
+
+// Build-time generator of the terrain LoD stitching tables. Writes a source
+// file defining the Elem2NodeTable arrays declared in TerrainElem2Node.h
+
+using namespace TopFun;
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <output file>" << std::endl;
+    return 1;
+  }
+  std::vector<std::uint32_t> indices;
+  std::vector<Elem2NodeRange> ranges;
+  BuildAllElem2Node(indices, ranges);
+  for (std::uint32_t index : indices) {
+    if (index > std::numeric_limits<std::uint16_t>::max()) {
+      std::cerr << "Index " << index << " does not fit in 16 bits" 
+        << std::endl;
+      return 1;
+    }
+  }
+
+  std::ofstream out(argv[1]);
+  out << "// Generated by terrain_elem2node_gen, do not edit\n"
+    << "#include \"terrain/TerrainElem2Node.h\"\n\n"
+    << "namespace TopFun {\n"
+    << "namespace Elem2NodeTable {\n\n";
+  out << "const std::uint16_t indices[] = {";
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    out << (i % 16 == 0 ? "\n  " : " ") << indices[i] << ",";
+  }
+  out << "\n};\n\n";
+  out << "const std::size_t num_indices = " << indices.size() << ";\n\n";
+  out << "const Elem2NodeRange ranges[NeighborLoD::num_keys] = {";
+  for (std::size_t i = 0; i < ranges.size(); ++i) {
+    out << (i % 8 == 0 ? "\n  " : " ") 
+      << "{" << ranges[i].offset << "," << ranges[i].count << "},";
+  }
+  out << "\n};\n\n"
+    << "} // End namespace Elem2NodeTable\n"
+    << "} // End namespace TopFun\n";
+  out.close();
+  if (!out) {
+    std::cerr << "Could not write " << argv[1] << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <limits>
+
+#include "terrain/TerrainQuadtree.h"
+#include "geometry/BoundingBox.h"
+
+namespace TopFun {
+
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+void TerrainQuadtree::Build(const std::vector<TerrainTile*>& tiles, int ni, 
+    int nj) {
+  nodes_.clear();
+  BuildNode(tiles, ni, 0, ni, 0, nj);
+}
+
+//****************************************************************************80
+void TerrainQuadtree::GetVisibleTiles(const BoundingFrustum& frustum, 
+    const glm::vec4& cutoff, const glm::vec3& origin,
+    std::vector<TerrainTile*>& visible) const {
+  visible.clear();
+  if (!nodes_.empty()) {
+    AddVisible(nodes_.size() - 1, frustum, cutoff, origin, true, visible);
+  }
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+int TerrainQuadtree::BuildNode(const std::vector<TerrainTile*>& tiles, 
+    int ni, int i0, int i1, int j0, int j1) {
+  if (i0 >= i1 || j0 >= j1) return -1;
+  Node node;
+  node.children = {{-1, -1, -1, -1}};
+  node.tile = nullptr;
+  if (i1 - i0 == 1 && j1 - j0 == 1) {
+    // Leaf
+    node.tile = tiles[ni*j0 + i0];
+    if (!node.tile) return -1;
+    node.minimum = node.tile->GetAABBMinimum();
+    node.maximum = node.tile->GetAABBMaximum();
+  }
+  else {
+    // Split both directions and merge the child AABBs
+    int im = (i0 + i1 + 1) / 2;
+    int jm = (j0 + j1 + 1) / 2;
+    node.children[0] = BuildNode(tiles, ni, i0, im, j0, jm);
+    node.children[1] = BuildNode(tiles, ni, im, i1, j0, jm);
+    node.children[2] = BuildNode(tiles, ni, i0, im, jm, j1);
+    node.children[3] = BuildNode(tiles, ni, im, i1, jm, j1);
+    node.minimum = glm::vec3(std::numeric_limits<float>::max());
+    node.maximum = glm::vec3(std::numeric_limits<float>::lowest());
+    bool empty = true;
+    for (int c : node.children) {
+      if (c < 0) continue;
+      node.minimum = glm::min(node.minimum, nodes_[c].minimum);
+      node.maximum = glm::max(node.maximum, nodes_[c].maximum);
+      empty = false;
+    }
+    if (empty) return -1;
+  }
+  nodes_.push_back(node);
+  return nodes_.size() - 1;
+}
+
+//****************************************************************************80
+void TerrainQuadtree::AddVisible(int ix, const BoundingFrustum& frustum, 
+    const glm::vec4& cutoff, const glm::vec3& origin, bool test,
+    std::vector<TerrainTile*>& visible) const {
+  const Node& node = nodes_[ix];
+  BoundingBox box(node.minimum, node.maximum, -origin);
+  glm::vec3 normal(cutoff);
+  if (glm::dot(normal, box.GetPositiveVertex(normal)) + cutoff.w < 0.0f) {
+    return;
+  }
+  if (test) {
+    BoundingVolume::TestResult result = frustum.TestIntersection(box);
+    if (result == BoundingVolume::OUTSIDE) {
+      return;
+    }
+    test = (result == BoundingVolume::INTERSECT);
+  }
+  if (node.tile) {
+    visible.push_back(node.tile);
+    return;
+  }
+  for (int c : node.children) {
+    if (c >= 0) {
+      AddVisible(c, frustum, cutoff, origin, test, visible);
+    }
+  }
+}
+
+} // End namespace TopFun
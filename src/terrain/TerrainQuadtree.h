@@ -0,0 +1,78 @@
+#ifndef TERRAINQUADTREE_H
+#define TERRAINQUADTREE_H
+
+#include <vector>
+#include <array>
+
+#include <glm/glm.hpp>
+
+#include "geometry/BoundingFrustum.h"
+#include "terrain/TerrainTile.h"
+
+// Quadtree over the ring of terrain tiles used to find the visible tiles.
+// Leaves point to tiles, and the AABB of each node is built from its 
+// children (bottom up), so whole blocks of tiles are culled with one test.
+
+namespace TopFun {
+
+class TerrainQuadtree {
+
+ public:
+  //**************************************************************************80
+  //! \brief TerrainQuadtree - Constructor for an empty tree
+  //**************************************************************************80
+  TerrainQuadtree() = default;
+
+  //**************************************************************************80
+  //! \brief ~TerrainQuadtree - Destructor
+  //**************************************************************************80
+  ~TerrainQuadtree() = default;
+
+  //**************************************************************************80
+  //! \brief Build - rebuild the tree over a block of tiles
+  //! \param[in] tiles - ni x nj tiles (i fastest), null if not loaded
+  //! \param[in] ni - number of tiles in the x direction
+  //! \param[in] nj - number of tiles in the z direction
+  //**************************************************************************80
+  void Build(const std::vector<TerrainTile*>& tiles, int ni, int nj);
+
+  //**************************************************************************80
+  //! \brief GetVisibleTiles - find tiles inside a frustum and in front of a 
+  //! cut-off plane
+  //! \param[in] frustum - frustum in coordinates relative to origin
+  //! \param[in] cutoff - plane (relative to origin), tiles entirely on its
+  //! negative side are rejected
+  //! \param[in] origin - world location of the frustum origin
+  //! \param[out] visible - the visible tiles
+  //**************************************************************************80
+  void GetVisibleTiles(const BoundingFrustum& frustum, 
+      const glm::vec4& cutoff, const glm::vec3& origin,
+      std::vector<TerrainTile*>& visible) const;
+
+ private:
+  struct Node {
+    glm::vec3 minimum, maximum; // AABB of all tiles below this node
+    std::array<int,4> children; // indices of child nodes, -1 if none
+    TerrainTile* tile; // tile for leaf nodes, null otherwise
+  };
+  std::vector<Node> nodes_; // root is the last node
+  
+  //**************************************************************************80
+  //! \brief BuildNode - recursively build the nodes for a range of tiles
+  //! \returns index of the node, -1 if the range contains no tiles
+  //**************************************************************************80
+  int BuildNode(const std::vector<TerrainTile*>& tiles, int ni, int i0, 
+      int i1, int j0, int j1);
+
+  //**************************************************************************80
+  //! \brief AddVisible - recursively collect the visible tiles below a node
+  //! \param[in] test - false if the node is known to be inside the frustum
+  //**************************************************************************80
+  void AddVisible(int ix, const BoundingFrustum& frustum, 
+      const glm::vec4& cutoff, const glm::vec3& origin, bool test,
+      std::vector<TerrainTile*>& visible) const;
+
+};
+} // End namespace TopFun
+
+#endif
@@ -1,225 +1,401 @@
 #include <iostream>
 #include <limits>
 #include <array>
-
-#include "module/perlin.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
 
 #include "terrain/TerrainTile.h"
-#include "terrain/Terrain.h"
 
 namespace TopFun {
 
+namespace {
+//****************************************************************************80
+//! \brief SecondsSince - seconds elapsed since some time point
+//****************************************************************************80
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - 
+      start).count();
+}
+} // End anonymous namespace
+
 //****************************************************************************80
 // STATIC MEMBERS
 //****************************************************************************80
 GLfloat TerrainTile::l_tile_;
-boost::unordered_map<NeighborLoD, std::vector<GLuint>> 
-    TerrainTile::elem2node_all_ = BuildAllElem2Node();
+std::array<double,2> TerrainTile::origin_ = {{0.0, 0.0}};
+const HeightSource* TerrainTile::height_source_ = nullptr;
+const TerrainTileCache* TerrainTile::tile_cache_ = nullptr;
 
 //****************************************************************************80
 // PUBLIC FUNCTIONS
 //****************************************************************************80
-TerrainTile::TerrainTile(const Shader& shader, GLfloat x0, GLfloat z0) : 
-  lods_(0,0,0,0,0), lods_prev_(0,0,0,0,0),
-  neighbor_tiles_({{nullptr, nullptr, nullptr, nullptr}}) {
-
-  // Set up vertices and normals
-  std::vector<Vertex> vertices = SetupVertices(x0, z0);
- 
-  // Set up attribute and buffer objects
-  GLuint VBO;
-  glGenVertexArrays(1, &VAO_);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO_);
-  
-  glBindVertexArray(VAO_);
+TerrainTile::TerrainTile(bool pack, GLint slot,
+    const std::array<GLint,2>& texel_offset, double x0, double z0,
+    ThreadPool& thread_pool) : pack_(pack), 
+  base_vertex_(slot * GetNumVertices() * GetNumVertices()),
+  texel_offset_(texel_offset), morph_(0.0f), lods_(0,0,0,0,0), 
+  lods_prev_(0,0,0,0,0), 
+  neighbor_tiles_({{nullptr, nullptr, nullptr, nullptr}}), loaded_(false),
+  placeholder_(false) {
+  elem2node_range_ = Elem2NodeTable::ranges[lods_.key];
 
-  // Set up the VBO
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), 
-      vertices.data(), GL_STATIC_DRAW);
-  
-  // Set up the initial EBO
-  pelem2node_ = &elem2node_all_[lods_];
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * pelem2node_->size(), 
-      pelem2node_->data(), GL_DYNAMIC_DRAW);
-
-  GLint pos_loc  = glGetAttribLocation(shader.GetProgram(), "position");
-  GLint norm_loc = glGetAttribLocation(shader.GetProgram(), "normal");
-  GLint tex_loc  = glGetAttribLocation(shader.GetProgram(), "texCoord");
- 
-  // Position attribute
-  glEnableVertexAttribArray(pos_loc);
-  glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 
-      reinterpret_cast<GLvoid*>(offsetof(Vertex, position)));
-  // Normal attribute
-  glEnableVertexAttribArray(norm_loc);
-  glVertexAttribPointer(norm_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 
-      reinterpret_cast<GLvoid*>(offsetof(Vertex, normal)));
-  // Texture attribute
-  glEnableVertexAttribArray(tex_loc);
-  glVertexAttribPointer(tex_loc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), 
-      reinterpret_cast<GLvoid*>(offsetof(Vertex, texture)));
-
-  // Unbind VBO and VAO, but not EBO
-  // The call to glVertexAttribPointer registers VBO to VAO, so safe to unbind
-  glBindBuffer(GL_ARRAY_BUFFER, 0); 
-  glBindVertexArray(0);
+  // Generate heights and normals on a worker thread
+  Relocate(x0, z0, thread_pool);
 }
 
 //****************************************************************************80
-TerrainTile::~TerrainTile() {
-  glDeleteBuffers(1, &EBO_); 
-  glDeleteVertexArrays(1, &VAO_);
+void TerrainTile::Relocate(double x0, double z0, ThreadPool& thread_pool) {
+  x0_ = x0;
+  z0_ = z0;
+  loaded_ = false;
+  placeholder_ = false;
+  // Any job still running for the old location is simply discarded
+  const HeightSource* height_source = height_source_;
+  const TerrainTileCache* tile_cache = tile_cache_;
+  bool pack = pack_;
+  vertex_data_ = thread_pool.Submit(
+      [x0, z0, height_source, tile_cache, pack]() { 
+      return SetupVertices(x0, z0, height_source, tile_cache, pack); });
 }
 
 //****************************************************************************80
-void TerrainTile::Draw() {
-  // Determine if any vertices of the AABB for this tile are in camera frustrum
-  // TODO
- 
+void TerrainTile::GetDrawCommand(GLsizei& count, GLvoid*& indices, 
+    GLint& base_vertex) {
   // Update element-to-node connectivity if this tile or neighbor LoD changed
   UpdateNeighborLoD();
   if (lods_prev_ != lods_) {
     UpdateElem2Node();
     lods_prev_ = lods_;
   }
+  count = elem2node_range_.count;
+  indices = reinterpret_cast<GLvoid*>(sizeof(GLushort) * 
+      elem2node_range_.offset);
+  base_vertex = base_vertex_;
+}
+
+//****************************************************************************80
+bool TerrainTile::FinishLoading(bool wait) {
+  if (loaded_) return false;
+  if (!wait && vertex_data_.wait_for(std::chrono::seconds(0)) != 
+      std::future_status::ready) {
+    return false;
+  }
+  VertexData data = vertex_data_.get();
+  auto start = std::chrono::steady_clock::now();
+  ymin_ = data.ymin;
+  ymax_ = data.ymax;
+  lod_errors_ = data.lod_errors;
+  GLint nv = GetNumVertices();
+  packed_texels_ = std::move(data.packed_texels);
+  // Keep heights and normals around for physics queries
+  heights_.resize(nv*nv);
+  normals_.resize(nv*nv);
+  for (GLint i = 0; i < nv*nv; ++i) {
+    const Texel& t = data.ptexels[i];
+    heights_[i] = t.height;
+    normals_[i] = glm::vec3(t.normal[0], t.normal[1], t.normal[2]);
+  }
+  height_bounds_ = std::move(data.height_bounds);
+  load_times_ = data.load_times;
+  load_times_.upload = SecondsSince(start);
+  loaded_ = true;
+  return true;
+}
+
+//****************************************************************************80
+float TerrainTile::GetHeight(float x, float z) const {
+  std::array<int,2> ix;
+  std::array<float,2> s;
+  GetGridCoordinates(x, z, ix, s);
+  int nv = std::pow(2,num_lod_) + 1;
+  int v0 = nv*ix[1] + ix[0];
+  return (1.0f - s[1]) * ((1.0f - s[0]) * heights_[v0] + 
+                                   s[0] * heights_[v0 + 1]) +
+                  s[1] * ((1.0f - s[0]) * heights_[v0 + nv] + 
+                                   s[0] * heights_[v0 + nv + 1]);
+}
+
+//****************************************************************************80
+glm::vec3 TerrainTile::GetNormal(float x, float z) const {
+  std::array<int,2> ix;
+  std::array<float,2> s;
+  GetGridCoordinates(x, z, ix, s);
+  int nv = std::pow(2,num_lod_) + 1;
+  int v0 = nv*ix[1] + ix[0];
+  return glm::normalize(
+      (1.0f - s[1]) * ((1.0f - s[0]) * normals_[v0] + 
+                                s[0] * normals_[v0 + 1]) +
+               s[1] * ((1.0f - s[0]) * normals_[v0 + nv] + 
+                                s[0] * normals_[v0 + nv + 1]));
+}
   
-  // Render
-  glBindVertexArray(VAO_);
-  glDrawElements(GL_TRIANGLES, pelem2node_->size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
+//****************************************************************************80
+float TerrainTile::GetMaxHeight(float x0, float z0, float x1, float z1) const {
+  if (!loaded_) return std::numeric_limits<float>::max();
+  GLint ne = 1 << num_lod_;
+  GLfloat dx = l_tile_ / ne;
+  // Rectangle in grid cell units, relative to the tile corner
+  glm::vec2 corner = GetLocalCorner();
+  GLfloat u0 = (x0 - corner[0]) / dx;
+  GLfloat v0 = (z0 - corner[1]) / dx;
+  GLfloat u1 = (x1 - corner[0]) / dx;
+  GLfloat v1 = (z1 - corner[1]) / dx;
+  float y_max = std::numeric_limits<float>::lowest();
+  if (u1 < 0.0f || v1 < 0.0f || u0 > ne || v0 > ne) return y_max;
+
+  // Depth first descent, blocks inside the rectangle or no higher than the
+  // maximum so far are not refined
+  struct Block { 
+    int level, i, j;
+  };
+  Block stack[4 * num_lod_ + 1];
+  int num_stack = 0;
+  stack[num_stack++] = {num_lod_, 0, 0};
+  while (num_stack > 0) {
+    Block b = stack[--num_stack];
+    GLfloat size = 1 << b.level;
+    GLfloat bu0 = b.i * size;
+    GLfloat bv0 = b.j * size;
+    if (bu0 > u1 || bv0 > v1 || bu0 + size < u0 || bv0 + size < v0) {
+      continue;
+    }
+    GLfloat bound = height_bounds_[GetHeightBoundsOffset(b.level) + 
+      (ne >> b.level) * b.j + b.i][1];
+    if (bound <= y_max) continue;
+    bool inside = (bu0 >= u0 && bv0 >= v0 && bu0 + size <= u1 && 
+        bv0 + size <= v1);
+    if (inside || b.level == 0) {
+      y_max = bound;
+      continue;
+    }
+    for (int c = 0; c < 4; ++c) {
+      stack[num_stack++] = {b.level - 1, 2 * b.i + (c & 1), 
+        2 * b.j + (c >> 1)};
+    }
+  }
+  return y_max;
 }
   
 //****************************************************************************80
-std::vector<TerrainTile::Vertex> TerrainTile::SetupVertices(GLfloat x0, 
-    GLfloat z0) {
-  // Generate one layer of halo elements to smooth normals with
-  int ne = std::pow(2,num_lod_);
-  int nv = ne+1;
-  std::vector<Vertex> vertices(std::pow(nv+2,2));
+bool TerrainTile::Raycast(const glm::vec3& origin, const glm::vec3& dir, 
+    GLfloat t_min, GLfloat t_max, GLfloat& t_hit) const {
+  if (!loaded_) return false;
+  GLint ne = 1 << num_lod_;
+  GLfloat dx = l_tile_ / ne;
+  // Ray in grid cell units, relative to the tile corner
+  glm::vec2 corner = GetLocalCorner();
+  glm::vec2 o((origin[0] - corner[0]) / dx, (origin[2] - corner[1]) / dx);
+  glm::vec2 d(dir[0] / dx, dir[2] / dx);
+  glm::vec2 inv_d(1.0f / d[0], 1.0f / d[1]);
+  // Visit children nearest the ray origin first
+  int flip_i = d[0] < 0.0f ? 1 : 0;
+  int flip_j = d[1] < 0.0f ? 1 : 0;
 
-  // Vertex position
-  ymin_ = std::numeric_limits<GLfloat>::max();
-  ymax_ = std::numeric_limits<GLfloat>::min();
-  GLfloat dx = l_tile_/ne;
-  for (int i = 0; i < nv+2; ++i) {
-    for (int j = 0; j < nv+2; ++j) {
-      GLuint ix = (nv+2)*j + i;
-      vertices[ix].position[0] = x0 + dx*(i-1);
-      vertices[ix].position[1] = Terrain::GetHeight(x0 + dx*(i-1), 
-          z0 + dx*(j-1));
-      vertices[ix].position[2] = z0 + dx*(j-1);
-      // Zero out the normals
-      for (int d = 0; d < 3; ++d) {
-        vertices[ix].normal[d] = 0.0;
+  // Depth first descent, a hit shortens the ray so blocks behind it are 
+  // skipped
+  struct Block { 
+    int level, i, j;
+  };
+  Block stack[4 * num_lod_ + 1];
+  int num_stack = 0;
+  stack[num_stack++] = {num_lod_, 0, 0};
+  bool hit = false;
+  while (num_stack > 0) {
+    Block b = stack[--num_stack];
+    // Ray interval over the block in x/z
+    GLfloat size = 1 << b.level;
+    GLfloat t0 = t_min;
+    GLfloat t1 = t_max;
+    for (int k = 0; k < 2; ++k) {
+      GLfloat lo = (k == 0 ? b.i : b.j) * size;
+      if (d[k] == 0.0f) {
+        if (o[k] < lo || o[k] > lo + size) {
+          t1 = -1.0f;
+        }
+        continue;
       }
+      GLfloat ta = (lo - o[k]) * inv_d[k];
+      GLfloat tb = (lo + size - o[k]) * inv_d[k];
+      t0 = std::max(t0, std::min(ta, tb));
+      t1 = std::min(t1, std::max(ta, tb));
     }
-  }
- 
-  // Vertex normals (smoothed)
-  for (int i = 0; i < ne+2; ++i) {
-    for (int j = 0; j < ne+2; ++j) {
-      GLuint v0_ix = (nv+2)* j +    i    ;
-      GLuint v1_ix = (nv+2)* j +    i + 1;
-      GLuint v2_ix = (nv+2)*(j+1) + i + 1;
-      GLuint v3_ix = (nv+2)*(j+1) + i    ;
-      glm::vec3 e01(vertices[v1_ix].position[0] - vertices[v0_ix].position[0],
-                    vertices[v1_ix].position[1] - vertices[v0_ix].position[1],
-                    vertices[v1_ix].position[2] - vertices[v0_ix].position[2]);
-      glm::vec3 e12(vertices[v2_ix].position[0] - vertices[v1_ix].position[0],
-                    vertices[v2_ix].position[1] - vertices[v1_ix].position[1],
-                    vertices[v2_ix].position[2] - vertices[v1_ix].position[2]);
-      glm::vec3 e23(vertices[v3_ix].position[0] - vertices[v2_ix].position[0],
-                    vertices[v3_ix].position[1] - vertices[v2_ix].position[1],
-                    vertices[v3_ix].position[2] - vertices[v2_ix].position[2]);
-      glm::vec3 e30(vertices[v0_ix].position[0] - vertices[v3_ix].position[0],
-                    vertices[v0_ix].position[1] - vertices[v3_ix].position[1],
-                    vertices[v0_ix].position[2] - vertices[v3_ix].position[2]);
-      glm::vec3 e02(vertices[v2_ix].position[0] - vertices[v0_ix].position[0],
-                    vertices[v2_ix].position[1] - vertices[v0_ix].position[1],
-                    vertices[v2_ix].position[2] - vertices[v0_ix].position[2]);
-      glm::vec3 e13(vertices[v3_ix].position[0] - vertices[v1_ix].position[0],
-                    vertices[v3_ix].position[1] - vertices[v1_ix].position[1],
-                    vertices[v3_ix].position[2] - vertices[v1_ix].position[2]);
-      glm::vec3 n0 = -cross(e01,  e02) - cross( e02, -e30);
-      glm::vec3 n1 = -cross(e12,  e13) - cross( e13, -e01);
-      glm::vec3 n2 = -cross(e23, -e02) - cross(-e02, -e12);
-      glm::vec3 n3 = -cross(e30, -e13) - cross(-e13, -e23);
-      for (int d = 0; d < 3; ++d) {
-        vertices[v0_ix].normal[d] += n0[d];
-        vertices[v1_ix].normal[d] += n1[d];
-        vertices[v2_ix].normal[d] += n2[d];
-        vertices[v3_ix].normal[d] += n3[d];
+    if (t0 > t1) continue;
+    // Ray height over the interval against the block's height range
+    const std::array<GLfloat,2>& bounds = height_bounds_[
+      GetHeightBoundsOffset(b.level) + (ne >> b.level) * b.j + b.i];
+    GLfloat y0 = origin[1] + dir[1] * t0;
+    GLfloat y1 = origin[1] + dir[1] * t1;
+    if (std::max(y0, y1) < bounds[0] || std::min(y0, y1) > bounds[1]) {
+      continue;
+    }
+    if (b.level == 0) {
+      GLfloat t;
+      if (IntersectCell(b.i, b.j, origin, dir, t0, t1, t)) {
+        t_hit = t;
+        t_max = t;
+        hit = true;
       }
+      continue;
+    }
+    // Push the farthest child first so the nearest is visited first
+    for (int c = 3; c >= 0; --c) {
+      int ci = (c & 1) ^ flip_i;
+      int cj = (c >> 1) ^ flip_j;
+      stack[num_stack++] = {b.level - 1, 2 * b.i + ci, 2 * b.j + cj};
     }
   }
+  return hit;
+}
 
-  // Copy interior data out
-  std::vector<Vertex> vertices_out(std::pow(nv,2));
-  ymin_ = std::numeric_limits<GLfloat>::max();
-  ymax_ = std::numeric_limits<GLfloat>::min();
-  for (int i = 0; i < nv; ++i) {
-    for (int j = 0; j < nv; ++j) {
-      GLuint ix = nv*j + i;
-      GLuint ix0 = (nv+2)*(j+1) + i + 1;
-      for (int d = 0; d < 3; ++d) {
-        vertices_out[ix].position[d] = vertices[ix0].position[d];
-        vertices_out[ix].normal[d]   = vertices[ix0].normal[d];
-      }
-      // Set the bounding box
-      ymin_ = std::min(ymin_, vertices_out[ix].position[1]);
-      ymax_ = std::max(ymax_, vertices_out[ix].position[1]);
+//****************************************************************************80
+TerrainTile::VertexData TerrainTile::SetupVertices(double x0, double z0,
+    const HeightSource* height_source, const TerrainTileCache* tile_cache,
+    bool pack) {
+  // Map the tile from the cache if it has been generated before
+  auto start = std::chrono::steady_clock::now();
+  if (tile_cache) {
+    TerrainTileCache::Entry entry;
+    if (tile_cache->Load((GLfloat)x0, (GLfloat)z0, entry)) {
+      VertexData data;
+      data.file = std::move(entry.file);
+      data.ptexels = reinterpret_cast<const Texel*>(entry.texels);
+      data.ymin = entry.ymin;
+      data.ymax = entry.ymax;
+      data.load_times.noise = SecondsSince(start);
+      start = std::chrono::steady_clock::now();
+      ComputeLoDErrors(data.ptexels, data.lod_errors);
+      BuildHeightBounds(data.ptexels, data.height_bounds);
+      if (pack) PackTexels(data);
+      data.load_times.normals = SecondsSince(start);
+      return data;
     }
   }
 
-  // Set the texture coordinates based on largest tile size
-  GLuint nrepeat = 100; // number of texture repetitions per largest tile
-  GLuint denom = std::pow(2, num_lod_ - nrepeat + 1);
-  denom = std::max(denom, 1u);
+  // Heights and their gradients are evaluated for the whole grid in one 
+  // batch, prefiltered to the grid spacing. Positions only live here, the
+  // GPU rebuilds them from the shared grid. They are found in double 
+  // precision, so tiles sharing an edge sample it at the same locations
+  int ne = std::pow(2,num_lod_);
+  int nv = ne+1;
+  double dx = (double)l_tile_/ne;
+  std::vector<GLfloat> xs(nv*nv), zs(nv*nv), hs(nv*nv), dhdxs(nv*nv), 
+    dhdzs(nv*nv);
   for (int i = 0; i < nv; ++i) {
     for (int j = 0; j < nv; ++j) {
       GLuint ix = nv*j + i;
-      vertices_out[ix].texture[0] = (GLfloat) i / denom;
-      vertices_out[ix].texture[1] = (GLfloat) j / denom;
+      xs[ix] = x0 + dx*i;
+      zs[ix] = z0 + dx*j;
     }
   }
-  
-  // Set the centroid
-  centroid_[0] = x0 + l_tile_/2;
-  centroid_[1] = (ymin_ + ymax_)/2;
-  centroid_[2] = z0 + l_tile_/2;
+  height_source->GetHeightsAndGradients(xs.data(), zs.data(), hs.data(), 
+      dhdxs.data(), dhdzs.data(), nv*nv, (GLfloat)dx);
 
-  return vertices_out;
+  // Normals of the height field y = h(x,z)
+  VertexData data;
+  data.load_times.noise = SecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  std::vector<Texel>& texels = data.texels;
+  texels.resize(nv*nv);
+  data.ymin = std::numeric_limits<GLfloat>::max();
+  data.ymax = std::numeric_limits<GLfloat>::lowest();
+  for (int ix = 0; ix < nv*nv; ++ix) {
+    texels[ix].height = hs[ix];
+    glm::vec3 normal = glm::normalize(glm::vec3(-dhdxs[ix], 1.0f, 
+          -dhdzs[ix]));
+    for (int d = 0; d < 3; ++d) {
+      texels[ix].normal[d] = normal[d];
+    }
+    // Set the bounding box
+    data.ymin = std::min(data.ymin, texels[ix].height);
+    data.ymax = std::max(data.ymax, texels[ix].height);
+  }
+  data.ptexels = texels.data();
+  ComputeLoDErrors(data.ptexels, data.lod_errors);
+  BuildHeightBounds(data.ptexels, data.height_bounds);
+  if (pack) PackTexels(data);
+  data.load_times.normals = SecondsSince(start);
+
+  if (tile_cache) {
+    tile_cache->Store((GLfloat)x0, (GLfloat)z0, 
+        reinterpret_cast<const GLfloat*>(texels.data()), data.ymin, data.ymax);
+  }
+  return data;
+}
+  
+//****************************************************************************80
+void TerrainTile::UpdateLoD(const glm::vec3& camera_pos, GLfloat lod_scale) {
+  if (!loaded_) {
+    lods_.Set(0, num_lod_ - 1);
+    morph_ = 0.0f;
+    return;
+  }
+  // Distance to the closest point of the tile, so altitude counts
+  glm::vec3 closest = glm::clamp(camera_pos, GetAABBMinimum(), 
+      GetAABBMaximum());
+  GLfloat d_camera = glm::length(camera_pos - closest);
+  // Projected error of a level, relative to the tolerance
+  GLfloat scale = lod_scale / std::max(d_camera, 1.0e-3f);
+  unsigned short lod = 0;
+  while (lod < num_lod_ - 1 && lod_errors_[lod + 1] * scale <= 1.0f) {
+    ++lod;
+  }
+  lods_.Set(0, lod);
+  // Morph toward the next level over the last factor of 2 before switching,
+  // so the switch itself does not pop
+  if (lod < num_lod_ - 1) {
+    GLfloat rho_next = lod_errors_[lod + 1] * scale;
+    morph_ = std::min(std::max(2.0f - rho_next, 0.0f), 1.0f);
+  }
+  else {
+    morph_ = 0.0f;
+  }
 }
   
+//****************************************************************************80
+void TerrainTile::GetEdgeLoDs(std::array<GLfloat,4>& lods, 
+    std::array<GLfloat,4>& morphs) const {
+  // As for UpdateNeighborLoD, an edge without a drawn neighbor follows this
+  // tile
+  for (int k = 0; k < 4; ++k) {
+    unsigned short lod = GetLoD();
+    GLfloat level = lod + morph_;
+    const TerrainTile* neighbor = neighbor_tiles_[k];
+    if (neighbor != nullptr && neighbor->IsDrawable()) {
+      lod = std::min(lod, neighbor->GetLoD());
+      level = std::min(level, neighbor->GetLoD() + neighbor->GetMorph());
+    }
+    lods[k] = lod;
+    morphs[k] = std::min(std::max(level - lod, 0.0f), 1.0f);
+  }
+}
+
 //****************************************************************************80
 void TerrainTile::UpdateNeighborLoD() {
-  // If neighbor doesn't exist, set neighbor LoD to self LoD 
-  if (neighbor_tiles_[0] != nullptr) {
-    lods_.tuple.get<1>() = (neighbor_tiles_[0])->GetLoD();
+  // If neighbor doesn't exist (or isn't drawn yet), set neighbor LoD to self
+  if (neighbor_tiles_[0] != nullptr && neighbor_tiles_[0]->IsDrawable()) {
+    lods_.Set(1, (neighbor_tiles_[0])->GetLoD());
   }
   else {
-    lods_.tuple.get<1>() = lods_.tuple.get<0>();
+    lods_.Set(1, lods_.Get(0));
   }
-  if (neighbor_tiles_[1] != nullptr) {
-    lods_.tuple.get<2>() = (neighbor_tiles_[1])->GetLoD();
+  if (neighbor_tiles_[1] != nullptr && neighbor_tiles_[1]->IsDrawable()) {
+    lods_.Set(2, (neighbor_tiles_[1])->GetLoD());
   }
   else {
-    lods_.tuple.get<2>() = lods_.tuple.get<0>();
+    lods_.Set(2, lods_.Get(0));
   }
-  if (neighbor_tiles_[2] != nullptr) {
-    lods_.tuple.get<3>() = (neighbor_tiles_[2])->GetLoD();
+  if (neighbor_tiles_[2] != nullptr && neighbor_tiles_[2]->IsDrawable()) {
+    lods_.Set(3, (neighbor_tiles_[2])->GetLoD());
   }
   else {
-    lods_.tuple.get<3>() = lods_.tuple.get<0>();
+    lods_.Set(3, lods_.Get(0));
   }
-  if (neighbor_tiles_[3] != nullptr) {
-    lods_.tuple.get<4>() = (neighbor_tiles_[3])->GetLoD();
+  if (neighbor_tiles_[3] != nullptr && neighbor_tiles_[3]->IsDrawable()) {
+    lods_.Set(4, (neighbor_tiles_[3])->GetLoD());
   }
   else {
-    lods_.tuple.get<4>() = lods_.tuple.get<0>();
+    lods_.Set(4, lods_.Get(0));
   }
 }
 
@@ -227,16 +403,11 @@ void TerrainTile::UpdateNeighborLoD() {
 void TerrainTile::UpdateElem2Node() {
   // Ignore coarser neighbor tiles
   NeighborLoD lods = lods_;
-  lods.tuple.get<1>() = std::min(lods_.tuple.get<1>(), lods_.tuple.get<0>());
-  lods.tuple.get<2>() = std::min(lods_.tuple.get<2>(), lods_.tuple.get<0>());
-  lods.tuple.get<3>() = std::min(lods_.tuple.get<3>(), lods_.tuple.get<0>());
-  lods.tuple.get<4>() = std::min(lods_.tuple.get<4>(), lods_.tuple.get<0>());
-  pelem2node_ = &elem2node_all_[lods];
-  // Update the buffer object with new element indices
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-  void* ptr = glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
-  std::memcpy(ptr, pelem2node_->data(), sizeof(GLuint) * pelem2node_->size());
-  glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+  lods.Set(1, std::min(lods_.Get(1), lods_.Get(0)));
+  lods.Set(2, std::min(lods_.Get(2), lods_.Get(0)));
+  lods.Set(3, std::min(lods_.Get(3), lods_.Get(0)));
+  lods.Set(4, std::min(lods_.Get(4), lods_.Get(0)));
+  elem2node_range_ = Elem2NodeTable::ranges[lods.key];
 }
 
 //****************************************************************************80
@@ -244,212 +415,197 @@ void TerrainTile::SetTileLength(GLfloat l_tile) {
   l_tile_ = l_tile;
 }
 
+//****************************************************************************80
+void TerrainTile::SetOrigin(const std::array<double,2>& origin) {
+  origin_ = origin;
+}
+
+//****************************************************************************80
+void TerrainTile::SetHeightSource(const HeightSource* height_source) {
+  height_source_ = height_source;
+}
+
+//****************************************************************************80
+void TerrainTile::SetTileCache(const TerrainTileCache* tile_cache) {
+  tile_cache_ = tile_cache;
+}
+
 //****************************************************************************80
 // PRIVATE FUNCTIONS
 //****************************************************************************80
-boost::unordered_map<NeighborLoD, std::vector<GLuint>>
-TerrainTile::BuildAllElem2Node() {
-  boost::unordered_map<NeighborLoD, std::vector<GLuint>> 
-    elem2node_all;
-  // Indices follow right-hand-rule is out of the page
-  GLuint nv0 = std::pow(2, num_lod_) + 1;
-  for (unsigned short c = 0; c < num_lod_; ++c) {
-    GLuint edge_size = std::pow(2, num_lod_ - c);
-    GLuint pow2c = std::pow(2,c);
-    for (unsigned short n = 0; n <= c; ++n) {
-      for (unsigned short e = 0; e <= c; ++e) {
-        for (unsigned short s = 0; s <= c; ++s) {
-          for (unsigned short w = 0; w <= c; ++w) {
-            std::vector<GLuint> elem2node;
-            // Build the north edge
-            unsigned short num_edge_splits = std::pow(2,c-n);
-            GLuint df  = pow2c / (num_edge_splits);
-            for (GLuint i = 0; i < edge_size; ++i) {
-              GLuint j = edge_size - 1;
-              GLuint i0 = i*pow2c;
-              GLuint j0 = j*pow2c;
-              GLuint i0p = (i+1)*pow2c;
-              GLuint j0p = (j+1)*pow2c;
-              if (i < edge_size/2) {
-                // Add lower triangle
-                if (i > 0) {
-                  elem2node.push_back(nv0*j0 + i0); 
-                  elem2node.push_back(nv0*j0 + i0p);
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-                // Add upper (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*j0p + i0 + df*(f + 1));
-                  elem2node.push_back(nv0*j0p + i0 + df*f);
-                  elem2node.push_back(nv0*j0 + i0p);
-                }
-              }
-              else {
-                // Add lower triangle
-                if (i < edge_size - 1) {
-                  elem2node.push_back(nv0*j0 + i0); 
-                  elem2node.push_back(nv0*j0 + i0p);
-                  elem2node.push_back(nv0*j0p + i0p);
-                }
-                // Add upper (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*j0p + i0 + df*(f + 1));
-                  elem2node.push_back(nv0*j0p + i0 + df*f);
-                  elem2node.push_back(nv0*j0 + i0);
-                }
-              }
-            }
-            // Build the east edge
-            num_edge_splits = std::pow(2,c-e);
-            df = pow2c / (num_edge_splits);
-            for (GLuint j = 0; j < edge_size; ++j) {
-              GLuint i = edge_size - 1;
-              GLuint i0 = i*pow2c;
-              GLuint j0 = j*pow2c;
-              GLuint i0p = (i+1)*pow2c;
-              GLuint j0p = (j+1)*pow2c;
-              if (j < edge_size/2) {
-                // Add left triangle
-                if (j > 0) {
-                  elem2node.push_back(nv0*j0 + i0); 
-                  elem2node.push_back(nv0*j0 + i0p);
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-                // Add right (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*(j0+df*f) + i0p); 
-                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0p);
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-              }
-              else {
-                // Add left triangle
-                if (j < edge_size - 1) {
-                  elem2node.push_back(nv0*j0 + i0); 
-                  elem2node.push_back(nv0*j0p + i0p);
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-                // Add right (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*(j0+df*f) + i0p); 
-                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0p);
-                  elem2node.push_back(nv0*j0 + i0);
-                }
-              }
-            }
-            // Build the south edge
-            num_edge_splits = std::pow(2,c-s);
-            df  = pow2c / (num_edge_splits);
-            for (GLuint i = 0; i < edge_size; ++i) {
-              GLuint j = 0;
-              GLuint i0 = i*pow2c;
-              GLuint j0 = j*pow2c;
-              GLuint i0p = (i+1)*pow2c;
-              GLuint j0p = (j+1)*pow2c;
-              if (i < edge_size/2) {
-                // Add upper triangle
-                if (i > 0) {
-                  elem2node.push_back(nv0*j0 + i0); 
-                  elem2node.push_back(nv0*j0p + i0p);
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-                // Add lower (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*j0 + i0 + df*f); 
-                  elem2node.push_back(nv0*j0 + i0 + df*(f + 1));
-                  elem2node.push_back(nv0*j0p + i0p);
-                }
-              }
-              else {
-                // Add upper triangle
-                if (i < edge_size - 1) {
-                  elem2node.push_back(nv0*j0 + i0p); 
-                  elem2node.push_back(nv0*j0p + i0p);
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-                // Add lower (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*j0 + i0 + df*f); 
-                  elem2node.push_back(nv0*j0 + i0 + df*(f + 1));
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-              }
-            }
-            // Build the west edge
-            num_edge_splits = std::pow(2,c-w);
-            df  = pow2c / (num_edge_splits);
-            for (GLuint j = 0; j < edge_size; ++j) {
-              GLuint i = 0;
-              GLuint i0 = i*pow2c;
-              GLuint j0 = j*pow2c;
-              GLuint i0p = (i+1)*pow2c;
-              GLuint j0p = (j+1)*pow2c;
-              if (j < edge_size/2) {
-                // Add right triangle
-                if (j > 0) {
-                  elem2node.push_back(nv0*j0 + i0); 
-                  elem2node.push_back(nv0*j0 + i0p);
-                  elem2node.push_back(nv0*j0p + i0p);
-                }
-                // Add left (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*(j0+df*f) + i0); 
-                  elem2node.push_back(nv0*j0p + i0p);
-                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0);
-                }
-              }
-              else {
-                // Add right triangle
-                if (j < edge_size - 1) {
-                  elem2node.push_back(nv0*j0 + i0p);
-                  elem2node.push_back(nv0*j0p + i0p);
-                  elem2node.push_back(nv0*j0p + i0);
-                }
-                // Add left (split) triangles
-                for (GLuint f = 0; f < num_edge_splits; ++f) {
-                  elem2node.push_back(nv0*(j0+df*f) + i0);
-                  elem2node.push_back(nv0*j0 + i0p);
-                  elem2node.push_back(nv0*(j0+df*(f+1)) + i0);
-                }
-              }
-            }
-            // Build the center
-            if (c < num_lod_ - 1) {
-              for (GLuint i = 1; i < edge_size - 1; ++i) {
-                for (GLuint j = 1; j < edge_size - 1; ++j) {
-                  GLuint i0 = i*pow2c;
-                  GLuint j0 = j*pow2c;
-                  GLuint i0p = (i+1)*pow2c;
-                  GLuint j0p = (j+1)*pow2c;
-                  // Set diagonal edge orientation
-                  if ((i <  edge_size/2 && j <  edge_size/2) ||
-                      (i >= edge_size/2 && j >= edge_size/2)) {
-                    elem2node.push_back(nv0*j0 + i0);
-                    elem2node.push_back(nv0*j0p + i0p);
-                    elem2node.push_back(nv0*j0p + i0);
-                    elem2node.push_back(nv0*j0 + i0);
-                    elem2node.push_back(nv0*j0 + i0p);
-                    elem2node.push_back(nv0*j0p + i0p);
-                  }
-                  else {
-                    elem2node.push_back(nv0*j0 + i0);
-                    elem2node.push_back(nv0*j0 + i0p);
-                    elem2node.push_back(nv0*j0p + i0);
-                    elem2node.push_back(nv0*j0 + i0p);
-                    elem2node.push_back(nv0*j0p + i0p);
-                    elem2node.push_back(nv0*j0p + i0);
-                  }
-                }
-              }
-            }
-            NeighborLoD neigh_lod(c, n, e, s, w);
-            elem2node_all[neigh_lod] = elem2node;
-          }
+void TerrainTile::PackTexels(VertexData& data) {
+  GLint nv = GetNumVertices();
+  data.packed_texels.resize(nv*nv);
+  GLfloat yrange = data.ymax - data.ymin;
+  GLfloat yscale = yrange > 0.0f ? 65535.0f / yrange : 0.0f;
+  for (GLint i = 0; i < nv*nv; ++i) {
+    data.packed_texels[i] = PackTexel(data.ptexels[i], data.ymin, yscale);
+  }
+}
+
+//****************************************************************************80
+TerrainTile::PackedTexel TerrainTile::PackTexel(const Texel& t, GLfloat ymin,
+    GLfloat yscale) {
+  PackedTexel p;
+  p.height = (GLushort)std::lround((t.height - ymin) * yscale);
+  // Project the normal onto the octahedron |x|+|y|+|z| = 1 and unfold the
+  // lower half (y < 0) over the upper half in the x/z plane
+  GLfloat l1 = std::abs(t.normal[0]) + std::abs(t.normal[1]) + 
+    std::abs(t.normal[2]);
+  GLfloat u = t.normal[0] / l1;
+  GLfloat v = t.normal[2] / l1;
+  if (t.normal[1] < 0.0f) {
+    GLfloat u_fold = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+    GLfloat v_fold = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+    u = u_fold;
+    v = v_fold;
+  }
+  p.normal[0] = (GLushort)std::lround(65535.0f * (0.5f * u + 0.5f));
+  p.normal[1] = (GLushort)std::lround(65535.0f * (0.5f * v + 0.5f));
+  p.unused = 0;
+  return p;
+}
+
+//****************************************************************************80
+void TerrainTile::ComputeLoDErrors(const Texel* texels, 
+    std::array<GLfloat,num_lod_>& lod_errors) {
+  GLint ne = 1 << num_lod_;
+  GLint nv = ne + 1;
+  lod_errors[0] = 0.0f;
+  for (unsigned short c = 1; c < num_lod_; ++c) {
+    GLint step = 1 << c;
+    GLint edge_size = ne / step;
+    GLfloat error = 0.0f;
+    for (GLint j = 0; j < nv; ++j) {
+      for (GLint i = 0; i < nv; ++i) {
+        // Coarse cell containing this vertex and local coordinates in it
+        GLint ci = std::min(i / step, edge_size - 1);
+        GLint cj = std::min(j / step, edge_size - 1);
+        GLfloat u = (GLfloat)(i - ci*step) / step;
+        GLfloat v = (GLfloat)(j - cj*step) / step;
+        GLfloat h00 = texels[nv*(cj*step) + ci*step].height;
+        GLfloat h10 = texels[nv*(cj*step) + (ci+1)*step].height;
+        GLfloat h01 = texels[nv*((cj+1)*step) + ci*step].height;
+        GLfloat h11 = texels[nv*((cj+1)*step) + (ci+1)*step].height;
+        // Same diagonal orientation as the center in BuildAllElem2Node()
+        GLfloat h;
+        if ((ci < edge_size/2) == (cj < edge_size/2)) {
+          if (u >= v) h = h00 + u*(h10 - h00) + v*(h11 - h10);
+          else        h = h00 + v*(h01 - h00) + u*(h11 - h01);
+        }
+        else {
+          if (u + v <= 1.0f) h = h00 + u*(h10 - h00) + v*(h01 - h00);
+          else h = h11 + (1.0f - u)*(h01 - h11) + (1.0f - v)*(h10 - h11);
         }
+        error = std::max(error, std::abs(h - texels[nv*j + i].height));
       }
     }
+    lod_errors[c] = std::max(error, lod_errors[c-1]);
+  }
+}
+
+//****************************************************************************80
+void TerrainTile::BuildHeightBounds(const Texel* texels, 
+    std::vector<std::array<GLfloat,2>>& height_bounds) {
+  GLint ne = 1 << num_lod_;
+  GLint nv = ne + 1;
+  height_bounds.resize(GetHeightBoundsOffset(num_lod_ + 1));
+  // Cells bound the bilinear surface by their corner heights
+  for (GLint j = 0; j < ne; ++j) {
+    for (GLint i = 0; i < ne; ++i) {
+      GLfloat h00 = texels[nv*j + i].height;
+      GLfloat h10 = texels[nv*j + i + 1].height;
+      GLfloat h01 = texels[nv*(j+1) + i].height;
+      GLfloat h11 = texels[nv*(j+1) + i + 1].height;
+      height_bounds[ne*j + i] = {{std::min(std::min(h00, h10), 
+          std::min(h01, h11)), std::max(std::max(h00, h10), 
+          std::max(h01, h11))}};
+    }
+  }
+  // Each coarser block bounds its four children
+  for (int level = 1; level <= num_lod_; ++level) {
+    const std::array<GLfloat,2>* fine = &height_bounds[
+      GetHeightBoundsOffset(level - 1)];
+    std::array<GLfloat,2>* coarse = &height_bounds[
+      GetHeightBoundsOffset(level)];
+    GLint n_fine = ne >> (level - 1);
+    GLint n_coarse = ne >> level;
+    for (GLint j = 0; j < n_coarse; ++j) {
+      for (GLint i = 0; i < n_coarse; ++i) {
+        const std::array<GLfloat,2>& b00 = fine[n_fine*(2*j) + 2*i];
+        const std::array<GLfloat,2>& b10 = fine[n_fine*(2*j) + 2*i + 1];
+        const std::array<GLfloat,2>& b01 = fine[n_fine*(2*j+1) + 2*i];
+        const std::array<GLfloat,2>& b11 = fine[n_fine*(2*j+1) + 2*i + 1];
+        coarse[n_coarse*j + i] = {{
+          std::min(std::min(b00[0], b10[0]), std::min(b01[0], b11[0])),
+          std::max(std::max(b00[1], b10[1]), std::max(b01[1], b11[1]))}};
+      }
+    }
+  }
+}
+
+//****************************************************************************80
+bool TerrainTile::IntersectCell(int i, int j, const glm::vec3& origin, 
+    const glm::vec3& dir, GLfloat t0, GLfloat t1, GLfloat& t_hit) const {
+  GLint nv = GetNumVertices();
+  GLfloat dx = l_tile_ / (nv - 1);
+  GLfloat h00 = heights_[nv*j + i];
+  GLfloat h10 = heights_[nv*j + i + 1];
+  GLfloat h01 = heights_[nv*(j+1) + i];
+  GLfloat h11 = heights_[nv*(j+1) + i + 1];
+  // Local cell coordinates at t0 and their rates, the height above the 
+  // surface is then quadratic in s = t - t0: f(s) = a*s^2 + b*s + c
+  glm::vec2 corner = GetLocalCorner();
+  GLfloat u = (origin[0] + dir[0] * t0 - corner[0]) / dx - i;
+  GLfloat v = (origin[2] + dir[2] * t0 - corner[1]) / dx - j;
+  GLfloat du = dir[0] / dx;
+  GLfloat dv = dir[2] / dx;
+  GLfloat hu = h10 - h00;
+  GLfloat hv = h01 - h00;
+  GLfloat huv = h00 - h10 - h01 + h11;
+  GLfloat a = -huv * du * dv;
+  GLfloat b = dir[1] - hu * du - hv * dv - huv * (u * dv + v * du);
+  GLfloat c = origin[1] + dir[1] * t0 - (h00 + hu * u + hv * v + huv * u * v);
+  if (c <= 0.0f) {
+    // Starts on or below the surface
+    t_hit = t0;
+    return true;
+  }
+  GLfloat s_max = t1 - t0;
+  GLfloat s;
+  if (std::abs(a) <= 1.0e-6f * std::abs(b)) {
+    if (b >= 0.0f) return false;
+    s = -c / b;
+  }
+  else {
+    GLfloat disc = b * b - 4.0f * a * c;
+    if (disc < 0.0f) return false;
+    // Roots without cancellation, the smaller nonnegative one is the first
+    // crossing (c > 0, so no root is at s = 0)
+    GLfloat q = -0.5f * (b + std::copysign(std::sqrt(disc), b));
+    GLfloat s0 = q / a;
+    GLfloat s1 = c / q;
+    if (s0 > s1) std::swap(s0, s1);
+    s = s0 >= 0.0f ? s0 : s1;
+    if (s < 0.0f) return false;
+  }
+  if (s > s_max) return false;
+  t_hit = t0 + s;
+  return true;
+}
+
+//****************************************************************************80
+void TerrainTile::GetGridCoordinates(float x, float z, std::array<int,2>& ix, 
+    std::array<float,2>& s) const {
+  int ne = std::pow(2,num_lod_);
+  GLfloat dx = l_tile_/ne;
+  glm::vec2 corner = GetLocalCorner();
+  std::array<float,2> u = {{(x - corner[0]) / dx, (z - corner[1]) / dx}};
+  for (int d = 0; d < 2; ++d) {
+    u[d] = std::min(std::max(u[d], 0.0f), (float)ne);
+    ix[d] = std::min((int)u[d], ne - 1);
+    s[d] = u[d] - ix[d];
   }
-  return elem2node_all;
 }
 
 } // End namespace TopFun
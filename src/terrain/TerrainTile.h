@@ -3,35 +3,146 @@
 
 #include <vector>
 #include <array>
+#include <future>
+#include <limits>
 
-#include <boost/unordered_map.hpp>
-
+#include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "shaders/Shader.h"
-#include "render/Camera.h"
 #include "terrain/NeighborLoD.h"
+#include "terrain/TerrainElem2Node.h"
+#include "terrain/TerrainTileCache.h"
+#include "terrain/HeightSource.h"
+#include "utils/ThreadPool.h"
+#include "utils/MappedFile.h"
 
 namespace TopFun {
 
 class TerrainTile {
 
  public:
+  // Seconds spent in each stage of loading a tile
+  struct LoadTimes {
+    double noise; // sampling the height source (or mapping the cached tile)
+    double normals; // normals, LoD errors, height bounds and packing
+    double upload; // copying to the CPU-side grids and the height map
+  };
+
+  //**************************************************************************80
+  //! \brief TerrainTile - Constructor, queues vertex generation on the pool
+  //! \param[in] pack - also quantize the texels for a height map, kept until
+  //! UploadTexels. Otherwise the tile only keeps the CPU-side grids
+  //! \param[in] slot - index of the ring slot this tile occupies
+  //! \param[in] texel_offset - texel of the height map holding vertex (0,0)
+  //! \param[in] x0 - world x coordinate of the tile corner
+  //! \param[in] z0 - world z coordinate of the tile corner
+  //! \param[in] thread_pool - pool that generates the vertex data
+  //**************************************************************************80
+  TerrainTile(bool pack, GLint slot, const std::array<GLint,2>& texel_offset,
+      double x0, double z0, ThreadPool& thread_pool);
+  
+  TerrainTile(const TerrainTile&) = delete;
+  TerrainTile& operator=(const TerrainTile&) = delete;
+  
+  //**************************************************************************80
+  //! \brief Relocate - reuse this tile (and its height map texels) for a new 
+  //! location, queueing vertex generation on the pool
+  //! \param[in] x0 - world x coordinate of the tile corner
+  //! \param[in] z0 - world z coordinate of the tile corner
+  //! \param[in] thread_pool - pool that generates the vertex data
+  //**************************************************************************80
+  void Relocate(double x0, double z0, ThreadPool& thread_pool);
+
+  //**************************************************************************80
+  //! \brief GetDrawCommand - updates the stitching for the current neighbor
+  //! LoDs and returns the arguments to draw this tile with (the tile must be
+  //! drawable)
+  //! \param[out] count - number of indices
+  //! \param[out] indices - byte offset into the shared element array buffer
+  //! \param[out] base_vertex - first vertex of this tile's slot
+  //**************************************************************************80
+  void GetDrawCommand(GLsizei& count, GLvoid*& indices, GLint& base_vertex);
+
+  //**************************************************************************80
+  //! \brief MultiDraw - draws a batch of tiles in a single call
+  //! \param[in] counts - number of indices of each tile
+  //! \param[in] indices - byte offsets into the shared element array buffer
+  //! \param[in] base_vertices - first vertex of each tile's slot
+  //**************************************************************************80
+  static void MultiDraw(const std::vector<GLsizei>& counts, 
+      const std::vector<GLvoid*>& indices, 
+      const std::vector<GLint>& base_vertices);
+
+  //**************************************************************************80
+  //! \brief CreateSharedObjects - creates the VAO and EBO all tiles draw 
+  //! with, on the first call (needs a GL context)
+  //**************************************************************************80
+  static void CreateSharedObjects();
+
+  //**************************************************************************80
+  //! \brief DeleteSharedObjects - deletes the shared VAO and EBO, once every
+  //! call to CreateSharedObjects has been matched
+  //**************************************************************************80
+  static void DeleteSharedObjects();
+
+  //**************************************************************************80
+  //! \brief FinishLoading - copies the vertex data to the CPU-side grids 
+  //! once the worker thread has finished generating it
+  //! \param[in] wait - block until the vertex data is ready
+  //! \returns true if the tile was loaded by this call
+  //**************************************************************************80
+  bool FinishLoading(bool wait = false);
+
+  //**************************************************************************80
+  //! \brief UploadTexels - uploads the packed texels of a loaded tile to its
+  //! slot of the height map and frees them (needs a GL context)
+  //! \param[in] height_map - texture holding the height and normal of every
+  //! tile
+  //**************************************************************************80
+  void UploadTexels(GLuint height_map);
+
   //**************************************************************************80
-  //! \brief TerrainTile - Constructor
+  //! \brief UploadPlaceholder - samples the height source at the vertices of
+  //! the coarsest LoD and uploads their bilinear interpolant, so the tile 
+  //! can be drawn (at that LoD) while the worker generates its vertex data
+  //! (needs a GL context)
+  //! \param[in] height_map - texture holding the height and normal of every
+  //! tile
   //**************************************************************************80
-  TerrainTile(const Shader& shader, GLfloat x0, GLfloat z0);
+  void UploadPlaceholder(GLuint height_map);
   
   //**************************************************************************80
-  //! \brief ~TerrainTile - Destructor
+  //! \brief IsLoaded - returns true once the vertex data has been generated
   //**************************************************************************80
-  ~TerrainTile();
+  inline bool IsLoaded() const { return loaded_; }
 
   //**************************************************************************80
-  //! \brief Draw - Draws the terrain tile
+  //! \brief IsDrawable - returns true once the height map holds this tile's
+  //! location, either its placeholder or the loaded texels. The owner of the
+  //! height map uploads the texels as soon as the tile is loaded
   //**************************************************************************80
-  void Draw();
+  inline bool IsDrawable() const { return loaded_ || placeholder_; }
+
+  //**************************************************************************80
+  //! \brief GetLoadTimes - returns the time spent in each stage of the last 
+  //! load of this tile (valid once it is loaded)
+  //**************************************************************************80
+  inline const LoadTimes& GetLoadTimes() const { return load_times_; }
+  
+  //**************************************************************************80
+  //! \brief Raycast - find where a ray first hits the tile surface (the 
+  //! bilinear interpolant of GetHeight), descending the min/max height 
+  //! pyramid so cells the ray passes above or below are skipped in blocks
+  //! \param[in] origin - start of the ray, relative to the origin
+  //! \param[in] dir - direction of the ray
+  //! \param[in] t_min - start of the searched interval, in units of dir
+  //! \param[in] t_max - end of the searched interval, in units of dir
+  //! \param[out] t_hit - ray parameter of the hit
+  //! \returns true if the ray hits the tile within [t_min, t_max]
+  //**************************************************************************80
+  bool Raycast(const glm::vec3& origin, const glm::vec3& dir, GLfloat t_min,
+      GLfloat t_max, GLfloat& t_hit) const;
   
   //**************************************************************************80
   //! \brief SetNeighborPointer - sets pointers to a neighbor tile
@@ -46,20 +157,36 @@ class TerrainTile {
   //! \brief GetLoD - returns the current level of detail for this tile
   //**************************************************************************80
   inline unsigned short GetLoD() const {
-    return lods_.tuple.get<0>();
+    return lods_.Get(0);
   }
   
   //**************************************************************************80
-  //! \brief UpdateLoD - sets the level of detail for this tile
+  //! \brief UpdateLoD - sets the level of detail for this tile to the 
+  //! coarsest level whose geometric error, projected to the screen, is within
+  //! the tolerance, and the morph factor toward the next coarser level
+  //! \param[in] camera_pos - position of the camera, relative to the origin
+  //! \param[in] lod_scale - pixels per unit of error at unit distance, 
+  //! divided by the pixel tolerance
   //**************************************************************************80
-  inline void UpdateLoD(const glm::vec3& camera_pos) {
-    GLfloat r_max = 10*l_tile_;
-    GLfloat d_camera = std::sqrt(
-        (camera_pos[0] - centroid_[0]) * (camera_pos[0] - centroid_[0]) +
-        (camera_pos[2] - centroid_[2]) * (camera_pos[2] - centroid_[2]));
-    GLuint lod = GLuint(d_camera / r_max * num_lod_);
-    lods_.tuple.get<0>() = std::min(lod, GLuint(num_lod_ - 1));
-  }
+  void UpdateLoD(const glm::vec3& camera_pos, GLfloat lod_scale);
+  
+  //**************************************************************************80
+  //! \brief GetMorph - returns how far the vertices have morphed toward the
+  //! next coarser level of detail (0 to 1)
+  //**************************************************************************80
+  inline GLfloat GetMorph() const { return morph_; }
+
+  //**************************************************************************80
+  //! \brief GetEdgeLoDs - get the LoD each edge is drawn at, the finer of 
+  //! this tile and the neighbor across it, and how far its vertices have 
+  //! morphed toward the next coarser level, the lesser of the two tiles' 
+  //! LoD plus morph factor. Both tiles find the same values, so the edge 
+  //! stays watertight while it morphs
+  //! \param[out] lods - LoD of each edge (N, E, S, W)
+  //! \param[out] morphs - morph factor of each edge (0 to 1)
+  //**************************************************************************80
+  void GetEdgeLoDs(std::array<GLfloat,4>& lods, 
+      std::array<GLfloat,4>& morphs) const;
 
   //**************************************************************************80
   //! \brief UpdateNeighborLoD - updates the values of neighbor LoDs
@@ -71,53 +198,271 @@ class TerrainTile {
   //! \param[in] l_tile - physical dimension of the tile edges
   //**************************************************************************80
   static void SetTileLength(GLfloat l_tile);
+  
+  //**************************************************************************80
+  //! \brief SetOrigin - sets the world x/z location that tile positions, 
+  //! bounding boxes and queries are relative to, so they stay small in 
+  //! single precision however far the tiles are from the world origin
+  //! \param[in] origin - world x/z location of the origin
+  //**************************************************************************80
+  static void SetOrigin(const std::array<double,2>& origin);
+  
+  //**************************************************************************80
+  //! \brief SetHeightSource - sets the height source tiles are generated from
+  //! \param[in] height_source - pointer to the source. Tiles queued 
+  //! afterwards use it, so it must outlive their thread pool
+  //**************************************************************************80
+  static void SetHeightSource(const HeightSource* height_source);
+  
+  //**************************************************************************80
+  //! \brief SetTileCache - sets the cache tiles are loaded from and stored to
+  //! \param[in] tile_cache - pointer to the cache, null to always generate.
+  //! Tiles queued afterwards use it, so it must outlive their thread pool
+  //**************************************************************************80
+  static void SetTileCache(const TerrainTileCache* tile_cache);
+  
+  //**************************************************************************80
+  //! \brief GetNumVertices - number of vertices along each tile edge
+  //**************************************************************************80
+  static inline GLint GetNumVertices() { return (1 << num_lod_) + 1; }
+  
+  //**************************************************************************80
+  //! \brief GetGridSpacing - distance between vertices at the finest LoD
+  //**************************************************************************80
+  static inline GLfloat GetGridSpacing() { return l_tile_ / (1 << num_lod_); }
 
   //**************************************************************************80
-  //! \brief GetBoundingHeight - get the maximum height in this tile
+  //! \brief GetBoundingHeight - get the maximum height in this tile, or the 
+  //! largest float if the tile has not been generated yet
   //**************************************************************************80
-  inline float GetBoundingHeight() const { return ymax_; }
+  inline float GetBoundingHeight() const { 
+    return loaded_ ? ymax_ : std::numeric_limits<float>::max();
+  }
+  
+  //**************************************************************************80
+  //! \brief GetMaxHeight - get the maximum height of the tile surface over a
+  //! rectangle, to the resolution of single grid cells. The largest float if
+  //! the tile has not been generated yet, the lowest if the rectangle misses
+  //! the tile
+  //! \param[in] x0, z0 - minimum corner relative to the origin
+  //! \param[in] x1, z1 - maximum corner relative to the origin
+  //**************************************************************************80
+  float GetMaxHeight(float x0, float z0, float x1, float z1) const;
+  
+  //**************************************************************************80
+  //! \brief GetCorner - get the world x/z location of the tile corner
+  //**************************************************************************80
+  inline std::array<double,2> GetCorner() const { return {{x0_, z0_}}; }
+
+  //**************************************************************************80
+  //! \brief GetAABBMinimum - get the minimum corner of the tile bounding box,
+  //! relative to the origin
+  //**************************************************************************80
+  inline glm::vec3 GetAABBMinimum() const { 
+    glm::vec2 corner = GetLocalCorner();
+    return glm::vec3(corner[0], ymin_, corner[1]); 
+  }
+  
+  //**************************************************************************80
+  //! \brief GetAABBMaximum - get the maximum corner of the tile bounding box,
+  //! relative to the origin
+  //**************************************************************************80
+  inline glm::vec3 GetAABBMaximum() const { 
+    glm::vec2 corner = GetLocalCorner();
+    return glm::vec3(corner[0] + l_tile_, ymax_, corner[1] + l_tile_); 
+  }
+  
+  //**************************************************************************80
+  //! \brief GetHeight - bilinearly interpolate the height from the tile grid
+  //! \param[in] x - x location relative to the origin (clamped to the tile)
+  //! \param[in] z - z location relative to the origin (clamped to the tile)
+  //**************************************************************************80
+  float GetHeight(float x, float z) const;
+  
+  //**************************************************************************80
+  //! \brief GetNormal - bilinearly interpolate the normal from the tile grid
+  //! \param[in] x - x location relative to the origin (clamped to the tile)
+  //! \param[in] z - z location relative to the origin (clamped to the tile)
+  //**************************************************************************80
+  glm::vec3 GetNormal(float x, float z) const;
 
  private:
-  GLuint VAO_, EBO_;
+  // All tiles share one VAO with no vertex attributes. The vertex shader
+  // finds the slot and grid location from gl_VertexID (offset by the base 
+  // vertex of each tile), and reads height and normal from the height map
+  static GLuint VAO_;
+  bool pack_; // quantize the texels for the height map
+  GLint base_vertex_; // slot * GetNumVertices()^2
+  std::array<GLint,2> texel_offset_; // of this tile in the height map
   static GLfloat l_tile_; // length of the tile edge
-  glm::vec3 centroid_;
+  static const HeightSource* height_source_;
+  static const TerrainTileCache* tile_cache_; // null if caching is off
+  // World x/z location all tile positions are relative to
+  static std::array<double,2> origin_;
+  double x0_, z0_; // world location of the tile corner
+  // CPU-side copies of the vertex grid for physics queries
+  std::vector<GLfloat> heights_;
+  std::vector<glm::vec3> normals_;
+  // Min/max height of blocks of 2^l x 2^l grid cells, level l = 0 (single
+  // cells) first. The last level is the whole tile
+  std::vector<std::array<GLfloat,2>> height_bounds_;
   GLfloat ymax_, ymin_; // for bounding box
-  static const unsigned short num_lod_ = 6; // higher is coarser
+  static const unsigned short num_lod_ = terrain_num_lod; // higher is coarser
+  // Maximum height error of each level of detail relative to the finest
+  std::array<GLfloat,num_lod_> lod_errors_;
+  GLfloat morph_; // toward the next coarser level of detail
   NeighborLoD lods_; // current level of detail of this tile and neighbors
-  NeighborLoD lods_prev_; // level of detail on last Draw()
+  NeighborLoD lods_prev_; // level of detail on last GetDrawCommand()
   // Pointers to NESW tiles, null if no neighbor exists
   std::array<const TerrainTile*,4> neighbor_tiles_;
   // Element-to-node connectivities for all possible combinations of tile LOD
-  // and surrounding tile LODs
-  static boost::unordered_map<NeighborLoD, std::vector<GLuint>> elem2node_all_;
-  // Pointer to current elem2node for this tile
-  std::vector<GLuint>* pelem2node_;
+  // and surrounding tile LODs (Elem2NodeTable) are uploaded once into an 
+  // immutable EBO shared by every tile
+  static GLuint EBO_;
+  // Calls to CreateSharedObjects not yet matched by DeleteSharedObjects
+  static unsigned num_shared_users_;
+  // Range of the shared EBO drawn for the current LoDs of this tile
+  Elem2NodeRange elem2node_range_;
  
-  // Helper struct for storing vertex attributes 
-  struct Vertex {
-    GLfloat position[3];
+  // Height and normal of one vertex, as generated and cached
+  struct Texel {
+    GLfloat height;
     GLfloat normal[3];
-    GLfloat texture[2];
   };
 
+  // Height map texel of one vertex as uploaded: height quantized to the 
+  // tile's [ymin, ymax] and octahedral encoded normal, all unsigned 
+  // normalized
+  struct PackedTexel {
+    GLushort height;
+    GLushort normal[2];
+    GLushort unused;
+  };
+  
+  // Output of the vertex generation job
+  struct VertexData {
+    std::vector<Texel> texels; // generated texels (empty if cached)
+    MappedFile file; // mapped texels (closed if generated)
+    const Texel* ptexels; // points into either of the above
+    std::vector<PackedTexel> packed_texels; // empty if not packed
+    std::vector<std::array<GLfloat,2>> height_bounds;
+    GLfloat ymin, ymax;
+    std::array<GLfloat,num_lod_> lod_errors;
+    LoadTimes load_times; // of the stages run on the worker
+  };
+  std::future<VertexData> vertex_data_; // pending until generation finishes
+  std::vector<PackedTexel> packed_texels_; // loaded, not yet uploaded
+  bool loaded_; // true once vertex data has been loaded
+  bool placeholder_; // coarsest LoD vertices sampled while loading
+  LoadTimes load_times_;
+
+  //**************************************************************************80
+  //! \brief SetupVertices - computes heights and normals, or maps them from
+  //! the tile cache. Only touches static data, so it is safe to call from a 
+  //! worker thread
+  //! \param[in] x0 - world x coordinate of the tile corner
+  //! \param[in] z0 - world z coordinate of the tile corner
+  //! \param[in] height_source - source to sample the heights from
+  //! \param[in] tile_cache - cache to load from and store to, may be null
+  //! \param[in] pack - quantize the texels for the height map
+  //**************************************************************************80
+  static VertexData SetupVertices(double x0, double z0, 
+      const HeightSource* height_source, const TerrainTileCache* tile_cache,
+      bool pack);
+  
+  //**************************************************************************80
+  //! \brief PackTexels - quantizes texels for upload to the height map
+  //! \param[in,out] data - vertex data, packed_texels is filled in
+  //**************************************************************************80
+  static void PackTexels(VertexData& data);
+
+  //**************************************************************************80
+  //! \brief PackTexel - quantizes one texel for upload to the height map
+  //! \param[in] t - texel to pack
+  //! \param[in] ymin - height packed to 0
+  //! \param[in] yscale - packed units per unit of height
+  //**************************************************************************80
+  static PackedTexel PackTexel(const Texel& t, GLfloat ymin, GLfloat yscale);
+
+  //**************************************************************************80
+  //! \brief ComputeLoDErrors - computes the maximum height error of each 
+  //! level of detail, interpolating the finest heights over the triangles of
+  //! the coarser level (nondecreasing with level)
+  //! \param[in] texels - height map texels of the tile
+  //! \param[out] lod_errors - error of each level of detail
+  //**************************************************************************80
+  static void ComputeLoDErrors(const Texel* texels, 
+      std::array<GLfloat,num_lod_>& lod_errors);
+
+  //**************************************************************************80
+  //! \brief GetLocalCorner - get the tile corner relative to the origin
+  //**************************************************************************80
+  inline glm::vec2 GetLocalCorner() const {
+    return glm::vec2(x0_ - origin_[0], z0_ - origin_[1]);
+  }
+
+  //**************************************************************************80
+  //! \brief BuildHeightBounds - builds the min/max height pyramid
+  //! \param[in] texels - height map texels of the tile
+  //! \param[out] height_bounds - min/max height of each block of each level
+  //**************************************************************************80
+  static void BuildHeightBounds(const Texel* texels, 
+      std::vector<std::array<GLfloat,2>>& height_bounds);
+
+  //**************************************************************************80
+  //! \brief GetHeightBoundsOffset - index of the first block of a pyramid 
+  //! level in height_bounds_
+  //**************************************************************************80
+  static inline int GetHeightBoundsOffset(int level) {
+    // Level k has 4^(num_lod_-k) blocks
+    int offset = 0;
+    for (int k = 0; k < level; ++k) {
+      offset += 1 << (2 * (num_lod_ - k));
+    }
+    return offset;
+  }
+
+  //**************************************************************************80
+  //! \brief IntersectCell - intersect a ray with the bilinear surface over
+  //! one grid cell
+  //! \param[in] i, j - index of the lower left vertex of the cell
+  //! \param[in] origin - start of the ray
+  //! \param[in] dir - direction of the ray
+  //! \param[in] t0, t1 - interval of the ray over the cell
+  //! \param[out] t_hit - first ray parameter on the surface
+  //! \returns true if the ray reaches the surface within [t0, t1]
+  //**************************************************************************80
+  bool IntersectCell(int i, int j, const glm::vec3& origin, 
+      const glm::vec3& dir, GLfloat t0, GLfloat t1, GLfloat& t_hit) const;
+
   //**************************************************************************80
-  //! \brief SetupVertices - computes positions, normals, etc. 
+  //! \brief GetGridCoordinates - find the grid cell containing some location
+  //! \param[in] x - x location
+  //! \param[in] z - z location
+  //! \param[out] ix - index of the lower left vertex of the cell
+  //! \param[out] s - local coordinates in the cell
   //**************************************************************************80
-  std::vector<Vertex> SetupVertices(GLfloat x0, GLfloat z0);  
+  void GetGridCoordinates(float x, float z, std::array<int,2>& ix, 
+      std::array<float,2>& s) const;
 
   //**************************************************************************80
-  //! \brief UpdateElem2Node() - updates the element array buffer with the 
-  //! current element-to-node connectivity based on neighbor's LoD values
+  //! \brief UpdateElem2Node() - selects the range of the shared element array
+  //! buffer for the current element-to-node connectivity based on neighbor's 
+  //! LoD values
   //**************************************************************************80
   void UpdateElem2Node();
 
   //**************************************************************************80
-  //! \brief BuildAllElem2Node - precomputes all possible element-to-node
-  //! connectivities for all possible tile LODs and surrounding tile LODs 
+  //! \brief CreateElem2NodeBuffer - uploads all element-to-node connectivities
+  //! into the shared element array buffer
   //**************************************************************************80
-  static boost::unordered_map<NeighborLoD, std::vector<GLuint>> 
-    BuildAllElem2Node();
-  
+  static void CreateElem2NodeBuffer();
+
+  //**************************************************************************80
+  //! \brief CreateVertexArray - creates the shared VAO
+  //**************************************************************************80
+  static void CreateVertexArray();
+
 };
 } // End namespace TopFun
 
@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include "terrain/TerrainTileCache.h"
+
+namespace TopFun {
+
+namespace {
+//****************************************************************************80
+//! \brief HashBytes - 64 bit FNV-1a hash
+//! \param[in] data - bytes to hash
+//! \param[in] n - number of bytes
+//! \param[in] hash - running hash value
+//****************************************************************************80
+std::uint64_t HashBytes(const void* data, std::size_t n, 
+    std::uint64_t hash = 14695981039346656037ull) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0; i < n; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+//****************************************************************************80
+//! \brief FloatBits - bit pattern of a float, for exact file names
+//****************************************************************************80
+std::uint32_t FloatBits(GLfloat f) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+} // End anonymous namespace
+
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+TerrainTileCache::TerrainTileCache(const std::string& directory, 
+    const std::string& key, GLfloat l_tile, GLint num_vertices) : 
+  directory_(directory), l_tile_(l_tile), num_vertices_(num_vertices) {
+  if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::string message = "Could not create tile cache directory " + 
+      directory_ + "\n";
+    throw std::invalid_argument(message);
+  }
+  key_hash_ = HashBytes(key.data(), key.size());
+  key_hash_ = HashBytes(&l_tile_, sizeof(l_tile_), key_hash_);
+  key_hash_ = HashBytes(&num_vertices_, sizeof(num_vertices_), key_hash_);
+}
+
+//****************************************************************************80
+bool TerrainTileCache::Load(GLfloat x0, GLfloat z0, Entry& entry) const {
+  MappedFile file(GetPath(x0, z0));
+  if (!file.IsOpen() || file.GetSize() != sizeof(Header) + GetTexelBytes()) {
+    return false;
+  }
+  Header header;
+  std::memcpy(&header, file.GetData(), sizeof(Header));
+  if (std::memcmp(header.magic, "TFTC", 4) != 0 || 
+      header.version != version_ || header.key_hash != key_hash_ || 
+      header.l_tile != l_tile_ || header.num_vertices != num_vertices_ ||
+      header.x0 != x0 || header.z0 != z0) {
+    return false;
+  }
+  entry.texels = reinterpret_cast<const GLfloat*>(
+      static_cast<const char*>(file.GetData()) + sizeof(Header));
+  entry.ymin = header.ymin;
+  entry.ymax = header.ymax;
+  entry.file = std::move(file);
+  return true;
+}
+
+//****************************************************************************80
+void TerrainTileCache::Store(GLfloat x0, GLfloat z0, const GLfloat* texels, 
+    GLfloat ymin, GLfloat ymax) const {
+  Header header;
+  std::memcpy(header.magic, "TFTC", 4);
+  header.version = version_;
+  header.key_hash = key_hash_;
+  header.l_tile = l_tile_;
+  header.num_vertices = num_vertices_;
+  header.x0 = x0;
+  header.z0 = z0;
+  header.ymin = ymin;
+  header.ymax = ymax;
+
+  // Write to a file unique to this thread, then rename it into place so a
+  // reader never maps a partially written tile
+  std::string path = GetPath(x0, z0);
+  std::ostringstream tmp_path;
+  tmp_path << path << ".tmp" << std::hash<std::thread::id>()(
+      std::this_thread::get_id());
+  std::FILE* file = std::fopen(tmp_path.str().c_str(), "wb");
+  if (!file) return;
+  bool ok = std::fwrite(&header, sizeof(Header), 1, file) == 1 &&
+    std::fwrite(texels, GetTexelBytes(), 1, file) == 1;
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok || std::rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.str().c_str());
+  }
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+std::string TerrainTileCache::GetPath(GLfloat x0, GLfloat z0) const {
+  std::ostringstream path;
+  path << directory_ << "/" << std::hex << std::setfill('0') 
+    << std::setw(16) << key_hash_ << "_" 
+    << std::setw(8) << FloatBits(x0) << "_" 
+    << std::setw(8) << FloatBits(z0) << ".tile";
+  return path.str();
+}
+
+} // End namespace TopFun
@@ -0,0 +1,98 @@
+#ifndef TERRAINTILECACHE_H
+#define TERRAINTILECACHE_H
+
+#include <string>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+#include "utils/MappedFile.h"
+
+// Directory of generated terrain tiles. Each tile is one binary file holding
+// a header (tile location, grid size, height key and bounds) followed by the
+// height map texels of its vertices. Files are named by a hash of the tile
+// length, grid size and height function key plus the bits of the tile corner,
+// and the header is checked on load, so a change to any of these regenerates
+// the tile instead of loading stale data.
+
+namespace TopFun {
+
+class TerrainTileCache {
+
+ public:
+  // A tile loaded from the cache
+  struct Entry {
+    MappedFile file; // keeps the texels mapped
+    const GLfloat* texels; // 4 floats (height, normal) per vertex
+    GLfloat ymin, ymax;
+  };
+
+  //**************************************************************************80
+  //! \brief TerrainTileCache - Constructor, creates the directory if needed
+  //! \param[in] directory - directory holding the tile files
+  //! \param[in] key - identifies the height function the tiles sample
+  //! \param[in] l_tile - length of the tile edge
+  //! \param[in] num_vertices - number of vertices along a tile edge
+  //**************************************************************************80
+  TerrainTileCache(const std::string& directory, const std::string& key, 
+      GLfloat l_tile, GLint num_vertices);
+  
+  //**************************************************************************80
+  //! \brief ~TerrainTileCache - Destructor
+  //**************************************************************************80
+  ~TerrainTileCache() = default;
+
+  //**************************************************************************80
+  //! \brief Load - map a tile from the cache. Safe to call from any thread
+  //! \param[in] x0 - x coordinate of the tile corner
+  //! \param[in] z0 - z coordinate of the tile corner
+  //! \param[out] entry - the mapped tile
+  //! \returns true if the tile was found and is valid
+  //**************************************************************************80
+  bool Load(GLfloat x0, GLfloat z0, Entry& entry) const;
+  
+  //**************************************************************************80
+  //! \brief Store - write a tile to the cache, failures are ignored since the
+  //! tile can always be regenerated. Safe to call from any thread
+  //! \param[in] x0 - x coordinate of the tile corner
+  //! \param[in] z0 - z coordinate of the tile corner
+  //! \param[in] texels - 4 floats (height, normal) per vertex
+  //! \param[in] ymin - minimum height in the tile
+  //! \param[in] ymax - maximum height in the tile
+  //**************************************************************************80
+  void Store(GLfloat x0, GLfloat z0, const GLfloat* texels, GLfloat ymin, 
+      GLfloat ymax) const;
+
+ private:
+  // Start of every tile file
+  struct Header {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t key_hash;
+    GLfloat l_tile;
+    GLint num_vertices;
+    GLfloat x0, z0;
+    GLfloat ymin, ymax;
+  };
+  static const std::uint32_t version_ = 2;
+  std::string directory_;
+  std::uint64_t key_hash_; // of the key, tile length and grid size
+  GLfloat l_tile_;
+  GLint num_vertices_;
+  
+  //**************************************************************************80
+  //! \brief GetPath - get the path of the file holding a tile
+  //**************************************************************************80
+  std::string GetPath(GLfloat x0, GLfloat z0) const;
+  
+  //**************************************************************************80
+  //! \brief GetTexelBytes - size of the texels of a tile in bytes
+  //**************************************************************************80
+  inline std::size_t GetTexelBytes() const {
+    return 4 * sizeof(GLfloat) * num_vertices_ * num_vertices_;
+  }
+
+};
+} // End namespace TopFun
+
+#endif
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <chrono>
+
+#include "terrain/TerrainTile.h"
+
+// Functions of TerrainTile that need a GL context, built only into the 
+// terrain library, so the terrain core links without GL
+
+namespace TopFun {
+
+//****************************************************************************80
+// STATIC MEMBERS
+//****************************************************************************80
+GLuint TerrainTile::VAO_ = 0;
+GLuint TerrainTile::EBO_ = 0;
+unsigned TerrainTile::num_shared_users_ = 0;
+
+//****************************************************************************80
+// PUBLIC FUNCTIONS
+//****************************************************************************80
+void TerrainTile::UploadTexels(GLuint height_map) {
+  if (packed_texels_.empty()) return;
+  auto start = std::chrono::steady_clock::now();
+  GLint nv = GetNumVertices();
+  glBindTexture(GL_TEXTURE_2D, height_map);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, texel_offset_[0], texel_offset_[1], nv, 
+      nv, GL_RGBA, GL_UNSIGNED_SHORT, packed_texels_.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  std::vector<PackedTexel>().swap(packed_texels_);
+  load_times_.upload += std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+//****************************************************************************80
+void TerrainTile::UploadPlaceholder(GLuint height_map) {
+  // Sample the vertices of the coarsest LoD, 3 x 3 of them
+  const GLint step = 1 << (num_lod_ - 1);
+  const GLint n = (1 << num_lod_) / step + 1;
+  const GLfloat dx = GetGridSpacing() * step;
+  GLfloat xs[n*n], zs[n*n], hs[n*n], dhdxs[n*n], dhdzs[n*n];
+  for (GLint j = 0; j < n; ++j) {
+    for (GLint i = 0; i < n; ++i) {
+      xs[n*j + i] = x0_ + dx*i;
+      zs[n*j + i] = z0_ + dx*j;
+    }
+  }
+  height_source_->GetHeightsAndGradients(xs, zs, hs, dhdxs, dhdzs, n*n, dx);
+  ymin_ = *std::min_element(hs, hs + n*n);
+  ymax_ = *std::max_element(hs, hs + n*n);
+
+  // Fill every vertex with the bilinear interpolant of the samples, so 
+  // stitching to finer neighbors finds no stale texels
+  GLint nv = GetNumVertices();
+  GLfloat yscale = ymax_ > ymin_ ? 65535.0f / (ymax_ - ymin_) : 0.0f;
+  std::vector<PackedTexel> packed_texels(nv*nv);
+  for (GLint j = 0; j < nv; ++j) {
+    GLint cj = std::min(j / step, n - 2);
+    GLfloat sj = (GLfloat)(j - cj * step) / step;
+    for (GLint i = 0; i < nv; ++i) {
+      GLint ci = std::min(i / step, n - 2);
+      GLfloat si = (GLfloat)(i - ci * step) / step;
+      GLint k = n*cj + ci;
+      auto lerp = [si, sj, k, n](const GLfloat* f) {
+        return (1.0f - sj) * ((1.0f - si) * f[k] + si * f[k + 1]) + 
+          sj * ((1.0f - si) * f[k + n] + si * f[k + n + 1]);
+      };
+      Texel t;
+      t.height = lerp(hs);
+      glm::vec3 normal = glm::normalize(glm::vec3(-lerp(dhdxs), 1.0f, 
+            -lerp(dhdzs)));
+      for (int d = 0; d < 3; ++d) {
+        t.normal[d] = normal[d];
+      }
+      packed_texels[nv*j + i] = PackTexel(t, ymin_, yscale);
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, height_map);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, texel_offset_[0], texel_offset_[1], nv, 
+      nv, GL_RGBA, GL_UNSIGNED_SHORT, packed_texels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  placeholder_ = true;
+}
+
+//****************************************************************************80
+void TerrainTile::MultiDraw(const std::vector<GLsizei>& counts, 
+    const std::vector<GLvoid*>& indices, 
+    const std::vector<GLint>& base_vertices) {
+  if (counts.empty()) return;
+  glBindVertexArray(VAO_);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), 
+      GL_UNSIGNED_SHORT, const_cast<GLvoid**>(indices.data()), counts.size(), 
+      base_vertices.data());
+  glBindVertexArray(0);
+}
+
+//****************************************************************************80
+void TerrainTile::CreateSharedObjects() {
+  if (num_shared_users_++ == 0) {
+    CreateElem2NodeBuffer();
+    CreateVertexArray();
+  }
+}
+
+//****************************************************************************80
+void TerrainTile::DeleteSharedObjects() {
+  if (--num_shared_users_ == 0) {
+    glDeleteBuffers(1, &EBO_); 
+    glDeleteVertexArrays(1, &VAO_);
+    EBO_ = VAO_ = 0;
+  }
+}
+
+//****************************************************************************80
+// PRIVATE FUNCTIONS
+//****************************************************************************80
+void TerrainTile::CreateElem2NodeBuffer() {
+  // Upload once, the buffer is never modified afterwards. Unbind any VAO so
+  // the EBO binding below does not attach to it
+  glBindVertexArray(0);
+  glGenBuffers(1, &EBO_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, 
+      sizeof(GLushort) * Elem2NodeTable::num_indices, Elem2NodeTable::indices, 
+      GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+//****************************************************************************80
+void TerrainTile::CreateVertexArray() {
+  // Core profile needs a VAO even without vertex attributes, it only holds
+  // the shared EBO
+  glGenVertexArrays(1, &VAO_);
+  glBindVertexArray(VAO_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+  glBindVertexArray(0);
+}
+
+} // End namespace TopFun
@@ -0,0 +1,97 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace TopFun {
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+
+class MappedFile {
+ public:
+  //**************************************************************************80
+  //! \brief MappedFile - Constructor for an empty mapping
+  //**************************************************************************80
+  MappedFile() : data_(nullptr), size_(0) {}
+  
+  //**************************************************************************80
+  //! \brief MappedFile - Constructor, maps a file (empty if it can't be read)
+  //! \param[in] path - path of the file
+  //**************************************************************************80
+  explicit MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = data;
+        size_ = st.st_size;
+      }
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+  }
+  
+  //**************************************************************************80
+  //! \brief ~MappedFile - Destructor
+  //**************************************************************************80
+  ~MappedFile() { Unmap(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) : data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  MappedFile& operator=(MappedFile&& other) {
+    if (this != &other) {
+      Unmap();
+      data_ = other.data_;
+      size_ = other.size_;
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  //**************************************************************************80
+  //! \brief IsOpen - returns true if a file is mapped
+  //**************************************************************************80
+  inline bool IsOpen() const { return data_ != nullptr; }
+  
+  //**************************************************************************80
+  //! \brief GetData - returns the start of the mapping
+  //**************************************************************************80
+  inline const void* GetData() const { return data_; }
+  
+  //**************************************************************************80
+  //! \brief GetSize - returns the size of the mapping in bytes
+  //**************************************************************************80
+  inline std::size_t GetSize() const { return size_; }
+
+ private:
+  void* data_;
+  std::size_t size_;
+
+  //**************************************************************************80
+  //! \brief Unmap - releases the mapping, if any
+  //**************************************************************************80
+  void Unmap() {
+    if (data_) munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+};
+} // End namespace TopFun
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+namespace TopFun {
+
+// Fixed-size pool of worker threads that runs submitted jobs in FIFO order
+
+class ThreadPool {
+ public:
+  //**************************************************************************80
+  //! \brief ThreadPool - Constructor
+  //! \param[in] num_threads - number of worker threads (0 leaves one hardware
+  //! thread free for the render loop)
+  //**************************************************************************80
+  explicit ThreadPool(unsigned num_threads = 0) : stopping_(false) {
+    if (num_threads == 0) {
+      unsigned num_hw = std::thread::hardware_concurrency();
+      num_threads = std::max(num_hw, 2u) - 1;
+    }
+    workers_.reserve(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+      workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+  }
+
+  //**************************************************************************80
+  //! \brief ~ThreadPool - Destructor, discards queued jobs and joins workers
+  //**************************************************************************80
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      tasks_.clear();
+    }
+    cv_.notify_all();
+    for (auto& w : workers_) {
+      w.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  //**************************************************************************80
+  //! \brief Submit - queues a job to be run on a worker thread
+  //! \param[in] job - callable taking no arguments
+  //! \returns future holding the result of the job
+  //**************************************************************************80
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> Submit(F job) {
+    typedef typename std::result_of<F()>::type result_type;
+    auto task = std::make_shared<std::packaged_task<result_type()>>(
+        std::move(job));
+    std::future<result_type> result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace_back([task]() { (*task)(); });
+    }
+    cv_.notify_one();
+    return result;
+  }
+
+  //**************************************************************************80
+  //! \brief GetNumThreads - returns the number of worker threads
+  //**************************************************************************80
+  inline unsigned GetNumThreads() const { return workers_.size(); }
+
+ private:
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_;
+
+  //**************************************************************************80
+  //! \brief WorkerLoop - pops and runs jobs until the pool is destroyed
+  //**************************************************************************80
+  void WorkerLoop() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+        if (stopping_) return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+};
+} // End namespace TopFun
+
+#endif